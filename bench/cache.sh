@@ -0,0 +1,29 @@
+#!/bin/bash
+# Compares a clean batch split against one served entirely from a warm
+# cache, with plain, hardlinked and compressed cache entries.
+#
+# Usage: bench/cache.sh [copies of test/cases]
+
+. $(dirname $0)/common.sh
+
+copies=${1:-100}
+cch=$(pwd)/build/cch
+corpus="$bench_tmp/corpus"
+make_corpus "$corpus" "$copies"
+files=$(find "$corpus" -name '*.cch' | wc -l)
+
+# time_run <cch args...> splits the corpus in place, printing files/s.
+time_run() {
+    local start=$(now_ns)
+    (cd "$corpus" && "$cch" --input . "$@" >/dev/null 2>&1)
+    rate "$files" "$(( $(now_ns) - start ))"
+}
+
+echo "Corpus: $files files"
+printf "%-28s %12s\n" mode files/s
+printf "%-28s %12s\n" "no cache" "$(time_run)"
+for mode in "" --cacheHardlink --cacheCompress; do
+    cache="$bench_tmp/cache$mode"
+    time_run --cacheDir="$cache" $mode >/dev/null
+    printf "%-28s %12s\n" "warm cache $mode" "$(time_run --cacheDir="$cache" $mode)"
+done
@@ -0,0 +1,25 @@
+# Collection of benchmark script helpers. Meant to be sourced, not run directly.
+
+# Set up a temporary working directory and a hook to remove it on exit.
+bench_tmp=$(mktemp -d 2>/dev/null || mktemp -d -t cchbench)
+trap 'rm -rf "$bench_tmp"' EXIT
+
+# now_ns() prints the current time in nanoseconds.
+now_ns() {
+    date +%s%N
+}
+
+# make_corpus <dir> <copies> populates dir with <copies> copies of every
+# test case, one subdirectory per copy.
+make_corpus() {
+    local dir=$1 copies=$2 i
+    for ((i = 0; i < copies; i++)); do
+        mkdir -p "$dir/$i"
+        cp test/cases/*.cch "$dir/$i/"
+    done
+}
+
+# rate <count> <elapsed ns> prints count per second.
+rate() {
+    awk -v n="$1" -v ns="$2" 'BEGIN { printf "%.1f", (ns > 0) ? n * 1e9 / ns : 0 }'
+}
@@ -0,0 +1,46 @@
+#!/bin/bash
+# Measures what comparing outputs before writing them saves on a rebuild:
+# re-splitting a corpus whose outputs already exist, once unchanged and
+# once after adding a line to the top of every input, which only moves
+# the #line directives.  Reports the time taken and how many outputs were
+# rewritten, each of which would be recompiled along with everything
+# including it.
+#
+# Usage: bench/compare.sh [copies of test/cases]
+
+. $(dirname $0)/common.sh
+
+copies=${1:-500}
+cch=$(pwd)/build/cch
+corpus="$bench_tmp/corpus"
+make_corpus "$corpus" "$copies"
+files=$(find "$corpus" -name '*.cch' | wc -l)
+
+# run <cch args...> re-splits the corpus in place, printing milliseconds
+# and the number of outputs rewritten.
+run() {
+    touch "$bench_tmp/marker"
+    sleep 0.01
+    local start=$(now_ns)
+    (cd "$corpus" && "$cch" --input . "$@" >/dev/null 2>&1)
+    local ms=$(awk -v ns="$(( $(now_ns) - start ))" 'BEGIN { printf "%.1f", ns / 1e6 }')
+    echo "$ms $(find "$corpus" -newer "$bench_tmp/marker" -name '*.cch.*' | wc -l)"
+}
+
+# edit_inputs adds a comment line to the top of every input.
+edit_inputs() {
+    local f
+    for f in $(find "$corpus" -name '*.cch'); do
+        { echo "// edited"; cat "$f"; } > "$f.new" && mv "$f.new" "$f"
+    done
+}
+
+echo "Corpus: $files files, $((2 * files)) outputs"
+printf "%-20s %-12s %10s %10s\n" run inputs ms rewritten
+for args in "--overwrite" "" "--diff"; do
+    rm -rf "$corpus" && make_corpus "$corpus" "$copies"
+    run $args >/dev/null
+    printf "%-20s %-12s %10s %10s\n" "${args:-(compare)}" unchanged $(run $args)
+    edit_inputs
+    printf "%-20s %-12s %10s %10s\n" "${args:-(compare)}" "lines moved" $(run $args)
+done
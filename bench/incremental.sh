@@ -0,0 +1,41 @@
+#!/bin/bash
+# Compares re-splitting a large generated .cch file in full against
+# re-splitting it incrementally (--incremental) after a one-line edit.
+#
+# Usage: bench/incremental.sh [functions in the file] [edits]
+
+. $(dirname $0)/common.sh
+
+functions=${1:-20000}
+edits=${2:-20}
+cch=$(pwd)/build/cch
+input="$bench_tmp/large.cch"
+
+awk -v n="$functions" 'BEGIN {
+    print "#include <stdint.h>\n"
+    for (i = 0; i < n; i++) {
+        printf "// Handles message %d.\nint handle_%d(int value) {\n    return value + %d;\n}\n\n", i, i, i
+    }
+}' > "$input"
+lines=$(wc -l < "$input")
+
+# time_edits <cch args...> re-splits after each of a series of edits
+# spread through the file, printing the mean milliseconds per re-split.
+time_edits() {
+    local i line total=0 start
+    rm -rf "$bench_tmp/out" && mkdir -p "$bench_tmp/out"
+    (cd "$bench_tmp" && "$cch" --input large.cch --output "out/%f" "$@" >/dev/null)
+    for ((i = 0; i < edits; i++)); do
+        line=$(( (i * 7919 % functions) * 5 + 5 ))
+        sed -i "${line}s/value +/value * 2 +/" "$input"
+        start=$(now_ns)
+        (cd "$bench_tmp" && "$cch" --input large.cch --output "out/%f" "$@" >/dev/null)
+        total=$(( total + $(now_ns) - start ))
+    done
+    awk -v ns="$total" -v n="$edits" 'BEGIN { printf "%.1f", ns / n / 1e6 }'
+}
+
+echo "Input: $lines lines, $edits one-line edits"
+printf "%-20s %10s\n" run ms/edit
+printf "%-20s %10s\n" "full" "$(time_edits)"
+printf "%-20s %10s\n" "incremental" "$(time_edits --incremental)"
@@ -0,0 +1,156 @@
+// Measures the cost of getting an input into memory by reading it
+// against mapping it, and how that carries through a split, against
+// streaming it through the splitter a chunk at a time.
+//
+// Usage: build/bench/input <file>
+//
+// Each way is run in a child process of its own, so that its peak RSS
+// is its own.  Prints, for each, the microseconds until the splitter can
+// start on the input, the microseconds to split it, the peak RSS and the
+// anonymous (private, unreclaimable) RSS once split, in KB.
+#include <fcntl.h>
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "cch.h"
+#include "MappedFile.h"
+#include "Splitter.h"
+#include "Util.h"
+
+// Discards the outputs, keeping only their size so they aren't
+// optimized away.
+class NullOutput : public cch::Output {
+public:
+    size_t size;
+
+    NullOutput() : size(0) {}
+
+    void write(const string& h, const string& cc) {
+        size = h.size() + cc.size();
+    }
+};
+
+// Discards streamed outputs, likewise.
+class NullSink : public Splitter::Sink {
+public:
+    size_t size;
+
+    NullSink() : size(0) {}
+
+    bool write(const string& h, const string& cc) {
+        size += h.size() + cc.size();
+        return true;
+    }
+};
+
+static int64_t nowUs() {
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// The anonymous RSS of this process in KB, or -1 if unknown.
+static long anonRssKb() {
+    MappedFile file;
+    if (!file.open("/proc/self/status")) {
+        return -1;
+    }
+    const string& status = *file.buffer();
+    size_t at = status.find("RssAnon:");
+    return (at == string::npos) ? -1 : atol(status.c_str() + at + strlen("RssAnon:"));
+}
+
+// Stream filename through the splitter a chunk at a time.
+static bool streamSplit(const char* filename) {
+    int fd = ::open(filename, O_RDONLY);
+    NullSink sink;
+    Splitter::Stream stream(filename, true, Splitter::banner(), &sink);
+    string chunk;
+    bool ok = (fd >= 0);
+    while (ok && Util::readFromDescriptor(fd, Splitter::Stream::kChunkSize, &chunk)
+           && !chunk.empty()) {
+        ok = stream.feed(chunk.data(), chunk.size());
+    }
+    ok = ok && stream.finish();
+    ::close(fd);
+    return ok;
+}
+
+// Load and split filename, mapping it if map is set, and write
+// '<ready us> <split us> <anon kb>' to fd.
+static int loadAndSplit(const char* filename, int mode, int fd) {
+    int64_t start = nowUs();
+    if (mode == 2) {
+        // Streamed, which is ready as soon as it starts.
+        if (!streamSplit(filename)) {
+            return 1;
+        }
+        char line[128];
+        int n = snprintf(line, sizeof(line), "0 %lld %ld\n",
+                         (long long)(nowUs() - start), anonRssKb());
+        return (::write(fd, line, n) == n) ? 0 : 1;
+    }
+    bool map = (mode == 1);
+    string contents;
+    MappedFile file;
+    bool loaded = map ? file.open(filename) : Util::readFromFile(filename, &contents);
+    StringView input = map ? file.contents() : StringView(contents);
+    int64_t ready = nowUs();
+    NullOutput output;
+    if (!loaded || !cch::split(input, cch::Options(filename), output).ok) {
+        return 1;
+    }
+    int64_t split = nowUs();
+    char line[128];
+    int n = snprintf(line, sizeof(line), "%lld %lld %ld\n", (long long)(ready - start),
+                     (long long)(split - ready), anonRssKb());
+    return (::write(fd, line, n) == n) ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        cerr << "Usage: " << argv[0] << " <file>" << endl;
+        return 1;
+    }
+    const char* modes[] = { "read", "mmap", "stream" };
+    for (int mode = 0; mode < 3; mode++) {
+        int fds[2];
+        if (::pipe(fds) != 0) {
+            return 1;
+        }
+        pid_t pid = ::fork();
+        if (pid == 0) {
+            ::close(fds[0]);
+            _exit(loadAndSplit(argv[1], mode, fds[1]));
+        }
+        ::close(fds[1]);
+        string result;
+        Util::readFromDescriptor(fds[0], &result);
+        ::close(fds[0]);
+        int status;
+        struct rusage usage;
+        if (pid < 0 || ::wait4(pid, &status, 0, &usage) != pid
+            || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            cerr << "ERROR: failed to split " << argv[1] << endl;
+            return 1;
+        }
+        long long readyUs, splitUs;
+        long anonKb;
+        if (sscanf(result.c_str(), "%lld %lld %ld", &readyUs, &splitUs, &anonKb) != 3) {
+            return 1;
+        }
+        // ru_maxrss is in KB on Linux, but bytes on macOS.
+#ifdef __APPLE__
+        long peakKb = usage.ru_maxrss / 1024;
+#else
+        long peakKb = usage.ru_maxrss;
+#endif
+        printf("%s %lld %lld %ld %ld\n", modes[mode], readyUs, splitUs, peakKb, anonKb);
+    }
+    return 0;
+}
@@ -0,0 +1,36 @@
+#!/bin/bash
+# Compares reading inputs into memory against mapping them, and against
+# streaming them a chunk at a time, across input sizes from below the
+# mapping threshold to well above it: the time until the splitter can
+# start on the input, the time to split it, and the peak and anonymous
+# (private) RSS of a process splitting it.  The splits are from a warm
+# page cache.
+#
+# Usage: bench/input.sh [largest size in MB]
+
+. $(dirname $0)/common.sh
+
+largest=${1:-64}
+cat test/cases/*.cch > "$bench_tmp/unit"
+
+# make_input <KB> writes an input of whole test cases, doubled until it is
+# at least that many KB, printing its path.
+make_input() {
+    local path="$bench_tmp/$1K.cch"
+    cp "$bench_tmp/unit" "$path"
+    while [ $(wc -c < "$path") -lt $(( $1 * 1024 )) ]; do
+        cat "$path" "$path" > "$path.next"
+        mv "$path.next" "$path"
+    done
+    echo "$path"
+}
+
+printf "%-8s %-6s %10s %10s %10s %10s\n" KB mode ready-us split-us peak-KB anon-KB
+for kb in 16 256 4096 $(( largest * 1024 )); do
+    input=$(make_input $kb)
+    cat "$input" > /dev/null
+    size=$(( $(wc -c < "$input") / 1024 ))
+    build/bench/input "$input" | while read mode ready split peak anon; do
+        printf "%-8s %-6s %10s %10s %10s %10s\n" $size $mode $ready $split $peak $anon
+    done
+done
@@ -0,0 +1,55 @@
+#!/bin/bash
+# Compares batched io_uring file I/O against reading and writing files one
+# at a time (--noIoUring), splitting a corpus from a warm and, when running
+# as root, a cold page cache.  Syscall counts are reported if strace is
+# installed.
+#
+# Usage: bench/io.sh [copies of test/cases]
+
+. $(dirname $0)/common.sh
+
+copies=${1:-500}
+cch=$(pwd)/build/cch
+corpus="$bench_tmp/corpus"
+make_corpus "$corpus" "$copies"
+files=$(find "$corpus" -name '*.cch' | wc -l)
+
+# drop_caches empties the page cache, returning false if not permitted.
+drop_caches() {
+    sync && echo 3 2>/dev/null > /proc/sys/vm/drop_caches
+}
+
+# time_run <cch args...> splits the corpus in place, printing milliseconds.
+time_run() {
+    local start=$(now_ns)
+    (cd "$corpus" && "$cch" --input . "$@" >/dev/null 2>&1)
+    awk -v ns="$(( $(now_ns) - start ))" 'BEGIN { printf "%.1f", ns / 1e6 }'
+}
+
+# count_syscalls <cch args...> prints the number of syscalls made.
+count_syscalls() {
+    if ! command -v strace >/dev/null; then
+        echo "n/a"
+        return
+    fi
+    (cd "$corpus" && strace -f -c -o "$bench_tmp/strace" "$cch" --input . "$@" \
+                                   >/dev/null 2>&1)
+    awk '$NF == "total" { print $(NF - 2) }' "$bench_tmp/strace"
+}
+
+echo "Corpus: $files files"
+cold=yes
+drop_caches || cold="n/a (needs root)"
+printf "%-28s %10s %10s %10s\n" run warm-ms cold-ms syscalls
+for args in "" "--noIoUring" "--diff" "--diff --noIoUring"; do
+    time_run $args >/dev/null
+    warm=$(time_run $args)
+    if [ "$cold" == yes ]; then
+        drop_caches
+        cold_ms=$(time_run $args)
+    else
+        cold_ms=$cold
+    fi
+    printf "%-28s %10s %10s %10s\n" "split ${args:-(io_uring)}" "$warm" "$cold_ms" \
+           "$(count_syscalls $args)"
+done
@@ -0,0 +1,28 @@
+#!/bin/bash
+# Times a no-op batch run over a corpus whose outputs are all up to date
+# according to the journal, against a full split of the same corpus.
+#
+# Usage: bench/journal.sh [copies of test/cases]
+
+. $(dirname $0)/common.sh
+
+copies=${1:-500}
+cch=$(pwd)/build/cch
+corpus="$bench_tmp/corpus"
+make_corpus "$corpus" "$copies"
+files=$(find "$corpus" -name '*.cch' | wc -l)
+
+# time_run <cch args...> splits the corpus in place, printing milliseconds.
+time_run() {
+    local start=$(now_ns)
+    (cd "$corpus" && "$cch" --input . --journal="$bench_tmp/journal" "$@" >/dev/null)
+    awk -v ns="$(( $(now_ns) - start ))" 'BEGIN { printf "%.1f", ns / 1e6 }'
+}
+
+echo "Corpus: $files files"
+printf "%-24s %10s\n" run ms
+printf "%-24s %10s\n" "full split" "$(time_run)"
+printf "%-24s %10s\n" "no-op" "$(time_run)"
+touch $(find "$corpus" -name '*.cch')
+printf "%-24s %10s\n" "no-op after touch" "$(time_run)"
+printf "%-24s %10s\n" "no-op" "$(time_run)"
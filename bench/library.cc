@@ -0,0 +1,76 @@
+// Measures the throughput of splitting files in-process through libcch,
+// for comparison against exec'ing cch for every file (bench/library.sh).
+//
+// Usage: build/bench/library <threads> <files...>
+//
+// Prints the mean microseconds per file, across all threads.
+#include <iostream>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+#include "cch.h"
+#include "Util.h"
+
+struct Input {
+    string filename;
+    string contents;
+};
+
+// Each thread splits every input kRounds times.
+static const int kRounds = 20;
+
+static void* splitAll(void* arg) {
+    const vector<Input>& inputs = *static_cast<vector<Input>*>(arg);
+    for (int round = 0; round < kRounds; round++) {
+        for (size_t i = 0; i < inputs.size(); i++) {
+            cch::StringOutput output;
+            if (!cch::split(inputs[i].contents, cch::Options(inputs[i].filename), output).ok) {
+                return arg;
+            }
+        }
+    }
+    return NULL;
+}
+
+static int64_t nowNs() {
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <threads> <files...>" << endl;
+        return 1;
+    }
+    int numThreads = atoi(argv[1]);
+    vector<Input> inputs(argc - 2);
+    for (size_t i = 0; i < inputs.size(); i++) {
+        inputs[i].filename = argv[i + 2];
+        if (!Util::readFromFile(inputs[i].filename, &inputs[i].contents)) {
+            cerr << "ERROR: failed to read " << inputs[i].filename << endl;
+            return 1;
+        }
+    }
+
+    int64_t start = nowNs();
+    vector<pthread_t> threads(numThreads);
+    for (int i = 0; i < numThreads; i++) {
+        pthread_create(&threads[i], NULL, splitAll, &inputs);
+    }
+    bool failed = false;
+    for (int i = 0; i < numThreads; i++) {
+        void* result;
+        pthread_join(threads[i], &result);
+        failed |= (result != NULL);
+    }
+    if (failed) {
+        cerr << "ERROR: an input failed to split" << endl;
+        return 1;
+    }
+    double files = (double)numThreads * kRounds * inputs.size();
+    printf("%.1f\n", (nowNs() - start) / files / 1000);
+    return 0;
+}
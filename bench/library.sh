@@ -0,0 +1,31 @@
+#!/bin/bash
+# Compares per-file cost of exec'ing cch for every file against splitting
+# in-process through libcch, from one thread and from one per processor.
+#
+# Usage: bench/library.sh [copies of test/cases]
+
+. $(dirname $0)/common.sh
+
+copies=${1:-20}
+corpus="$bench_tmp/corpus"
+make_corpus "$corpus" "$copies"
+inputs=$(find "$corpus" -name '*.cch')
+files=$(echo "$inputs" | wc -l)
+threads=$(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1)
+
+# time_exec splits each input with one cch process per file, printing
+# the mean microseconds per file.
+time_exec() {
+    local start=$(now_ns) f
+    for f in $inputs; do
+        build/cch --input "$f" >/dev/null
+    done
+    awk -v ns="$(( $(now_ns) - start ))" -v n="$files" \
+        'BEGIN { printf "%.1f", ns / n / 1000 }'
+}
+
+echo "Corpus: $files files"
+printf "%-22s %10s\n" mode us/file
+printf "%-22s %10s\n" exec "$(time_exec)"
+printf "%-22s %10s\n" "in-process" "$(build/bench/library 1 $inputs)"
+printf "%-22s %10s\n" "in-process, $threads threads" "$(build/bench/library $threads $inputs)"
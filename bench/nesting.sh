@@ -0,0 +1,57 @@
+#!/bin/bash
+# Measures how splitting time scales with how deeply class and namespace
+# bodies nest: inputs of the same size, of declarations nested 1 to 256
+# scopes deep (namespaces, then classes in them).  Tokenizing each byte
+# once, the time should stay flat as the depth grows.  Pass another cch
+# binary to time it alongside, e.g. one built from an earlier revision.
+#
+# Usage: bench/nesting.sh [size in MB] [other cch]
+
+. $(dirname $0)/common.sh
+
+size=${1:-4}
+other=$2
+
+# make_input <depth> writes an input of about size MB, of units nested
+# depth scopes deep, printing its path.
+make_input() {
+    local path="$bench_tmp/depth$1.cch"
+    awk -v depth=$1 -v bytes=$(( size * 1024 * 1024 )) 'BEGIN {
+        for (unit = 0; written < bytes; unit++) {
+            text = ""
+            for (d = 0; d < depth; d++) {
+                if (d < depth / 2) {
+                    text = text "namespace n" unit "_" d " {\n"
+                } else {
+                    text = text "class C" unit "_" d " {\npublic:\n"
+                }
+            }
+            for (f = 0; f < 8; f++) {
+                text = text "int f" f "(int x) {\n    return x + " f ";\n}\n"
+            }
+            for (d = depth - 1; d >= 0; d--) {
+                text = text ((d < depth / 2) ? "}\n" : "};\n")
+            }
+            printf "%s", text
+            written += length(text)
+        }
+    }' > "$path"
+    echo "$path"
+}
+
+# run <cch> <input> prints the milliseconds taken to split input.
+run() {
+    local start=$(now_ns)
+    "$1" --noBanner -i "$2" >/dev/null 2>&1 || echo "ERROR: $1 failed on $2" >&2
+    awk -v ns="$(( $(now_ns) - start ))" 'BEGIN { printf "%.1f", ns / 1e6 }'
+}
+
+printf "%-8s %10s %10s" depth KB ms
+[ -n "$other" ] && printf " %10s" other-ms
+echo
+for depth in 1 4 16 64 256; do
+    input=$(make_input $depth)
+    printf "%-8s %10s %10s" $depth $(( $(wc -c < "$input") / 1024 )) $(run build/cch "$input")
+    [ -n "$other" ] && printf " %10s" $(run "$other" "$input")
+    echo
+done
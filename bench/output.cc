@@ -0,0 +1,87 @@
+// Measures what it costs to build the outputs of a split: the time, the
+// heap allocations made, and the bytes allocated per output byte, which
+// is at least the number of times each output byte is copied.
+//
+// Usage: build/bench/output <files...>
+#include <iostream>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+#include "cch.h"
+#include "Util.h"
+
+static size_t gAllocations = 0;
+static size_t gAllocatedBytes = 0;
+
+// Kept out of line, so the compiler doesn't see operator delete hand
+// malloc'd memory to free() and mistake it for a mismatch.
+static void* __attribute__((noinline)) allocate(size_t size) {
+    return malloc(size ? size : 1);
+}
+
+static void __attribute__((noinline)) deallocate(void* p) {
+    free(p);
+}
+
+void* operator new(size_t size) throw(std::bad_alloc) {
+    gAllocations++;
+    gAllocatedBytes += size;
+    void* p = allocate(size);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) throw() {
+    deallocate(p);
+}
+
+// Splits each input kRounds times.
+static const int kRounds = 20;
+
+static int64_t nowNs() {
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <files...>" << endl;
+        return 1;
+    }
+    vector<string> inputs(argc - 1);
+    for (size_t i = 0; i < inputs.size(); i++) {
+        if (!Util::readFromFile(argv[i + 1], &inputs[i])) {
+            cerr << "ERROR: failed to read " << argv[i + 1] << endl;
+            return 1;
+        }
+    }
+
+    size_t outputBytes = 0;
+    int64_t elapsed = 0;
+    size_t allocations = 0, allocatedBytes = 0;
+    for (int round = 0; round < kRounds; round++) {
+        for (size_t i = 0; i < inputs.size(); i++) {
+            cch::Options options(argv[i + 1]);
+            cch::StringOutput output;
+            size_t startAllocations = gAllocations, startBytes = gAllocatedBytes;
+            int64_t start = nowNs();
+            if (!cch::split(inputs[i], options, output).ok) {
+                cerr << "ERROR: failed to split " << argv[i + 1] << endl;
+                return 1;
+            }
+            elapsed += nowNs() - start;
+            allocations += gAllocations - startAllocations;
+            allocatedBytes += gAllocatedBytes - startBytes;
+            outputBytes += output.h.size() + output.cc.size();
+        }
+    }
+    double splits = (double)kRounds * inputs.size();
+    printf("%.1f %.1f %.2f\n", elapsed / splits / 1000, allocations / splits,
+           (double)allocatedBytes / outputBytes);
+    return 0;
+}
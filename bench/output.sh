@@ -0,0 +1,21 @@
+#!/bin/bash
+# Measures the cost of building split outputs, for the test cases one by
+# one and for a large input made of many copies of them: microseconds and
+# heap allocations per split, and heap bytes allocated per output byte.
+#
+# Usage: bench/output.sh [copies of test/cases in the large input]
+
+. $(dirname $0)/common.sh
+
+copies=${1:-200}
+for ((i = 0; i < copies; i++)); do
+    cat test/cases/*.cch
+done > "$bench_tmp/large.cch"
+
+printf "%-12s %10s %12s %16s\n" input us/split allocs/split "alloc B/out B"
+for input in "test/cases" "$bench_tmp/large.cch"; do
+    files=$(find $input -name '*.cch')
+    build/bench/output $files | while read us allocs bytes; do
+        printf "%-12s %10s %12s %16s\n" $(basename $input) $us $allocs $bytes
+    done
+done
@@ -0,0 +1,37 @@
+#!/bin/bash
+# Measures batch split throughput (files/s and MB/s) across thread counts,
+# checking that every parallel run produces output identical to a serial run.
+#
+# Usage: bench/parallel.sh [copies of test/cases] [thread counts...]
+
+. $(dirname $0)/common.sh
+
+copies=${1:-200}
+shift
+threads="${@:-1 2 4 8 16}"
+
+cch=$(pwd)/build/cch
+corpus="$bench_tmp/corpus"
+make_corpus "$corpus" "$copies"
+files=$(find "$corpus" -name '*.cch' | wc -l)
+bytes=$(cat $(find "$corpus" -name '*.cch') | wc -c)
+mb=$(awk -v b="$bytes" 'BEGIN { print b / (1024 * 1024) }')
+
+echo "Corpus: $files files, $bytes bytes ($(nproc) processors)"
+printf "%8s %12s %12s %10s\n" threads files/s MB/s identical
+for j in $threads; do
+    out="$bench_tmp/out$j"
+    (cd "$corpus" && find . -type d) | (mkdir -p "$out" && cd "$out" && xargs mkdir -p)
+    start=$(now_ns)
+    (cd "$corpus" && "$cch" -j "$j" --input . --output "$out/%p" >/dev/null)
+    elapsed=$(( $(now_ns) - start ))
+    identical=yes
+    if [ -d "$bench_tmp/reference" ]; then
+        diff -r "$bench_tmp/reference" "$out" >/dev/null || identical=NO
+    else
+        mv "$out" "$bench_tmp/reference"
+    fi
+    rm -rf "$out"
+    printf "%8s %12s %12s %10s\n" "$j" "$(rate $files $elapsed)" \
+        "$(rate $mb $elapsed)" "$identical"
+done
@@ -0,0 +1,110 @@
+// Measures the tokens per second through the tokenizer -> WrapperParser
+// -> BaseParser pipeline, composed statically as Splitter runs it, and
+// with every stage called through the Parser interface instead, as it
+// was before the stages were templates.
+//
+// Usage: build/bench/pipeline <file>
+//
+// Prints, for each composition, the millions of tokens per second and
+// the MB/s of parsing the input into outputs, at its fastest.
+#include <iostream>
+#include <stdio.h>
+#include <time.h>
+#include "Parser.h"
+#include "Tokenizer.h"
+#include "Util.h"
+
+// Counts the tokens passed on to the next stage, to report the rate of.
+template <class Next>
+class CountingParser {
+    Next& mNext;
+public:
+    size_t tokens;
+
+    CountingParser(Next& next) : mNext(next), tokens(0) {}
+
+    void acceptToken(const Token& token) {
+        tokens++;
+        mNext.acceptToken(token);
+    }
+
+    bool opensScope() const {
+        return mNext.opensScope();
+    }
+};
+
+// Each composition is timed over this many rounds, alternating between
+// them, and the fastest round of each is reported.
+static const int kRounds = 10;
+
+static int64_t nowNs() {
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Parse input, through virtual calls between the stages if dynamic, and
+// counting the tokens parsed into tokens if non-NULL.  Returns the
+// nanoseconds taken, or -1 if it failed.
+static int64_t parse(const string& filename, const string& input, bool dynamic,
+                     size_t* tokens = NULL) {
+    int64_t start = nowNs();
+    OutputBuilder h, cc;
+    LineIndex lines(input, 1);
+    ParseContext ctx(filename, &cc, &h, lines, true);
+    BaseParser parser(&ctx);
+    BaseTokenizer tokenizer;
+    if (tokens != NULL) {
+        CountingParser<BaseParser> counter(parser);
+        WrapperParser<CountingParser<BaseParser> > typeChanger(counter);
+        tokenizer.tokenize(input, &typeChanger);
+        *tokens = counter.tokens;
+    } else if (dynamic) {
+        ParserAdapter<BaseParser> base(parser);
+        WrapperParser<Parser> wrapper(base);
+        ParserAdapter<WrapperParser<Parser> > typeChanger(wrapper);
+        tokenizer.tokenize(input, static_cast<Parser*>(&typeChanger));
+    } else {
+        WrapperParser<BaseParser> typeChanger(parser);
+        tokenizer.tokenize(input, &typeChanger);
+    }
+    if (tokenizer.failed() || !parser.finish()) {
+        return -1;
+    }
+    return nowNs() - start;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        cerr << "Usage: " << argv[0] << " <file>" << endl;
+        return 1;
+    }
+    string input;
+    if (!Util::readFromFile(argv[1], &input)) {
+        cerr << "ERROR: failed to read " << argv[1] << endl;
+        return 1;
+    }
+    size_t tokens = 0;
+    int64_t best[2] = { -1, -1 };
+    bool ok = parse(argv[1], input, false, &tokens) >= 0;
+    for (int round = 0; ok && round < kRounds; round++) {
+        for (int dynamic = 0; ok && dynamic < 2; dynamic++) {
+            int64_t ns = parse(argv[1], input, dynamic);
+            ok = (ns >= 0);
+            if (best[dynamic] < 0 || ns < best[dynamic]) {
+                best[dynamic] = ns;
+            }
+        }
+    }
+    if (!ok) {
+        cerr << "ERROR: failed to parse " << argv[1] << endl;
+        return 1;
+    }
+    const char* names[] = { "static", "virtual" };
+    for (int dynamic = 0; dynamic < 2; dynamic++) {
+        double seconds = best[dynamic] / 1e9;
+        printf("%s %.2f %.1f\n", names[dynamic], tokens / 1e6 / seconds,
+               input.size() / (1024.0 * 1024) / seconds);
+    }
+    return 0;
+}
@@ -0,0 +1,50 @@
+#!/bin/bash
+# Compares the tokenizer -> parser pipeline composed statically, each
+# stage calling the next directly, against the same stages called through
+# the virtual Parser interface, on the test cases and on inputs of short
+# declarations and of comments, which are the densest in tokens.
+# Reports the millions of tokens per second and MB/s of each.
+#
+# Usage: bench/pipeline.sh [size in MB]
+
+. $(dirname $0)/common.sh
+
+size=${1:-8}
+
+# double_to <path> doubles the file at path until it is at least size MB.
+double_to() {
+    while [ $(wc -c < "$1") -lt $(( size * 1024 * 1024 )) ]; do
+        cat "$1" "$1" > "$1.next"
+        mv "$1.next" "$1"
+    done
+}
+
+cat test/cases/*.cch > "$bench_tmp/cases.cch"
+double_to "$bench_tmp/cases.cch"
+
+awk 'BEGIN {
+    for (d = 0; d < 256; d++) {
+        print "static const int kValue" d " = " d ";"
+        print "typedef std::map<std::string, int> Map" d ";"
+        print "extern int count" d ", *pointer" d ", array" d "[" d + 1 "];"
+        print "int f" d "(int x) { return x; }"
+    }
+}' > "$bench_tmp/decls.cch"
+double_to "$bench_tmp/decls.cch"
+
+awk 'BEGIN {
+    for (d = 0; d < 256; d++) {
+        for (l = 0; l < 40; l++) {
+            print "// Note " l "."
+        }
+        print "int f" d "(int x) { return x; }"
+    }
+}' > "$bench_tmp/comments.cch"
+double_to "$bench_tmp/comments.cch"
+
+printf "%-8s %-8s %12s %12s\n" input pipeline Mtokens/s MB/s
+for input in cases decls comments; do
+    build/bench/pipeline "$bench_tmp/$input.cch" | while read pipeline tokens mb; do
+        printf "%-8s %-8s %12s %12s\n" $input $pipeline $tokens $mb
+    done
+done
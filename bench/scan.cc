@@ -0,0 +1,102 @@
+// Measures tokenizing and splitting throughput with each of the scanning
+// kernels the tokenizer can skip through captures with.
+//
+// Usage: build/bench/scan <file>
+//
+// Prints, for each kernel this processor supports, the MB/s of
+// tokenizing the input alone (with every brace group captured whole, as
+// function bodies are) and of splitting it.  Then, for reference, the
+// MB/s of copying it into a new string, as splitting copies it out.
+#include <iostream>
+#include <stdio.h>
+#include <time.h>
+#include "ByteSet.h"
+#include "Splitter.h"
+#include "Tokenizer.h"
+#include "Util.h"
+
+// Discards tokens, keeping only a count so they aren't optimized away.
+class CountingParser {
+public:
+    size_t tokens;
+
+    CountingParser() : tokens(0) {}
+
+    void acceptToken(const Token& token) {
+        tokens++;
+    }
+
+    bool opensScope() const {
+        return false;
+    }
+};
+
+// Each measurement is of this many rounds over the input.
+static const int kRounds = 10;
+
+static int64_t nowNs() {
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static double mbPerSecond(size_t bytes, int64_t ns) {
+    return (double)bytes * kRounds / (1024 * 1024) / (ns / 1e9);
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        cerr << "Usage: " << argv[0] << " <file>" << endl;
+        return 1;
+    }
+    string input;
+    if (!Util::readFromFile(argv[1], &input)) {
+        cerr << "ERROR: failed to read " << argv[1] << endl;
+        return 1;
+    }
+    const char* names[] = { "scalar", "sse2", "avx2" };
+    for (int k = ByteSet::SCALAR; k <= ByteSet::AVX2; k++) {
+        ByteSet::Kernel kernel = static_cast<ByteSet::Kernel>(k);
+        if (!ByteSet::supported(kernel)) {
+            continue;
+        }
+        ByteSet::useKernel(kernel);
+
+        int64_t start = nowNs();
+        for (int round = 0; round < kRounds; round++) {
+            CountingParser parser;
+            BaseTokenizer tokenizer;
+            tokenizer.tokenize(input, &parser);
+            if (tokenizer.failed() || parser.tokens == 0) {
+                cerr << "ERROR: failed to tokenize " << argv[1] << endl;
+                return 1;
+            }
+        }
+        int64_t tokenized = nowNs();
+        for (int round = 0; round < kRounds; round++) {
+            string h, cc, error;
+            if (!Splitter::split(argv[1], input, true, "", &h, &cc, NULL, &error)) {
+                cerr << "ERROR: " << error << endl;
+                return 1;
+            }
+        }
+        int64_t split = nowNs();
+        printf("%s %.1f %.1f\n", names[k], mbPerSecond(input.size(), tokenized - start),
+               mbPerSecond(input.size(), split - tokenized));
+    }
+    int64_t start = nowNs();
+    size_t copied = 0;
+    for (int round = 0; round < kRounds; round++) {
+        string copy;
+        copy.reserve(input.size());
+        copy.append(input);
+        copied += copy.size();
+    }
+    int64_t copiedAt = nowNs();
+    if (copied != input.size() * kRounds) {
+        return 1;
+    }
+    printf("memcpy %.1f %.1f\n", mbPerSecond(input.size(), copiedAt - start),
+           mbPerSecond(input.size(), copiedAt - start));
+    return 0;
+}
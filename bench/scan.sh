@@ -0,0 +1,77 @@
+#!/bin/bash
+# Compares the kernels the tokenizer skips through comments, literals
+# and function bodies with, byte at a time against SSE2 and AVX2, on the
+# test cases and on an input of long comments, literals and bodies.  An
+# input of declarations alone measures the lexing of top level code,
+# which there is no skipping through, and one of declarations behind
+# long runs of comments measures parsing the token stack they pile up on.
+# Reports the MB/s of tokenizing alone and of splitting.
+#
+# Usage: bench/scan.sh [size in MB]
+
+. $(dirname $0)/common.sh
+
+size=${1:-8}
+
+# double_to <path> doubles the file at path until it is at least size MB.
+double_to() {
+    while [ $(wc -c < "$1") -lt $(( size * 1024 * 1024 )) ]; do
+        cat "$1" "$1" > "$1.next"
+        mv "$1.next" "$1"
+    done
+}
+
+cat test/cases/*.cch > "$bench_tmp/cases.cch"
+double_to "$bench_tmp/cases.cch"
+
+awk 'BEGIN {
+    for (f = 0; f < 64; f++) {
+        print "/*"
+        for (l = 0; l < 30; l++) {
+            print " * Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do."
+        }
+        print " */"
+        print "int f" f "(int x) {"
+        printf "    static const char* kText = \""
+        for (l = 0; l < 60; l++) {
+            printf "abcdefghij"
+        }
+        print "\";"
+        for (l = 0; l < 30; l++) {
+            print "    int value" l " = x + another_long_identifier_name" l " + yet_another_one;"
+        }
+        print "    return x;"
+        print "}"
+    }
+}' > "$bench_tmp/bodies.cch"
+double_to "$bench_tmp/bodies.cch"
+
+awk 'BEGIN {
+    for (d = 0; d < 256; d++) {
+        print "static const unsigned long long kValue" d " = " d " << 2;"
+        print "typedef std::map<std::string, int> Map" d ";"
+        print "extern int operatorCount" d ", *pointer" d ", array" d "[" d + 1 "];"
+        print "bool operator==(const Map" d "& a, const Map" d "& b);"
+    }
+}' > "$bench_tmp/decls.cch"
+double_to "$bench_tmp/decls.cch"
+
+awk 'BEGIN {
+    for (d = 0; d < 256; d++) {
+        print "/**"
+        print " * Documented at length."
+        print " */"
+        for (l = 0; l < 40; l++) {
+            print "// Note " l " on the declaration below."
+        }
+        print "int f" d "(int x) { return x; }"
+    }
+}' > "$bench_tmp/comments.cch"
+double_to "$bench_tmp/comments.cch"
+
+printf "%-8s %-8s %12s %12s\n" input kernel tokenize-MB/s split-MB/s
+for input in cases bodies decls comments; do
+    build/bench/scan "$bench_tmp/$input.cch" | while read kernel tokenize split; do
+        printf "%-8s %-8s %12s %12s\n" $input $kernel $tokenize $split
+    done
+done
@@ -0,0 +1,40 @@
+#!/bin/bash
+# Compares per-file latency of exec'ing cch for every file against
+# forwarding each file to a resident 'cch --serve' through cch-client.
+#
+# Usage: bench/server.sh [copies of test/cases]
+
+. $(dirname $0)/common.sh
+
+copies=${1:-20}
+corpus="$bench_tmp/corpus"
+make_corpus "$corpus" "$copies"
+inputs=$(find "$corpus" -name '*.cch')
+files=$(echo "$inputs" | wc -l)
+
+# time_per_file <command...> splits each input with one invocation
+# of the command per file, printing the mean microseconds per file.
+time_per_file() {
+    local start=$(now_ns) f
+    for f in $inputs; do
+        "$@" --input "$f" >/dev/null
+    done
+    awk -v ns="$(( $(now_ns) - start ))" -v n="$files" \
+        'BEGIN { printf "%.1f", ns / n / 1000 }'
+}
+
+export CCH_SOCKET="$bench_tmp/cch.sock"
+build/cch --serve 2>/dev/null &
+server=$!
+for i in 1 2 3 4 5 6 7 8 9 10; do
+    [ -S "$CCH_SOCKET" ] && break
+    sleep 0.1
+done
+
+echo "Corpus: $files files"
+printf "%-12s %10s\n" mode us/file
+printf "%-12s %10s\n" exec "$(time_per_file build/cch)"
+printf "%-12s %10s\n" client "$(time_per_file build/cch-client)"
+
+kill $server
+wait $server 2>/dev/null
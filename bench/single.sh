@@ -0,0 +1,57 @@
+#!/bin/bash
+# Measures splitting a single large generated input across thread counts,
+# checking that every run's outputs are identical to those of a serial
+# run.  The input is cut between declarations into pieces split on
+# threads of their own, so the speedup is bounded by the processors
+# available and by the serial prescan and join.
+#
+# Usage: bench/single.sh [size in MB] [thread counts...]
+
+. $(dirname $0)/common.sh
+
+size=${1:-50}
+shift
+threads="${@:-1 2 4 8}"
+
+awk -v size=$size 'BEGIN {
+    print "#include <string>"
+    print ""
+    for (n = 0; n < size * 1024 * 1024; n++) {
+        n += length(s = sprintf("namespace gen%d {\n\n", n))
+        printf "%s", s
+        for (i = 0; i < 64; i++) {
+            s = sprintf("// Returns x scaled by %d.\nint scale%d(int x) {\n    return x * %d;\n}\n\n", i, i, i)
+            s = s sprintf("class Counter%d {\npublic:\n    Counter%d() : mCount(0) {}\n    void add(int n) {\n        mCount += n;\n    }\nprivate:\n    int mCount;\n};\n\n", i, i)
+            s = s sprintf("static const char* kName%d = \"gen%d\";\n\n", i, i)
+            n += length(s)
+            printf "%s", s
+        }
+        n += length(s = "}\n\n")
+        printf "%s", s
+    }
+}' > "$bench_tmp/single.cch"
+
+cch=$(pwd)/build/cch
+bytes=$(wc -c < "$bench_tmp/single.cch")
+mb=$(awk -v b="$bytes" 'BEGIN { print b / (1024 * 1024) }')
+
+echo "Input: $bytes bytes ($(nproc) processors)"
+printf "%8s %12s %10s %10s\n" threads MB/s speedup identical
+base=0
+for j in $threads; do
+    out="$bench_tmp/out$j"
+    mkdir -p "$out"
+    start=$(now_ns)
+    (cd "$bench_tmp" && "$cch" -j "$j" --input single.cch --output "$out/%p" >/dev/null)
+    elapsed=$(( $(now_ns) - start ))
+    [ $base -eq 0 ] && base=$elapsed
+    identical=yes
+    if [ -d "$bench_tmp/reference" ]; then
+        diff -r "$bench_tmp/reference" "$out" >/dev/null || identical=NO
+    else
+        mv "$out" "$bench_tmp/reference"
+    fi
+    rm -rf "$out"
+    printf "%8s %12s %10s %10s\n" "$j" "$(rate $mb $elapsed)" \
+        "$(awk -v b=$base -v e=$elapsed 'BEGIN { printf "%.2fx", b / e }')" "$identical"
+done
@@ -0,0 +1,67 @@
+#!/bin/bash
+# Measures how splitting time scales with the length of statements and
+# the depth of the scopes they're in: inputs of the same size, of
+# statements of 10 to 10k tokens, in 1 to 64 nested scopes (namespaces,
+# then classes in them).  The parser's bookkeeping per token and per
+# definition is constant, so the time should stay flat across both.  Pass another cch binary to time it alongside,
+# e.g. one built from an earlier revision.
+#
+# Usage: bench/statements.sh [size in MB] [other cch]
+
+. $(dirname $0)/common.sh
+
+size=${1:-4}
+other=$2
+
+# make_input <tokens> <depth> writes an input of about size MB in the
+# body of depth nested scopes, of statements of about the given number
+# of tokens, each a declaration list of brace initialized variables,
+# and definitions split out under the scopes' names, printing its path.
+make_input() {
+    local path="$bench_tmp/statements$1_$2.cch"
+    awk -v tokens=$1 -v depth=$2 -v bytes=$(( size * 1024 * 1024 )) 'BEGIN {
+        for (d = 0; d < depth; d++) {
+            if (d < depth / 2) {
+                printf "namespace n%d {\n", d
+            } else {
+                printf "class C%d {\npublic:\n", d
+            }
+        }
+        for (unit = 0; written < bytes; unit++) {
+            text = "int a" unit "_0 = {0}"
+            for (t = 1; t * 8 < tokens; t++) {
+                text = text ", a" unit "_" t " = {" t "}"
+            }
+            text = text ";\n"
+            for (f = 0; f < 8; f++) {
+                text = text "int f" unit "_" f "(int x) { return x; }\n"
+            }
+            printf "%s", text
+            written += length(text)
+        }
+        for (d = depth - 1; d >= 0; d--) {
+            printf (d < depth / 2) ? "}\n" : "};\n"
+        }
+    }' > "$path"
+    echo "$path"
+}
+
+# run <cch> <input> prints the milliseconds taken to split input.
+run() {
+    local start=$(now_ns)
+    "$1" --noBanner -i "$2" >/dev/null 2>&1 || echo "ERROR: $1 failed on $2" >&2
+    awk -v ns="$(( $(now_ns) - start ))" 'BEGIN { printf "%.1f", ns / 1e6 }'
+}
+
+printf "%-8s %-8s %10s %10s" tokens depth KB ms
+[ -n "$other" ] && printf " %10s" other-ms
+echo
+for depth in 1 64; do
+    for tokens in 10 100 1000 10000; do
+        input=$(make_input $tokens $depth)
+        printf "%-8s %-8s %10s %10s" $tokens $depth $(( $(wc -c < "$input") / 1024 )) \
+            $(run build/cch "$input")
+        [ -n "$other" ] && printf " %10s" $(run "$other" "$input")
+        echo
+    done
+done
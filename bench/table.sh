@@ -0,0 +1,37 @@
+#!/bin/bash
+# Measures splitting a generated lookup table, a single declaration of
+# a brace initialized array of hex constants, against copying it.  The
+# initializer is skipped through by the tokenizer's scanning kernels and
+# referenced whole by the output, so splitting it should run near the
+# speed of the copy.  Reports the MB/s of tokenizing alone and of
+# splitting, with the copy as the memcpy row.
+#
+# Usage: bench/table.sh [size in MB]
+
+. $(dirname $0)/common.sh
+
+size=${1:-100}
+
+awk -v size=$size 'BEGIN {
+    srand(1)
+    print "#include <stdint.h>"
+    print ""
+    print "static const uint32_t kTable[] = {"
+    for (n = 0; n < size * 1024 * 1024; n += 92) {
+        line = "   "
+        for (i = 0; i < 8; i++) {
+            line = line sprintf(" 0x%08x,", int(rand() * 4294967295))
+        }
+        print line
+    }
+    print "};"
+    print ""
+    print "uint32_t lookup(int i) {"
+    print "    return kTable[i];"
+    print "}"
+}' > "$bench_tmp/table.cch"
+
+printf "%-8s %12s %12s\n" kernel tokenize-MB/s split-MB/s
+build/bench/scan "$bench_tmp/table.cch" | while read kernel tokenize split; do
+    printf "%-8s %12s %12s\n" $kernel $tokenize $split
+done
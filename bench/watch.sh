@@ -0,0 +1,66 @@
+#!/bin/bash
+# Measures the latency from saving a .cch file in a watched corpus to its
+# outputs being rewritten by 'cch --watch', for in-place saves and for
+# editor-style saves of a temporary file renamed over the original.
+#
+# Usage: bench/watch.sh [copies of test/cases] [saves per mode]
+
+. $(dirname $0)/common.sh
+
+copies=${1:-100}
+saves=${2:-200}
+cch=$(pwd)/build/cch
+corpus="$bench_tmp/corpus"
+make_corpus "$corpus" "$copies"
+files=$(find "$corpus" -name '*.cch' | wc -l)
+
+# now_us prints the current time in microseconds, avoiding a fork
+# where the shell can, so as not to add to the measured latency.
+now_us() {
+    if [ -n "$EPOCHREALTIME" ]; then
+        now=${EPOCHREALTIME/[.,]/}
+    else
+        now=$(( $(now_ns) / 1000 ))
+    fi
+}
+
+mkfifo "$bench_tmp/events"
+(cd "$corpus" && exec "$cch" --watch . 2>&1) > "$bench_tmp/events" &
+watcher=$!
+exec 3< "$bench_tmp/events"
+while read -r -u 3 line; do
+    [[ "$line" == *"watching for changes"* ]] && break
+done
+
+# measure <mode> saves a file repeatedly, recording each latency in ms.
+measure() {
+    local mode=$1 i target start
+    : > "$bench_tmp/latencies"
+    for ((i = 0; i < saves; i++)); do
+        target="$corpus/$((i % copies))/enum.cch"
+        if [ "$mode" == rename ]; then
+            cp "$target" "$target.tmp"
+            echo "// save $i" >> "$target.tmp"
+            now_us; start=$now
+            mv "$target.tmp" "$target"
+        else
+            now_us; start=$now
+            echo "// save $i" >> "$target"
+        fi
+        while read -r -u 3 line; do
+            [[ "$line" == *"./$((i % copies))/enum.cch split to"* ]] && break
+        done
+        now_us
+        echo $(( now - start )) >> "$bench_tmp/latencies"
+    done
+    sort -n "$bench_tmp/latencies" | awk '{ v[NR] = $1 / 1000 } END {
+        printf "%8.2f %8.2f %8.2f", v[int(NR * 0.5) + 1], v[int(NR * 0.99) + 1], v[NR] }'
+}
+
+echo "Corpus: $files files watched, $saves saves per mode"
+printf "%-20s %8s %8s %8s\n" save p50-ms p99-ms max-ms
+printf "%-20s %s\n" "in place" "$(measure inplace)"
+printf "%-20s %s\n" "rename over" "$(measure rename)"
+
+kill -INT $watcher
+wait $watcher
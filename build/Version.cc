@@ -0,0 +1,3 @@
+#include "Version.h"
+const char* Version::kBuildVersion = "65ab79b90f1e22a97ec8d4d43e97d411c3fb015e";
+const char* Version::kRepoURL = "https://github.com/tjps/cch";
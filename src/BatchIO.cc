@@ -0,0 +1,439 @@
+#include <algorithm> // for max()
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h> // for memset()
+#include <sys/stat.h>
+#include <unistd.h>
+#include "BatchIO.h"
+#include "MappedFile.h"
+#include "Util.h"
+
+#ifdef CCH_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <stdlib.h> // for calloc()
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+BatchIO::Request::Request(const string& _filename, MappedFile* _file)
+    : filename(_filename), contents(_file->buffer()), file(_file), ok(false) {}
+
+// Read filename in full, one syscall at a time.
+static void readFile(BatchIO::Request* request) {
+    if (request->file != NULL) {
+        request->ok = request->file->open(request->filename);
+        return;
+    }
+    request->contents->clear();
+    request->ok = Util::readFromFile(request->filename, request->contents);
+}
+
+// Write filename in full, one syscall at a time.
+static void writeFile(BatchIO::Request* request) {
+    request->ok = Util::writeFileAtomically(request->filename, *request->contents);
+}
+
+#ifdef CCH_HAVE_IO_URING
+
+// A minimal io_uring instance, submitting batches of operations
+// and waiting for all of them to complete.
+//
+class Ring {
+public:
+    // Returns a ring with room for the given number of submissions, or
+    // NULL if the kernel lacks io_uring or any operation BatchIO uses.
+    static Ring* create(unsigned entries);
+
+    ~Ring();
+
+    // Submit ops, keeping linked chains in the same submission, and wait
+    // for them all to complete, setting results[i] to the result of ops[i].
+    // Returns false if the ring itself failed.
+    bool run(vector<io_uring_sqe>& ops, vector<int>* results);
+
+private:
+    int mFd;
+    unsigned mEntries;
+    void* mSqRing;
+    size_t mSqRingSize;
+    void* mCqRing;      // may be the same mapping as mSqRing.
+    size_t mCqRingSize;
+    io_uring_sqe* mSqes;
+    size_t mSqesSize;
+
+    unsigned* mSqTail;
+    unsigned* mSqMask;
+    unsigned* mSqArray;
+    unsigned* mCqHead;
+    unsigned* mCqTail;
+    unsigned* mCqMask;
+    io_uring_cqe* mCqes;
+
+    Ring();
+};
+
+Ring::Ring()
+    : mFd(-1), mEntries(0),
+      mSqRing(MAP_FAILED), mSqRingSize(0),
+      mCqRing(MAP_FAILED), mCqRingSize(0),
+      mSqes((io_uring_sqe*)MAP_FAILED), mSqesSize(0) {}
+
+Ring::~Ring() {
+    if (mSqes != MAP_FAILED) {
+        munmap(mSqes, mSqesSize);
+    }
+    if (mCqRing != MAP_FAILED && mCqRing != mSqRing) {
+        munmap(mCqRing, mCqRingSize);
+    }
+    if (mSqRing != MAP_FAILED) {
+        munmap(mSqRing, mSqRingSize);
+    }
+    if (mFd >= 0) {
+        ::close(mFd);
+    }
+}
+
+// Returns true if the ring at fd supports all of BatchIO's operations.
+static bool supportsOps(int fd) {
+    static const int ops[] = {
+        IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ,
+        IORING_OP_WRITE, IORING_OP_CLOSE, IORING_OP_RENAMEAT
+    };
+    io_uring_probe* probe = (io_uring_probe*)calloc(
+        1, sizeof(io_uring_probe) + IORING_OP_LAST * sizeof(io_uring_probe_op));
+    if (probe == NULL) {
+        return false;
+    }
+    bool supported = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE,
+                             probe, IORING_OP_LAST) == 0;
+    for (size_t i = 0; supported && i < sizeof(ops) / sizeof(ops[0]); i++) {
+        supported = ops[i] <= probe->last_op
+            && (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    return supported;
+}
+
+/* static */ Ring* Ring::create(unsigned entries) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0) {
+        return NULL;
+    }
+    Ring* ring = new Ring();
+    ring->mFd = fd;
+    ring->mEntries = params.sq_entries;
+    if (!supportsOps(fd)) {
+        delete ring;
+        return NULL;
+    }
+
+    ring->mSqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->mCqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap) {
+        ring->mSqRingSize = ring->mCqRingSize =
+            max(ring->mSqRingSize, ring->mCqRingSize);
+    }
+    ring->mSqRing = mmap(NULL, ring->mSqRingSize, PROT_READ|PROT_WRITE,
+                         MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    ring->mCqRing = singleMmap
+        ? ring->mSqRing
+        : mmap(NULL, ring->mCqRingSize, PROT_READ|PROT_WRITE,
+               MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    ring->mSqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    ring->mSqes = (io_uring_sqe*)mmap(NULL, ring->mSqesSize, PROT_READ|PROT_WRITE,
+                                      MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->mSqRing == MAP_FAILED || ring->mCqRing == MAP_FAILED
+        || ring->mSqes == MAP_FAILED) {
+        delete ring;
+        return NULL;
+    }
+
+    char* sq = (char*)ring->mSqRing;
+    ring->mSqTail = (unsigned*)(sq + params.sq_off.tail);
+    ring->mSqMask = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->mSqArray = (unsigned*)(sq + params.sq_off.array);
+    char* cq = (char*)ring->mCqRing;
+    ring->mCqHead = (unsigned*)(cq + params.cq_off.head);
+    ring->mCqTail = (unsigned*)(cq + params.cq_off.tail);
+    ring->mCqMask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->mCqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+    return ring;
+}
+
+bool Ring::run(vector<io_uring_sqe>& ops, vector<int>* results) {
+    results->assign(ops.size(), -ECANCELED);
+    size_t next = 0;
+    while (next < ops.size()) {
+        // Queue as many whole chains as fit in the ring.
+        unsigned tail = *mSqTail;
+        unsigned queued = 0;
+        while (next < ops.size()) {
+            size_t chain = 1;
+            while (next + chain < ops.size()
+                   && (ops[next + chain - 1].flags & (IOSQE_IO_LINK|IOSQE_IO_HARDLINK))) {
+                chain++;
+            }
+            if (queued + chain > mEntries) {
+                if (queued == 0) {
+                    return false;  // The chain can never fit.
+                }
+                break;
+            }
+            for (; chain > 0; chain--, next++, queued++) {
+                unsigned index = (tail + queued) & *mSqMask;
+                mSqes[index] = ops[next];
+                mSqes[index].user_data = next;
+                mSqArray[index] = index;
+            }
+        }
+        __atomic_store_n(mSqTail, tail + queued, __ATOMIC_RELEASE);
+
+        // Submit them and reap completions until all are done.
+        unsigned toSubmit = queued;
+        unsigned pending = queued;
+        while (pending > 0) {
+            int submitted = syscall(__NR_io_uring_enter, mFd, toSubmit, pending,
+                                    IORING_ENTER_GETEVENTS, NULL, 0);
+            if (submitted < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            toSubmit -= min((unsigned)submitted, toSubmit);
+            unsigned head = *mCqHead;
+            for (; head != __atomic_load_n(mCqTail, __ATOMIC_ACQUIRE); head++) {
+                const io_uring_cqe& cqe = mCqes[head & *mCqMask];
+                (*results)[cqe.user_data] = cqe.res;
+                pending--;
+            }
+            __atomic_store_n(mCqHead, head, __ATOMIC_RELEASE);
+        }
+    }
+    return true;
+}
+
+// The largest file read or written with a single operation.
+static const uint64_t kMaxTransfer = 1 << 30;
+
+static io_uring_sqe makeOp(uint8_t opcode, int fd, const void* addr,
+                           uint32_t len, uint64_t offset) {
+    io_uring_sqe sqe;
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = opcode;
+    sqe.fd = fd;
+    sqe.addr = (uintptr_t)addr;
+    sqe.len = len;
+    sqe.off = offset;
+    return sqe;
+}
+
+static io_uring_sqe openOp(const string& filename, int flags) {
+    io_uring_sqe sqe = makeOp(IORING_OP_OPENAT, AT_FDCWD, filename.c_str(), 0666, 0);
+    sqe.open_flags = flags;
+    return sqe;
+}
+
+static io_uring_sqe statxOp(const string& filename, struct statx* buf,
+                            int flags = 0) {
+    // The statx buffer is passed in the offset field.
+    io_uring_sqe sqe = makeOp(IORING_OP_STATX, AT_FDCWD, filename.c_str(),
+                              STATX_TYPE|STATX_MODE|STATX_SIZE|STATX_NLINK, (uintptr_t)buf);
+    sqe.statx_flags = flags;
+    return sqe;
+}
+
+static io_uring_sqe renameOp(const string& from, const string& to) {
+    io_uring_sqe sqe = makeOp(IORING_OP_RENAMEAT, AT_FDCWD, from.c_str(), AT_FDCWD, 0);
+    sqe.addr2 = (uintptr_t)to.c_str();
+    return sqe;
+}
+
+// A read or write of fd, hardlinked to a close of fd that runs however
+// the transfer turns out.
+static void transferAndClose(uint8_t opcode, int fd, const void* buf,
+                             uint32_t len, vector<io_uring_sqe>* ops) {
+    ops->push_back(makeOp(opcode, fd, buf, len, 0));
+    ops->back().flags |= IOSQE_IO_HARDLINK;
+    ops->push_back(makeOp(IORING_OP_CLOSE, fd, NULL, 0, 0));
+}
+
+BatchIO::BatchIO(bool useRing)
+    : mRing(useRing ? Ring::create(256) : NULL) {}
+
+void BatchIO::read(vector<Request>* requests) {
+    vector<Request>& reqs = *requests;
+    if (mRing == NULL) {
+        for (size_t i = 0; i < reqs.size(); i++) {
+            readFile(&reqs[i]);
+        }
+        return;
+    }
+
+    // Open and size every file.
+    vector<io_uring_sqe> ops;
+    vector<int> results;
+    vector<struct statx> stats(reqs.size());
+    for (size_t i = 0; i < reqs.size(); i++) {
+        ops.push_back(openOp(reqs[i].filename, O_RDONLY|O_CLOEXEC));
+        ops.push_back(statxOp(reqs[i].filename, &stats[i]));
+    }
+    bool ran = mRing->run(ops, &results);
+
+    // Read each opened file in a single operation, asking for a byte
+    // more than its size to catch it having grown since.
+    vector<size_t> reading;
+    vector<int> opened(results);
+    ops.clear();
+    for (size_t i = 0; i < reqs.size(); i++) {
+        int fd = opened[2*i];
+        reqs[i].ok = false;
+        if (!ran || fd < 0) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            if (!ran) {
+                readFile(&reqs[i]);
+            }
+            continue;
+        }
+        if (opened[2*i+1] < 0 || stats[i].stx_size >= kMaxTransfer) {
+            ::close(fd);
+            readFile(&reqs[i]);
+            continue;
+        }
+        if (reqs[i].file != NULL && S_ISREG(stats[i].stx_mode)
+            && MappedFile::worthMapping(stats[i].stx_size)) {
+            // Already open and sized, so map it in place of the read.
+            reqs[i].ok = reqs[i].file->map(fd, stats[i].stx_size);
+            ::close(fd);
+            if (!reqs[i].ok) {
+                readFile(&reqs[i]);
+            }
+            continue;
+        }
+        if (reqs[i].file != NULL) {
+            reqs[i].file->release();
+        }
+        string* contents = reqs[i].contents;
+        contents->resize(stats[i].stx_size + 1);
+        transferAndClose(IORING_OP_READ, fd, &(*contents)[0], contents->size(), &ops);
+        reading.push_back(i);
+    }
+    ran = mRing->run(ops, &results);
+
+    for (size_t k = 0; k < reading.size(); k++) {
+        Request& request = reqs[reading[k]];
+        int bytes = results[2*k];
+        if (ran && bytes >= 0 && bytes < request.contents->size()) {
+            request.contents->resize(bytes);
+            request.ok = true;
+        } else {
+            readFile(&request);
+        }
+    }
+}
+
+void BatchIO::write(vector<Request>* requests) {
+    vector<Request>& reqs = *requests;
+    if (mRing == NULL) {
+        for (size_t i = 0; i < reqs.size(); i++) {
+            writeFile(&reqs[i]);
+        }
+        return;
+    }
+
+    // Write each file to a temporary file, renamed into place once
+    // written in full, unless it exists and isn't a regular file.
+    vector<string> tmpFilenames(reqs.size());
+    vector<struct statx> stats(reqs.size());
+    vector<io_uring_sqe> ops;
+    vector<int> results;
+    for (size_t i = 0; i < reqs.size(); i++) {
+        tmpFilenames[i] = Util::temporaryFilename(reqs[i].filename, i);
+        ops.push_back(openOp(tmpFilenames[i], O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC));
+        ops.push_back(statxOp(reqs[i].filename, &stats[i], AT_SYMLINK_NOFOLLOW));
+    }
+    bool ran = mRing->run(ops, &results);
+
+    // Write each file in a single operation.
+    vector<size_t> writing;
+    vector<int> opened(results);
+    ops.clear();
+    for (size_t i = 0; i < reqs.size(); i++) {
+        int fd = opened[2*i];
+        const string& contents = *reqs[i].contents;
+        bool exists = (opened[2*i+1] == 0);
+        bool special = (exists && !S_ISREG(stats[i].stx_mode));
+        reqs[i].ok = false;
+        if (ran && fd < 0) {
+            continue;  // Couldn't be created.
+        }
+        // The replacement keeps the mode of the file it replaces.
+        bool keptMode = (!ran || special || !exists
+                         || ::fchmod(fd, stats[i].stx_mode & 07777) == 0);
+        if (!ran || special || !keptMode || contents.size() >= kMaxTransfer) {
+            if (fd >= 0) {
+                ::close(fd);
+                ::unlink(tmpFilenames[i].c_str());
+            }
+            writeFile(&reqs[i]);
+            continue;
+        }
+        transferAndClose(IORING_OP_WRITE, fd, contents.data(), contents.size(), &ops);
+        writing.push_back(i);
+    }
+    ran = mRing->run(ops, &results);
+
+    vector<size_t> renaming;
+    ops.clear();
+    for (size_t k = 0; k < writing.size(); k++) {
+        size_t i = writing[k];
+        if (ran && results[2*k] == (int)reqs[i].contents->size() && results[2*k+1] == 0) {
+            ops.push_back(renameOp(tmpFilenames[i], reqs[i].filename));
+            renaming.push_back(i);
+        } else {
+            ::unlink(tmpFilenames[i].c_str());
+            writeFile(&reqs[i]);
+        }
+    }
+    ran = mRing->run(ops, &results);
+
+    for (size_t k = 0; k < renaming.size(); k++) {
+        size_t i = renaming[k];
+        if (ran && results[k] == 0) {
+            reqs[i].ok = true;
+        } else {
+            ::unlink(tmpFilenames[i].c_str());
+            writeFile(&reqs[i]);
+        }
+    }
+}
+
+#else
+
+class Ring {};
+
+BatchIO::BatchIO(bool)
+    : mRing(NULL) {}
+
+void BatchIO::read(vector<Request>* requests) {
+    for (size_t i = 0; i < requests->size(); i++) {
+        readFile(&(*requests)[i]);
+    }
+}
+
+void BatchIO::write(vector<Request>* requests) {
+    for (size_t i = 0; i < requests->size(); i++) {
+        writeFile(&(*requests)[i]);
+    }
+}
+
+#endif // CCH_HAVE_IO_URING
+
+BatchIO::~BatchIO() {
+    delete mRing;
+}
@@ -0,0 +1,66 @@
+#ifndef __BATCHIO_H__
+#define __BATCHIO_H__
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class MappedFile;
+class Ring;
+
+// Reads and writes whole files a batch at a time.
+//
+// On Linux, a batch is submitted through io_uring, taking a few
+// io_uring_enter() calls for the whole batch rather than several
+// blocking syscalls per file: two to read (open and statx, then read
+// and close) and three to write (open a temporary file, write and close
+// it, then rename it into place).
+// Where io_uring or any of the operations needed is unavailable, or
+// when disabled, files are read and written one at a time instead.
+// Large inputs read into a MappedFile are mapped rather than read.
+//
+// Not thread safe; each thread should use its own BatchIO.
+//
+class BatchIO {
+public:
+    struct Request {
+        string filename;
+        string* contents;   // read into by read(), written by write().
+        MappedFile* file;   // if set, read() maps large files into it.
+        bool ok;            // set on completion.
+
+        Request(const string& _filename, string* _contents)
+            : filename(_filename), contents(_contents), file(NULL), ok(false) {}
+
+        // Read filename into file, mapping it if worthwhile.
+        Request(const string& _filename, MappedFile* _file);
+    };
+
+    // Use io_uring if useRing is set and the kernel supports it.
+    explicit BatchIO(bool useRing);
+    ~BatchIO();
+
+    // Returns true if batches are submitted through io_uring.
+    bool usingRing() const {
+        return mRing != NULL;
+    }
+
+    // Read the full contents of each requested file.
+    void read(vector<Request>* requests);
+
+    // Write the contents of each requested file by way of a temporary
+    // file renamed over it, so that concurrent readers (e.g. a compiler
+    // in a parallel build) never see it partially written.  An existing
+    // file's other hardlinks (e.g. into the cache) are left untouched.
+    void write(vector<Request>* requests);
+
+private:
+    Ring* mRing;
+
+    // Non-copyable.
+    BatchIO(const BatchIO&);
+    BatchIO& operator=(const BatchIO&);
+};
+
+#endif //__BATCHIO_H__
@@ -0,0 +1,268 @@
+#include <assert.h>
+#include <string.h>
+#include "ByteSet.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(CCH_HAVE_AVX2)
+#include <immintrin.h>
+#endif
+
+static size_t findScalar(const char* bytes, size_t count,
+                         const char* data, size_t size, size_t from) {
+    for (size_t i = from; i < size; i++) {
+        for (size_t b = 0; b < count; b++) {
+            if (data[i] == bytes[b]) {
+                return i;
+            }
+        }
+    }
+    return size;
+}
+
+static size_t countScalar(const char* bytes, size_t count,
+                          const char* data, size_t size, size_t from) {
+    size_t total = 0;
+    for (size_t i = from; i < size; i++) {
+        for (size_t b = 0; b < count; b++) {
+            if (data[i] == bytes[b]) {
+                total++;
+                break;
+            }
+        }
+    }
+    return total;
+}
+
+// The vector kernels are instantiated for each number of bytes, so that
+// the bytes stay in registers and the comparisons are unrolled.
+
+#if defined(__SSE2__)
+template <size_t N>
+static size_t findSse2(const char* bytes, const char* data, size_t size, size_t from) {
+    __m128i set[N];
+    for (size_t b = 0; b < N; b++) {
+        set[b] = _mm_set1_epi8(bytes[b]);
+    }
+    size_t i = from;
+    for (; i + 16 <= size; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i hits = _mm_cmpeq_epi8(block, set[0]);
+        for (size_t b = 1; b < N; b++) {
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, set[b]));
+        }
+        int mask = _mm_movemask_epi8(hits);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return findScalar(bytes, N, data, size, i);
+}
+
+// Hits are counted a byte per lane, by subtracting each comparison's
+// all ones, for up to 255 blocks before the lanes are summed.
+template <size_t N>
+static size_t countSse2(const char* bytes, const char* data, size_t size, size_t from) {
+    __m128i set[N];
+    for (size_t b = 0; b < N; b++) {
+        set[b] = _mm_set1_epi8(bytes[b]);
+    }
+    const __m128i zero = _mm_setzero_si128();
+    size_t total = 0;
+    size_t i = from;
+    while (i + 16 <= size) {
+        __m128i counts = zero;
+        for (size_t r = 0; r < 255 && i + 16 <= size; r++, i += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            __m128i hits = _mm_cmpeq_epi8(block, set[0]);
+            for (size_t b = 1; b < N; b++) {
+                hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, set[b]));
+            }
+            counts = _mm_sub_epi8(counts, hits);
+        }
+        __m128i sums = _mm_sad_epu8(counts, zero);
+        total += _mm_cvtsi128_si32(sums) + _mm_extract_epi16(sums, 4);
+    }
+    return total + countScalar(bytes, N, data, size, i);
+}
+#endif
+
+#if defined(CCH_HAVE_AVX2)
+template <size_t N>
+__attribute__((target("avx2")))
+static size_t findAvx2(const char* bytes, const char* data, size_t size, size_t from) {
+    __m256i set[N];
+    for (size_t b = 0; b < N; b++) {
+        set[b] = _mm256_set1_epi8(bytes[b]);
+    }
+    size_t i = from;
+    for (; i + 32 <= size; i += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i hits = _mm256_cmpeq_epi8(block, set[0]);
+        for (size_t b = 1; b < N; b++) {
+            hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, set[b]));
+        }
+        unsigned mask = _mm256_movemask_epi8(hits);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    // Finish here rather than in findSse2(), which would pay for
+    // switching from AVX to SSE instructions.
+    for (; i < size; i++) {
+        for (size_t b = 0; b < N; b++) {
+            if (data[i] == bytes[b]) {
+                return i;
+            }
+        }
+    }
+    return size;
+}
+
+template <size_t N>
+__attribute__((target("avx2")))
+static size_t countAvx2(const char* bytes, const char* data, size_t size, size_t from) {
+    __m256i set[N];
+    for (size_t b = 0; b < N; b++) {
+        set[b] = _mm256_set1_epi8(bytes[b]);
+    }
+    const __m256i zero = _mm256_setzero_si256();
+    size_t total = 0;
+    size_t i = from;
+    while (i + 32 <= size) {
+        __m256i counts = zero;
+        for (size_t r = 0; r < 255 && i + 32 <= size; r++, i += 32) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            __m256i hits = _mm256_cmpeq_epi8(block, set[0]);
+            for (size_t b = 1; b < N; b++) {
+                hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, set[b]));
+            }
+            counts = _mm256_sub_epi8(counts, hits);
+        }
+        __m256i sums = _mm256_sad_epu8(counts, zero);
+        __m128i half = _mm_add_epi64(_mm256_castsi256_si128(sums),
+                                     _mm256_extracti128_si256(sums, 1));
+        total += _mm_cvtsi128_si32(half) + _mm_extract_epi16(half, 4);
+    }
+    for (; i < size; i++) {
+        for (size_t b = 0; b < N; b++) {
+            if (data[i] == bytes[b]) {
+                total++;
+                break;
+            }
+        }
+    }
+    return total;
+}
+#endif
+
+static ByteSet::Kernel fastestKernel() {
+    if (ByteSet::supported(ByteSet::AVX2)) {
+        return ByteSet::AVX2;
+    }
+    return ByteSet::supported(ByteSet::SSE2) ? ByteSet::SSE2 : ByteSet::SCALAR;
+}
+
+ByteSet::Kernel ByteSet::sKernel = fastestKernel();
+
+ByteSet::ByteSet(const char* bytes)
+    : mCount(strlen(bytes)) {
+    assert(mCount > 0 && mCount <= kMaxBytes);
+    memcpy(mBytes, bytes, mCount);
+}
+
+size_t ByteSet::find(const char* data, size_t size, size_t from, Kernel kernel) const {
+    assert(from <= size);
+    switch (kernel) {
+#if defined(CCH_HAVE_AVX2)
+    case AVX2:
+        switch (mCount) {
+        case 1: return findAvx2<1>(mBytes, data, size, from);
+        case 2: return findAvx2<2>(mBytes, data, size, from);
+        case 3: return findAvx2<3>(mBytes, data, size, from);
+        case 4: return findAvx2<4>(mBytes, data, size, from);
+        case 5: return findAvx2<5>(mBytes, data, size, from);
+        case 6: return findAvx2<6>(mBytes, data, size, from);
+        }
+        break;
+#endif
+#if defined(__SSE2__)
+    case SSE2:
+        switch (mCount) {
+        case 1: return findSse2<1>(mBytes, data, size, from);
+        case 2: return findSse2<2>(mBytes, data, size, from);
+        case 3: return findSse2<3>(mBytes, data, size, from);
+        case 4: return findSse2<4>(mBytes, data, size, from);
+        case 5: return findSse2<5>(mBytes, data, size, from);
+        case 6: return findSse2<6>(mBytes, data, size, from);
+        }
+        break;
+#endif
+    default:
+        assert(kernel == SCALAR && "Unsupported kernel");
+        break;
+    }
+    return findScalar(mBytes, mCount, data, size, from);
+}
+
+size_t ByteSet::count(const char* data, size_t size, size_t from, Kernel kernel) const {
+    assert(from <= size);
+    switch (kernel) {
+#if defined(CCH_HAVE_AVX2)
+    case AVX2:
+        switch (mCount) {
+        case 1: return countAvx2<1>(mBytes, data, size, from);
+        case 2: return countAvx2<2>(mBytes, data, size, from);
+        case 3: return countAvx2<3>(mBytes, data, size, from);
+        case 4: return countAvx2<4>(mBytes, data, size, from);
+        case 5: return countAvx2<5>(mBytes, data, size, from);
+        case 6: return countAvx2<6>(mBytes, data, size, from);
+        }
+        break;
+#endif
+#if defined(__SSE2__)
+    case SSE2:
+        switch (mCount) {
+        case 1: return countSse2<1>(mBytes, data, size, from);
+        case 2: return countSse2<2>(mBytes, data, size, from);
+        case 3: return countSse2<3>(mBytes, data, size, from);
+        case 4: return countSse2<4>(mBytes, data, size, from);
+        case 5: return countSse2<5>(mBytes, data, size, from);
+        case 6: return countSse2<6>(mBytes, data, size, from);
+        }
+        break;
+#endif
+    default:
+        assert(kernel == SCALAR && "Unsupported kernel");
+        break;
+    }
+    return countScalar(mBytes, mCount, data, size, from);
+}
+
+bool ByteSet::supported(Kernel kernel) {
+    switch (kernel) {
+    case SCALAR:
+        return true;
+    case SSE2:
+#if defined(__SSE2__)
+        return true;
+#else
+        return false;
+#endif
+    case AVX2:
+#if defined(CCH_HAVE_AVX2)
+        // Run before any constructors may have, e.g. to pick sKernel.
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+void ByteSet::useKernel(Kernel kernel) {
+    assert(supported(kernel));
+    sKernel = kernel;
+}
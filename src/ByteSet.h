@@ -0,0 +1,69 @@
+#ifndef __BYTESET_H__
+#define __BYTESET_H__
+
+#include <stddef.h>
+
+// A handful of bytes to search a buffer for, e.g. those that end a
+// comment or string literal, so that the tokenizer can jump straight to
+// the next byte it cares about rather than stepping through each one.
+//
+// On x86, find() and count() compare 16 bytes at a time with SSE2, or
+// 32 with AVX2 when the processor has it (checked once, at startup).
+// Elsewhere they compare a byte at a time, which is also the reference
+// the others are tested against.
+//
+class ByteSet {
+public:
+    static const size_t kMaxBytes = 6;
+
+    enum Kernel { SCALAR, SSE2, AVX2 };
+
+    // The bytes of the NUL-terminated bytes, at most kMaxBytes of them.
+    explicit ByteSet(const char* bytes);
+
+    bool contains(char c) const {
+        for (size_t i = 0; i < mCount; i++) {
+            if (mBytes[i] == c) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Returns the index of the first byte of data[from, size) in the
+    // set, or size if there is none.
+    size_t find(const char* data, size_t size, size_t from) const {
+        return find(data, size, from, sKernel);
+    }
+
+    // As above, with the given kernel, which must be supported.
+    size_t find(const char* data, size_t size, size_t from, Kernel kernel) const;
+
+    // Returns the number of bytes of data[from, size) in the set, e.g.
+    // to count lines.
+    size_t count(const char* data, size_t size, size_t from) const {
+        return count(data, size, from, sKernel);
+    }
+
+    size_t count(const char* data, size_t size, size_t from, Kernel kernel) const;
+
+    // Returns true if kernel can run on this processor.
+    static bool supported(Kernel kernel);
+
+    // The kernel find() uses, the fastest supported unless changed.
+    static Kernel kernel() {
+        return sKernel;
+    }
+
+    // Use kernel, which must be supported, for all finds from now on,
+    // e.g. to compare kernels.  Not thread safe.
+    static void useKernel(Kernel kernel);
+
+private:
+    char mBytes[kMaxBytes];
+    size_t mCount;
+
+    static Kernel sKernel;
+};
+
+#endif //__BYTESET_H__
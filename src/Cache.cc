@@ -0,0 +1,317 @@
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <sstream>
+#include <stdio.h>      // for rename(), snprintf()
+#include <string.h>     // for strerror()
+#include <sys/file.h>   // for flock()
+#include <sys/stat.h>
+#include <sys/time.h>   // for futimes()
+#include <unistd.h>
+#include <vector>
+#ifdef CCH_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#include "Cache.h"
+#include "Util.h"
+
+// Suffix of compressed entry files.
+static const char* kCompressedSuffix = ".z";
+// Extension of the file whose mtime records an entry's last use.
+static const char* kUsedExtension = ".used";
+// Once over the size cap, evict down to this fraction of it, so
+// that every run near the cap doesn't have to pay for an eviction.
+static const double kEvictionLowWater = 0.9;
+
+// Create path and any missing parent directories.
+static bool makeDirectories(const string& path) {
+    for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+        string dir = path.substr(0, slash);
+        if (::mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+            return false;
+        }
+        if (slash == string::npos) {
+            return true;
+        }
+    }
+}
+
+// Compressed entries are the uncompressed size (native byte order)
+// followed by the zlib stream.
+static bool compress(const string& raw, string* compressed) {
+#ifdef CCH_HAVE_ZLIB
+    uint64_t rawSize = raw.size();
+    uLongf size = compressBound(raw.size());
+    compressed->resize(sizeof(rawSize) + size);
+    ::memcpy(&(*compressed)[0], &rawSize, sizeof(rawSize));
+    if (compress2((Bytef*)&(*compressed)[sizeof(rawSize)], &size,
+                  (const Bytef*)raw.data(), raw.size(), Z_BEST_SPEED) != Z_OK) {
+        return false;
+    }
+    compressed->resize(sizeof(rawSize) + size);
+    return true;
+#else
+    (void)raw;
+    (void)compressed;
+    return false;
+#endif
+}
+
+static bool decompress(const string& compressed, string* raw) {
+#ifdef CCH_HAVE_ZLIB
+    uint64_t rawSize;
+    if (compressed.size() < sizeof(rawSize)) {
+        return false;
+    }
+    ::memcpy(&rawSize, compressed.data(), sizeof(rawSize));
+    raw->resize(rawSize);
+    uLongf size = rawSize;
+    return uncompress((Bytef*)&(*raw)[0], &size,
+                      (const Bytef*)compressed.data() + sizeof(rawSize),
+                      compressed.size() - sizeof(rawSize)) == Z_OK
+        && size == rawSize;
+#else
+    (void)compressed;
+    (void)raw;
+    return false;
+#endif
+}
+
+// Hardlink entry into place at output, through a temporary name so that
+// any existing output is replaced atomically.  Unless overwrite, leave an
+// existing output that's already entry, or has the same contents, as it
+// is, so its mtime doesn't change.  Returns false if linking failed.
+static bool linkEntry(const string& entry, const string& output, bool overwrite) {
+    struct stat entryStat, outputStat;
+    if (::stat(entry.c_str(), &entryStat) != 0) {
+        return false;
+    }
+    if (!overwrite && ::lstat(output.c_str(), &outputStat) == 0) {
+        if (outputStat.st_dev == entryStat.st_dev && outputStat.st_ino == entryStat.st_ino) {
+            return true;
+        }
+        string entryContents, outputContents;
+        if (S_ISREG(outputStat.st_mode) && outputStat.st_size == entryStat.st_size
+            && Util::readFromFile(entry, &entryContents)
+            && Util::readFromFile(output, &outputContents)
+            && entryContents == outputContents) {
+            return true;
+        }
+    }
+    string tmp = output + ".cchlink";
+    ::unlink(tmp.c_str());
+    if (::link(entry.c_str(), tmp.c_str()) != 0) {
+        return false;
+    }
+    if (::rename(tmp.c_str(), output.c_str()) != 0) {
+        ::unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Read an entry file, decompressing it if it is the compressed form.
+static bool readEntry(const string& path, string* contents) {
+    if (Util::readFromFile(path, contents)) {
+        return true;
+    }
+    string compressed;
+    return Util::readFromFile(path + kCompressedSuffix, &compressed)
+        && decompress(compressed, contents);
+}
+
+Cache::Cache(const string& directory, uint64_t maxSize, bool compress)
+    : mDirectory(directory), mMaxSize(maxSize), mCompress(compress) {
+}
+
+/* static */ string Cache::key(StringView contents, const string& settings) {
+    // Two independently seeded hashes of each part give a 128-bit key.
+    char key[33];
+    uint64_t a = Util::hash(contents, 0) ^ Util::hash(settings, 2);
+    uint64_t b = Util::hash(contents, 1) ^ Util::hash(settings, 3);
+    snprintf(key, sizeof(key), "%016llx%016llx",
+             (unsigned long long)a, (unsigned long long)b);
+    return key;
+}
+
+string Cache::entryPath(const string& key, const char* extension) const {
+    return mDirectory + "/" + key.substr(0, 2) + "/" + key + extension;
+}
+
+void Cache::countLookup(bool hit) {
+    MutexLock lock(mMutex);
+    if (hit) {
+        mPending.hits++;
+    } else {
+        mPending.misses++;
+    }
+}
+
+void Cache::markUsed(const string& key) {
+    int fd = ::open(entryPath(key, kUsedExtension).c_str(), O_WRONLY|O_CREAT, 0644);
+    if (fd >= 0) {
+        ::futimes(fd, NULL);
+        ::close(fd);
+    }
+}
+
+bool Cache::lookup(const string& key, string* h, string* cc) {
+    bool hit = readEntry(entryPath(key, ".h"), h) && readEntry(entryPath(key, ".cc"), cc);
+    countLookup(hit);
+    if (hit) {
+        markUsed(key);
+    }
+    return hit;
+}
+
+bool Cache::link(const string& key,
+                 const string& hFilename,
+                 const string& ccFilename,
+                 bool overwrite) {
+    if (!linkEntry(entryPath(key, ".h"), hFilename, overwrite)
+        || !linkEntry(entryPath(key, ".cc"), ccFilename, overwrite)) {
+        // Don't count a miss here; the caller falls back to lookup().
+        return false;
+    }
+    countLookup(true);
+    markUsed(key);
+    return true;
+}
+
+void Cache::store(const string& key, const string& h, const string& cc) {
+    string dir = mDirectory + "/" + key.substr(0, 2);
+    if (!makeDirectories(dir)) {
+        return;
+    }
+    string hData = h, ccData = cc;
+    const char* suffix = "";
+    if (mCompress && compress(h, &hData) && compress(cc, &ccData)) {
+        suffix = kCompressedSuffix;
+    } else {
+        hData = h;
+        ccData = cc;
+    }
+    // Store the .h last: lookups read it first, so an entry
+    // only becomes visible once it is complete.
+    if (Util::writeFileAtomically(entryPath(key, ".cc") + suffix, ccData)
+        && Util::writeFileAtomically(entryPath(key, ".h") + suffix, hData)) {
+        MutexLock lock(mMutex);
+        mPending.size += hData.size() + ccData.size();
+    }
+}
+
+bool Cache::flush(Stats* stats, ostream& err) {
+    Stats pending;
+    {
+        MutexLock lock(mMutex);
+        pending = mPending;
+        mPending = Stats();
+    }
+
+    string statsPath = mDirectory + "/stats";
+    int fd = -1;
+    if (!makeDirectories(mDirectory)
+        || (fd = ::open(statsPath.c_str(), O_RDWR|O_CREAT, 0644)) < 0
+        || ::flock(fd, LOCK_EX) != 0) {
+        err << "ERROR: failed to update cache stats " << statsPath <<
+            ": " << strerror(errno) << endl;
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return false;
+    }
+
+    Stats totals;
+    string contents;
+    if (Util::readFromFile(statsPath, &contents)) {
+        istringstream lines(contents);
+        string name;
+        uint64_t value;
+        while (lines >> name >> value) {
+            if (name == "hits") totals.hits = value;
+            else if (name == "misses") totals.misses = value;
+            else if (name == "size") totals.size = value;
+        }
+    }
+    totals.hits += pending.hits;
+    totals.misses += pending.misses;
+    totals.size += pending.size;
+    if (mMaxSize > 0 && totals.size > mMaxSize) {
+        totals.size = evict();
+    }
+
+    stringstream updated;
+    updated << "hits " << totals.hits << "\n" <<
+        "misses " << totals.misses << "\n" <<
+        "size " << totals.size << "\n";
+    contents = updated.str();
+    bool success = ::ftruncate(fd, 0) == 0
+        && ::pwrite(fd, contents.data(), contents.size(), 0) == (ssize_t)contents.size();
+    if (!success) {
+        err << "ERROR: failed to write cache stats " << statsPath <<
+            ": " << strerror(errno) << endl;
+    }
+    ::close(fd); // Also releases the lock.
+    if (stats != NULL) {
+        *stats = totals;
+    }
+    return success;
+}
+
+// An entry's files, sized and ordered by last use.
+struct CacheEntry {
+    string key;
+    time_t lastUse;
+    uint64_t size;
+    vector<string> paths;
+    bool operator<(const CacheEntry& other) const {
+        return lastUse < other.lastUse;
+    }
+};
+
+uint64_t Cache::evict() {
+    vector<string> files;
+    Util::listFiles(mDirectory, "", &files);
+    // Group the entry files by key: <dir>/<xx>/<key>.<ext>[.z]
+    // listFiles() returns them sorted, so an entry's files are adjacent.
+    vector<CacheEntry> entries;
+    for (size_t i = 0; i < files.size(); i++) {
+        size_t slash = files[i].rfind('/');
+        size_t dot = files[i].find('.', slash);
+        if (slash == string::npos || dot == string::npos
+            || files[i].find(".tmp.", dot) != string::npos) {
+            continue;  // Not an entry (stats file, in-progress store).
+        }
+        struct stat st;
+        if (::stat(files[i].c_str(), &st) != 0) {
+            continue;
+        }
+        string key = files[i].substr(slash + 1, dot - slash - 1);
+        if (entries.empty() || entries.back().key != key) {
+            entries.push_back(CacheEntry());
+            entries.back().key = key;
+            entries.back().lastUse = 0;
+            entries.back().size = 0;
+        }
+        CacheEntry& entry = entries.back();
+        // An entry's .used file records its last use, though entries
+        // stored before those were kept have only their own mtimes.
+        entry.lastUse = max(entry.lastUse, st.st_mtime);
+        entry.size += st.st_size;
+        entry.paths.push_back(files[i]);
+    }
+
+    uint64_t total = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        total += entries[i].size;
+    }
+    stable_sort(entries.begin(), entries.end());
+    uint64_t lowWater = mMaxSize * kEvictionLowWater;
+    for (size_t i = 0; i < entries.size() && total > lowWater; i++) {
+        for (size_t j = 0; j < entries[i].paths.size(); j++) {
+            ::unlink(entries[i].paths[j].c_str());
+        }
+        total -= entries[i].size;
+    }
+    return total;
+}
@@ -0,0 +1,90 @@
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include <iostream>
+#include <stdint.h>
+#include <string>
+#include "Mutex.h"
+#include "StringView.h"
+
+using namespace std;
+
+// An on-disk cache of generated outputs, shared by every cch run pointed
+// at the same directory (across checkouts, clean builds and branches).
+//
+// Entries are content addressed: the key is a hash of the .cch contents
+// together with every setting that affects the generated files, so a hit
+// can be written out without tokenizing or parsing the input at all.
+//
+// Each entry is a pair of files, <dir>/<xx>/<key>.h and <key>.cc, holding
+// the exact generated contents (or '.z' suffixed, zlib compressed copies).
+// Its last use is recorded in the mtime of an empty <key>.used file
+// beside it, not in its own, as hardlinked outputs share its inode and
+// would be touched along with it.  Least recently used entries are
+// evicted once the cache grows beyond its size cap.  Hit/miss counts
+// and the total size are kept in <dir>/stats, updated under an flock()
+// so that concurrent cch processes can share a cache.
+//
+// Lookups and stores may be called concurrently from multiple threads.
+//
+class Cache {
+public:
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t size;   // total bytes of all entries.
+        Stats() : hits(0), misses(0), size(0) {}
+    };
+
+    Cache(const string& directory, uint64_t maxSize, bool compress);
+
+    // Compute the key for a .cch with the given contents.  settings must
+    // encode every other input to the generated output (options, paths,
+    // version) in a form that differs whenever the output could.
+    static string key(StringView contents, const string& settings);
+
+    // Fetch the outputs stored under key.
+    // Returns true on a hit, false on a miss.
+    bool lookup(const string& key, string* h, string* cc);
+
+    // Hardlink the (uncompressed) outputs stored under key into place
+    // at hFilename and ccFilename, replacing any existing files.  Unless
+    // overwrite, an existing file that's already the entry's, or has the
+    // same contents, is left untouched.  Returns true on a hit, false on
+    // a miss or if linking isn't possible.
+    bool link(const string& key,
+              const string& hFilename,
+              const string& ccFilename,
+              bool overwrite);
+
+    // Store the outputs for key.  Failure to store is not an error,
+    // as the cache is only an optimization.
+    void store(const string& key, const string& h, const string& cc);
+
+    // Merge this run's hits, misses and stored bytes into the on-disk
+    // totals, then evict least recently used entries if the cache is over
+    // its size cap.  Sets stats (if non-NULL) to the updated totals.
+    // Returns false, after reporting to err, if the stats can't be updated.
+    bool flush(Stats* stats, ostream& err);
+
+private:
+    const string mDirectory;
+    const uint64_t mMaxSize;
+    const bool mCompress;
+
+    Mutex mMutex;    // guards mPending.
+    Stats mPending;  // counts accumulated since the last flush().
+
+    string entryPath(const string& key, const char* extension) const;
+
+    void countLookup(bool hit);
+
+    // Record that the entry for key was just used.
+    void markUsed(const string& key);
+
+    // Remove least recently used entries until the total size is below
+    // the low water mark.  Returns the resulting total size.
+    uint64_t evict();
+};
+
+#endif //__CACHE_H__
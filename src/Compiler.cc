@@ -0,0 +1,181 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>     // for getenv(), mkdtemp()
+#include <string.h>     // for strerror()
+#include <sys/mman.h>   // for memfd_create()
+#include <sys/wait.h>
+#include <unistd.h>
+#include <sstream>
+#include "Compiler.h"
+#include "Util.h"
+
+// Write data to a new file at path.  Returns false on failure.
+static bool writeNew(const string& path, const string& data) {
+    int fd = ::open(path.c_str(), O_WRONLY|O_CREAT|O_EXCL|O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return false;
+    }
+    bool success = Util::writeToDescriptor(fd, data);
+    return ::close(fd) == 0 && success;
+}
+
+// Make a private directory for the header, preferring tmpfs so that
+// it never touches the disk.  Returns the empty string on failure.
+static string makeTempDir() {
+    const char* candidates[] = { "/dev/shm", getenv("TMPDIR"), "/tmp" };
+    for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++) {
+        if (candidates[i] == NULL || !Util::isDirectory(candidates[i])) {
+            continue;
+        }
+        string dirname = string(candidates[i]) + "/cch-XXXXXX";
+        if (::mkdtemp(&dirname[0]) != NULL) {
+            return dirname;
+        }
+    }
+    return "";
+}
+
+static string basename(const string& path) {
+    size_t slash = path.rfind('/');
+    return slash == string::npos ? path : path.substr(slash + 1);
+}
+
+// Start command, returning its pid, or -1 if it couldn't be forked.
+// The child reports to stderr and exits 127 if command can't be run.
+static pid_t spawn(const vector<string>& command) {
+    vector<char*> argv;
+    for (size_t i = 0; i < command.size(); i++) {
+        argv.push_back(const_cast<char*>(command[i].c_str()));
+    }
+    argv.push_back(NULL);
+
+    pid_t pid = ::fork();
+    if (pid == 0) {
+        ::signal(SIGINT, SIG_DFL);
+        ::signal(SIGQUIT, SIG_DFL);
+        ::execvp(argv[0], &argv[0]);
+        string message = "ERROR: failed to run " + command[0] + ": " + strerror(errno) + "\n";
+        Util::writeToDescriptor(STDERR_FILENO, message);
+        ::_exit(127);
+    }
+    return pid;
+}
+
+int Compiler::run(const vector<string>& command,
+                  size_t inputIndex,
+                  const string& cchFilename,
+                  const string& includeDir,
+                  const string& h,
+                  const string& cc,
+                  bool debug,
+                  ostream& err) {
+    // The .cc includes the header by the .cch's name, whatever the
+    // output extensions are.
+    string tempDir = makeTempDir();
+    string hPath = tempDir + "/" + basename(cchFilename) + ".h";
+    if (tempDir.empty() || !writeNew(hPath, h)) {
+        err << "ERROR: failed to write a temporary header for " << cchFilename <<
+            ": " << strerror(errno) << endl;
+        if (!tempDir.empty()) {
+            ::rmdir(tempDir.c_str());
+        }
+        return 2;
+    }
+
+    // Hand over the .cc as an anonymous in-memory file, which the
+    // compiler inherits, falling back to the temporary directory.
+    string ccPath;
+    int ccFd = -1;
+#ifdef MFD_CLOEXEC
+    ccFd = ::memfd_create(basename(cchFilename).c_str(), 0);
+    if (ccFd >= 0 && !Util::writeToDescriptor(ccFd, cc)) {
+        ::close(ccFd);
+        ccFd = -1;
+    }
+    if (ccFd >= 0) {
+        stringstream path;
+        path << "/proc/self/fd/" << ccFd;
+        ccPath = path.str();
+    }
+#endif
+    if (ccFd < 0) {
+        ccPath = tempDir + "/" + basename(cchFilename) + ".cc";
+        if (!writeNew(ccPath, cc)) {
+            err << "ERROR: failed to write a temporary source for " << cchFilename <<
+                ": " << strerror(errno) << endl;
+            ::unlink(hPath.c_str());
+            ::rmdir(tempDir.c_str());
+            return 2;
+        }
+    }
+
+    // The .cc has no extension to go by, so name its language.
+    vector<string> args;
+    for (size_t i = 0; i < command.size(); i++) {
+        if (i != inputIndex) {
+            args.push_back(command[i]);
+            continue;
+        }
+        args.push_back("-x");
+        args.push_back("c++");
+        args.push_back(ccPath);
+        args.push_back("-x");
+        args.push_back("none");
+    }
+    if (inputIndex >= command.size()) {
+        args.push_back("-x");
+        args.push_back("c++");
+        args.push_back(ccPath);
+    }
+    args.push_back("-iquote");
+    args.push_back(tempDir);
+    args.push_back("-iquote");
+    args.push_back(includeDir);
+    if (debug) {
+        err << "[CCH] running";
+        for (size_t i = 0; i < args.size(); i++) {
+            err << " " << args[i];
+        }
+        err << endl;
+    }
+
+    // Like system(), leave interrupting to the compiler, so that the
+    // temporary files are still cleaned up after it.
+    struct sigaction ignore, oldInt, oldQuit;
+    memset(&ignore, 0, sizeof(ignore));
+    ignore.sa_handler = SIG_IGN;
+    sigemptyset(&ignore.sa_mask);
+    ::sigaction(SIGINT, &ignore, &oldInt);
+    ::sigaction(SIGQUIT, &ignore, &oldQuit);
+
+    int status = 2;
+    pid_t pid = spawn(args);
+    if (pid < 0) {
+        err << "ERROR: failed to run " << args[0] << ": " << strerror(errno) << endl;
+    } else {
+        int waitStatus = 0;
+        pid_t waited;
+        do {
+            waited = ::waitpid(pid, &waitStatus, 0);
+        } while (waited < 0 && errno == EINTR);
+        if (waited < 0) {
+            err << "ERROR: failed to wait for " << args[0] << ": " << strerror(errno) << endl;
+        } else if (WIFEXITED(waitStatus)) {
+            status = WEXITSTATUS(waitStatus);
+        } else if (WIFSIGNALED(waitStatus)) {
+            status = 128 + WTERMSIG(waitStatus);
+        }
+    }
+
+    ::sigaction(SIGINT, &oldInt, NULL);
+    ::sigaction(SIGQUIT, &oldQuit, NULL);
+    if (ccFd >= 0) {
+        ::close(ccFd);
+    } else {
+        ::unlink(ccPath.c_str());
+    }
+    ::unlink(hPath.c_str());
+    ::rmdir(tempDir.c_str());
+    return status;
+}
@@ -0,0 +1,35 @@
+#ifndef __COMPILER_H__
+#define __COMPILER_H__
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Runs a compiler on the outputs of a split without writing them to the
+// build directory.  The .h is written to a private directory on tmpfs,
+// where the .cc's '#include' finds it, and the .cc is handed over in
+// memory as /proc/self/fd/<n>.  Diagnostics point at the .cch by way of
+// its #line directives.
+//
+namespace Compiler {
+
+    // Run command (a compiler and its arguments) on the cc and h split
+    // from cchFilename.  If the argument at inputIndex names the input,
+    // the .cc takes its place, otherwise it is appended.  Includes
+    // relative to the .cc resolve against includeDir, where the .cc
+    // would otherwise have been written.
+    // Returns the compiler's exit status (128 plus the signal if killed),
+    // or non-zero after reporting to err if it couldn't be run.
+    int run(const vector<string>& command,
+            size_t inputIndex,
+            const string& cchFilename,
+            const string& includeDir,
+            const string& h,
+            const string& cc,
+            bool debug,
+            ostream& err);
+}
+
+#endif //__COMPILER_H__
@@ -0,0 +1,1289 @@
+#include <algorithm> // for max()
+#include <assert.h> // for assert()
+#include <errno.h>
+#include <fcntl.h> // for open()
+#include <getopt.h> // for getopt()
+#include <limits.h> // for INT_MAX
+#include <stdio.h> // for rename()
+#include <stdlib.h> // for abort()
+#include <string.h> // for strlen()
+#include <sys/stat.h> // for stat()
+#include <unistd.h> // for sysconf(), read(), unlink()
+#include <sstream>
+#include "BatchIO.h"
+#include "Cache.h"
+#include "Compiler.h"
+#include "Driver.h"
+#include "JobServer.h"
+#include "Journal.h"
+#include "MappedFile.h"
+#include "Protocol.h"
+#include "Server.h"
+#include "Splitter.h"
+#include "ThreadPool.h"
+#include "Util.h"
+#include "Version.h"
+#include "Watcher.h"
+
+using namespace Util;
+
+static void version(ostream& err) {
+    err << "CCH - " << Version::kRepoURL << endl <<
+        "Version: " << Version::kBuildVersion << "" << endl;
+}
+
+namespace Defaults {
+    static const char* ccExtension = "cc";
+    static const char* hExtension = "h";
+    static const char* outputFormat = "%p";
+    static const char* inputSuffix = ".cch";
+    static const char* mapSuffix = ".cchmap";
+    static const char* stdinName = "stdin.cch";
+    static const char* cacheSize = "1G";
+};
+
+// The options that control how each input is split and written.
+struct Options {
+    string outputFormat;
+    string ccExtension;
+    string hExtension;
+    bool includeBanner;
+    bool emitLineNumbers;
+    bool overwrite;      // rewrite outputs without comparing them first.
+    bool diffAware;
+    Cache* cache;        // NULL if not caching outputs.
+    bool cacheHardlink;
+    Journal* journal;    // NULL if not journaling.
+    bool ioUring;
+    bool mapInputs;      // mmap large inputs rather than reading them.
+    bool streamInputs;   // split inputs a chunk at a time, in bounded memory.
+    bool incremental;
+    bool debug;
+    string stdinName;    // the name to split an input read from stdin as.
+    bool framed;         // write outputs to stdout, framed, not to files.
+    int hFd;             // descriptors to write outputs to instead of
+    int ccFd;            //   their files, or -1.
+    size_t splitThreads; // threads to split each input across.
+
+    Options()
+        : outputFormat(Defaults::outputFormat),
+          ccExtension(Defaults::ccExtension),
+          hExtension(Defaults::hExtension),
+          includeBanner(true),
+          emitLineNumbers(true),
+          overwrite(false),
+          diffAware(false),
+          cache(NULL),
+          cacheHardlink(false),
+          journal(NULL),
+          ioUring(true),
+          mapInputs(true),
+          streamInputs(false),
+          incremental(false),
+          debug(false),
+          stdinName(Defaults::stdinName),
+          framed(false),
+          hFd(-1),
+          ccFd(-1),
+          splitThreads(1) {}
+
+    // Returns true if any output is streamed rather than written.
+    bool streaming() const {
+        return framed || hFd >= 0 || ccFd >= 0;
+    }
+};
+
+// Parse a size such as '512K', '100M' or '2G' into bytes.
+// Returns false if size is malformed.
+static bool parseSize(const string& size, uint64_t* bytes) {
+    char* end;
+    double value = strtod(size.c_str(), &end);
+    uint64_t multiplier = 1;
+    switch (*end) {
+    case 'k': case 'K': multiplier = 1024ULL; end++; break;
+    case 'm': case 'M': multiplier = 1024ULL * 1024; end++; break;
+    case 'g': case 'G': multiplier = 1024ULL * 1024 * 1024; end++; break;
+    }
+    if (size.empty() || *end != '\0' || value < 0) {
+        return false;
+    }
+    *bytes = value * multiplier;
+    return true;
+}
+
+// Everything besides the .cch contents that determines what is
+// generated for it, as used to key the cache and journal.
+static string outputSettings(const string& cchFilename,
+                            const string& hFilename,
+                            const string& ccFilename,
+                            const Options& options) {
+    string settings;
+    settings.reserve(256);
+    settings += Version::kBuildVersion;
+    settings += '\0';
+    settings += Version::kRepoURL;
+    settings += '\0';
+    settings += cchFilename;
+    settings += '\0';
+    settings += hFilename;
+    settings += '\0';
+    settings += ccFilename;
+    settings += '\0';
+    settings += options.includeBanner ? '1' : '0';
+    settings += options.emitLineNumbers ? '1' : '0';
+    return settings;
+}
+
+// Parse a file descriptor number for --hFd/--ccFd.
+// Returns false if fd is malformed.
+static bool parseDescriptor(const char* arg, int* fd) {
+    char* end;
+    long value = strtol(arg, &end, 10);
+    if (*arg == '\0' || *end != '\0' || value < 0 || value > INT_MAX) {
+        return false;
+    }
+    *fd = value;
+    return true;
+}
+
+// Expand a single --input argument into the list of .cch files it names.
+// An argument of the form '@file' is a response file listing one input
+// per line, and a directory is walked recursively for .cch files.
+// Returns false (after reporting to stderr) if the argument can't be read.
+static bool collectInputs(const string& arg,
+                          vector<string>* inputs,
+                          ostream& err) {
+    vector<string> entries;
+    if (!arg.empty() && arg[0] == '@') {
+        if (!readResponseFile(arg.substr(1), &entries)) {
+            err << "ERROR: failed to read response file: " << arg.substr(1) << endl;
+            return false;
+        }
+    } else {
+        entries.push_back(arg);
+    }
+    bool success = true;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (!isDirectory(entries[i])) {
+            inputs->push_back(entries[i]);
+        } else if (!listFiles(entries[i], Defaults::inputSuffix, inputs)) {
+            err << "ERROR: failed to read input directory: " << entries[i] << endl;
+            success = false;
+        }
+    }
+    return success;
+}
+
+// The state of a single .cch file as it is split into its .cc and .h
+// outputs.  Progress is written to out and failures to err.
+struct Split {
+    string cchFilename;
+    string hFilename;
+    string ccFilename;
+    string mapFilename;
+    string settings;
+    Journal::FileState inputState;
+    MappedFile cch;       // mapped if large, to split in place.
+    bool cchRead;
+    string hContents;
+    string ccContents;
+    string mapContents;   // set if splitting incrementally.
+    MappedFile hExisting; // the outputs as they were, if read.
+    MappedFile ccExisting;
+    string mapExisting;
+    bool fromStdin;       // set if the input is read from stdin.
+    bool hExists;
+    bool ccExists;
+    bool existingRead;
+    bool writeH;
+    bool writeCC;
+    int status;     // 0 on success, or the process exit code for the failure.
+    bool upToDate;  // set if the journal showed the outputs are current.
+    stringstream out;
+    stringstream err;
+
+    explicit Split(const string& _cchFilename)
+        : cchFilename(_cchFilename), cchRead(false), fromStdin(false), hExists(false),
+          ccExists(false), existingRead(false), writeH(false),
+          writeCC(false), status(0), upToDate(false) {}
+};
+
+// The banner to start each output with, if any.
+static string banner(const Options& options) {
+    return options.includeBanner ? Splitter::banner() : "";
+}
+
+// Work out the outputs of split, and check whether the journal shows
+// there's nothing to do.  The input is stat'd before being read, so a
+// change made mid-read is caught next run.  Returns true if the input
+// still needs to be read and split.
+static bool prepareSplit(Split* split, const Options& options) {
+    if (split->cchFilename == "-") {
+        split->fromStdin = true;
+        split->cchFilename = options.stdinName;
+    }
+    string baseOutputFilename;
+    if (!expandOutputPath(options.outputFormat, split->cchFilename, &baseOutputFilename)) {
+        split->err << baseOutputFilename << endl;
+        split->status = 1;
+        return false;
+    }
+    split->ccFilename = baseOutputFilename + "." + options.ccExtension;
+    split->hFilename = baseOutputFilename + "." + options.hExtension;
+    split->mapFilename = baseOutputFilename + Defaults::mapSuffix;
+    split->settings = outputSettings(split->cchFilename, split->hFilename,
+                                     split->ccFilename, options);
+    if (split->fromStdin) {
+        // A pipe has nothing to journal, and can't be read in a batch.
+        split->cchRead = true;
+        if (options.streamInputs) {
+            return true;
+        }
+        if (!readFromDescriptor(STDIN_FILENO, split->cch.buffer())) {
+            split->err << "ERROR: failed to read input from stdin" << endl;
+            split->status = 2;
+            return false;
+        }
+        return true;
+    }
+    if (options.journal != NULL && split->inputState.stat(split->cchFilename)
+        && options.journal->upToDate(split->cchFilename, split->inputState,
+                                     Util::hash(split->settings),
+                                     split->hFilename, split->ccFilename,
+                                     split->cch.buffer(), &split->cchRead)) {
+        split->upToDate = true;
+        return false;
+    }
+    return true;
+}
+
+// Re-split the input from its previous map and outputs, if they can be
+// used.  Returns true if the outputs were re-split.
+static bool resplitContents(Split* split, const Options& options) {
+    Splitter::Map previous, map;
+    size_t retokenized;
+    if (!split->existingRead
+        || !previous.parse(split->mapExisting)
+        || previous.settings != Util::hash(split->settings)
+        || !Splitter::resplit(split->cchFilename, split->cch.contents(), options.emitLineNumbers,
+                              previous, split->hExisting.contents(),
+                              split->ccExisting.contents(),
+                              &split->hContents, &split->ccContents, &map,
+                              &retokenized)) {
+        return false;
+    }
+    split->mapContents = map.serialize();
+    if (options.debug) {
+        split->err << "[CCH] " << split->cchFilename << " re-split incrementally, " <<
+            "re-tokenizing " << retokenized << " of " << split->cch.contents().size() <<
+            " bytes" << endl;
+    }
+    return true;
+}
+
+// Split the contents of the input, incrementally or from the cache if
+// possible.  Returns true if the outputs still need to be written.
+static bool splitContents(Split* split, const Options& options) {
+    split->inputState.hash = Util::hash(split->cch.contents());
+    // Keep stdout clear for streamed outputs.
+    if (!options.streaming()) {
+        split->out << "[CCH] " << split->cchFilename << " split to { " <<
+            split->hFilename << ", " << split->ccFilename << " }" << endl;
+    }
+
+    if (options.incremental && resplitContents(split, options)) {
+        return true;
+    }
+
+    string cacheKey;
+    bool cached = false;
+    if (options.cache != NULL) {
+        cacheKey = Cache::key(split->cch.contents(), split->settings);
+        // Content-aware diffing needs to compare against the existing
+        // outputs, so only hardlink when replacing them on any change.
+        if (options.cacheHardlink && !options.diffAware && !options.streaming()
+            && options.cache->link(cacheKey, split->hFilename, split->ccFilename,
+                                   options.overwrite)) {
+            if (options.journal != NULL && !split->fromStdin) {
+                options.journal->record(split->cchFilename, split->inputState,
+                                        Util::hash(split->settings),
+                                        split->hFilename, 0, split->ccFilename, 0);
+            }
+            return false;
+        }
+        cached = options.cache->lookup(cacheKey, &split->hContents, &split->ccContents);
+    }
+
+    if (!cached) {
+        // Map the split when incremental, so the next can build on it.
+        Splitter::Map map;
+        string error;
+        if (!Splitter::split(split->cchFilename, split->cch.contents(), options.emitLineNumbers,
+                             banner(options), &split->hContents, &split->ccContents,
+                             options.incremental ? &map : NULL, &error,
+                             options.splitThreads)) {
+            split->err << "ERROR: " << error << endl;
+            split->status = 1;
+            return false;
+        }
+        if (options.incremental) {
+            map.settings = Util::hash(split->settings);
+            split->mapContents = map.serialize();
+            if (options.debug) {
+                split->err << "[CCH] " << split->cchFilename << " split in full" << endl;
+            }
+        }
+        if (options.cache != NULL) {
+            options.cache->store(cacheKey, split->hContents, split->ccContents);
+        }
+    }
+    return true;
+}
+
+// Write an output to out framed for --stdout: a line of
+// 'cch <h|cc> <size> <filename>' followed by exactly size bytes.
+static void writeFrame(ostream& out,
+                       const char* kind,
+                       const string& filename,
+                       const string& contents) {
+    out << "cch " << kind << " " << contents.size() << " " << filename << "\n";
+    out.write(contents.data(), contents.size());
+}
+
+// Write the outputs of split that are streamed rather than written to
+// their files, clearing writeH and writeCC for those.
+static void streamOutputs(Split* split, const Options& options) {
+    if (options.framed) {
+        writeFrame(split->out, "h", split->hFilename, split->hContents);
+        writeFrame(split->out, "cc", split->ccFilename, split->ccContents);
+        split->writeH = split->writeCC = false;
+    }
+    if (options.hFd >= 0) {
+        if (!writeToDescriptor(options.hFd, split->hContents)) {
+            split->err << "ERROR: failed to write output to descriptor " << options.hFd << endl;
+            split->status = 2;
+        }
+        split->writeH = false;
+    }
+    if (options.ccFd >= 0) {
+        if (!writeToDescriptor(options.ccFd, split->ccContents)) {
+            split->err << "ERROR: failed to write output to descriptor " << options.ccFd << endl;
+            split->status = 2;
+        }
+        split->writeCC = false;
+    }
+}
+
+// Returns true if an output needn't be rewritten: if it's identical to
+// what exists, or with --diff, differs only in its #line directives.
+static bool unchanged(const string& contents,
+                      const StringView& existing,
+                      const Options& options) {
+    return existing == contents || (options.diffAware && !diff(contents, existing));
+}
+
+// One output of a streamed split, written as it's split: to a
+// descriptor, or to a temporary file renamed over the output once it's
+// complete.  Unless overwriting, it's compared against the existing
+// output as it's written, and that left untouched if identical.
+//
+class StreamedOutput {
+    string mFilename;
+    string mTmpFilename;    // empty unless replacing the output.
+    int mFd;
+    bool mOwned;            // set if mFd is to be closed once written.
+    int mExistingFd;        // the existing output, while it still matches.
+    string mExisting;
+
+public:
+    StreamedOutput() : mFd(-1), mOwned(false), mExistingFd(-1) {}
+
+    ~StreamedOutput() {
+        abandon();
+    }
+
+    const string& filename() const {
+        return mFilename;
+    }
+
+    // Write to fd, which is left open.
+    void toDescriptor(int fd) {
+        mFd = fd;
+    }
+
+    // Start writing filename, comparing it against the existing output
+    // if compare is set.  Returns false if it can't be opened.
+    bool open(const string& filename, bool compare) {
+        mFilename = filename;
+        mFd = openForWriting(filename, &mTmpFilename);
+        mOwned = true;
+        if (compare && !mTmpFilename.empty()) {
+            mExistingFd = ::open(filename.c_str(), O_RDONLY|O_CLOEXEC);
+        }
+        return mFd >= 0;
+    }
+
+    bool write(const string& contents) {
+        if (mExistingFd >= 0
+            && !(readFromDescriptor(mExistingFd, contents.size(), &mExisting)
+                 && mExisting == contents)) {
+            closeExisting();
+        }
+        return writeToDescriptor(mFd, contents);
+    }
+
+    // Finish writing, replacing the output unless it turned out to be
+    // unchanged, which sets unchanged.  Returns false on failure.
+    bool commit(bool* unchanged) {
+        *unchanged = mExistingFd >= 0
+            && readFromDescriptor(mExistingFd, 1, &mExisting) && mExisting.empty();
+        closeExisting();
+        bool ok = !mOwned || ::close(mFd) == 0;
+        mFd = -1;
+        if (!mTmpFilename.empty()) {
+            if (!ok || *unchanged
+                || ::rename(mTmpFilename.c_str(), mFilename.c_str()) != 0) {
+                ::unlink(mTmpFilename.c_str());
+                ok = ok && *unchanged;
+            }
+            mTmpFilename.clear();
+        }
+        return ok;
+    }
+
+    // Stop writing, removing any temporary file.
+    void abandon() {
+        closeExisting();
+        if (mOwned && mFd >= 0) {
+            ::close(mFd);
+        }
+        mFd = -1;
+        if (!mTmpFilename.empty()) {
+            ::unlink(mTmpFilename.c_str());
+            mTmpFilename.clear();
+        }
+    }
+
+private:
+    void closeExisting() {
+        if (mExistingFd >= 0) {
+            ::close(mExistingFd);
+            mExistingFd = -1;
+        }
+    }
+};
+
+// Writes the parts of a streamed split to its outputs.
+//
+class StreamedOutputs : public Splitter::Sink {
+public:
+    StreamedOutput h;
+    StreamedOutput cc;
+    const StreamedOutput* failed;   // the output that couldn't be written.
+
+    StreamedOutputs() : failed(NULL) {}
+
+    bool write(const string& hPart, const string& ccPart) {
+        if (!h.write(hPart)) {
+            failed = &h;
+        } else if (!cc.write(ccPart)) {
+            failed = &cc;
+        }
+        return failed == NULL;
+    }
+};
+
+// Split an input a chunk at a time for --stream, writing the outputs as
+// it goes, so that neither the input nor the outputs are held whole.
+static void streamSplit(Split* split, const Options& options) {
+    if (!prepareSplit(split, options)) {
+        return;
+    }
+    if (!options.streaming()) {
+        split->out << "[CCH] " << split->cchFilename << " split to { " <<
+            split->hFilename << ", " << split->ccFilename << " }" << endl;
+    }
+    int fd = split->fromStdin ? STDIN_FILENO
+        : ::open(split->cchFilename.c_str(), O_RDONLY|O_CLOEXEC);
+    if (fd < 0) {
+        split->err << "ERROR: failed to open input: " << split->cchFilename << endl;
+        split->status = 2;
+        return;
+    }
+    StreamedOutputs outputs;
+    if (options.hFd >= 0) {
+        outputs.h.toDescriptor(options.hFd);
+    } else if (!outputs.h.open(split->hFilename, !options.overwrite)) {
+        outputs.failed = &outputs.h;
+    }
+    if (options.ccFd >= 0) {
+        outputs.cc.toDescriptor(options.ccFd);
+    } else if (outputs.failed == NULL && !outputs.cc.open(split->ccFilename, !options.overwrite)) {
+        outputs.failed = &outputs.cc;
+    }
+
+    Splitter::Stream stream(split->cchFilename, options.emitLineNumbers, banner(options),
+                            &outputs);
+    vector<char> chunk(Splitter::Stream::kChunkSize);
+    bool fed = (outputs.failed == NULL);
+    bool read = true;
+    while (fed) {
+        ssize_t n = ::read(fd, &chunk[0], chunk.size());
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            read = (n == 0);
+            break;
+        }
+        fed = stream.feed(&chunk[0], n);
+    }
+    if (!split->fromStdin) {
+        ::close(fd);
+    }
+    if (!read) {
+        split->err << "ERROR: failed to read input: " << split->cchFilename << endl;
+        split->status = 2;
+        return;
+    }
+    if (fed && !stream.finish() && outputs.failed == NULL) {
+        split->err << "ERROR: " << stream.error() << endl;
+        split->status = 1;
+        return;
+    }
+    StreamedOutput* written[] = { &outputs.cc, &outputs.h };
+    for (size_t i = 0; i < 2 && outputs.failed == NULL; i++) {
+        bool unchanged;
+        if (!written[i]->commit(&unchanged)) {
+            outputs.failed = written[i];
+        } else if (unchanged && options.debug) {
+            split->err << "Contents of " << written[i]->filename() <<
+                " unchanged, skipping writing" << endl;
+        }
+    }
+    if (outputs.failed != NULL) {
+        split->err << "ERROR: failed to write output: " << outputs.failed->filename() << endl;
+        split->status = 2;
+    }
+}
+
+// Split a batch of .cch files, reading the inputs, reading existing
+// outputs to compare against, and writing the outputs a whole batch at
+// a time.
+static void splitBatch(const vector<Split*>& splits,
+                       const Options& options,
+                       BatchIO* io) {
+    vector<BatchIO::Request> reads;
+    vector<Split*> reading;
+    for (size_t i = 0; i < splits.size(); i++) {
+        Split* split = splits[i];
+        if (prepareSplit(split, options) && !split->cchRead) {
+            reads.push_back(options.mapInputs
+                            ? BatchIO::Request(split->cchFilename, &split->cch)
+                            : BatchIO::Request(split->cchFilename, split->cch.buffer()));
+            reading.push_back(split);
+        }
+    }
+    // Splitting incrementally builds on the previous map and outputs,
+    // which may well not exist.
+    size_t inputReads = reads.size();
+    vector<Split*> previous;
+    if (options.incremental) {
+        for (size_t i = 0; i < splits.size(); i++) {
+            Split* split = splits[i];
+            if (split->status == 0 && !split->upToDate) {
+                reads.push_back(BatchIO::Request(split->mapFilename, &split->mapExisting));
+                reads.push_back(BatchIO::Request(split->hFilename, &split->hExisting));
+                reads.push_back(BatchIO::Request(split->ccFilename, &split->ccExisting));
+                previous.push_back(split);
+            }
+        }
+    }
+    io->read(&reads);
+    for (size_t i = 0; i < inputReads; i++) {
+        if (!reads[i].ok) {
+            reading[i]->err << "ERROR: failed to open input: " <<
+                reading[i]->cchFilename << endl;
+            reading[i]->status = 2;
+        }
+    }
+    for (size_t i = 0; i < previous.size(); i++) {
+        const BatchIO::Request* read = &reads[inputReads + 3*i];
+        if (!read[0].ok) {
+            previous[i]->mapExisting.clear();
+        }
+        previous[i]->hExists = read[1].ok;
+        previous[i]->ccExists = read[2].ok;
+        previous[i]->existingRead = true;
+    }
+
+    vector<Split*> writing;
+    for (size_t i = 0; i < splits.size(); i++) {
+        Split* split = splits[i];
+        if (split->status == 0 && !split->upToDate && splitContents(split, options)) {
+            split->writeCC = split->writeH = true;
+            if (options.streaming()) {
+                streamOutputs(split, options);
+            }
+            writing.push_back(split);
+        }
+    }
+
+    if (!options.overwrite) {
+        // Skip rewriting outputs whose contents haven't changed, so that
+        // they aren't rebuilt.
+        reads.clear();
+        vector<Split*> comparing;
+        for (size_t i = 0; i < writing.size(); i++) {
+            if (!writing[i]->existingRead && (writing[i]->writeCC || writing[i]->writeH)) {
+                reads.push_back(BatchIO::Request(writing[i]->ccFilename, &writing[i]->ccExisting));
+                reads.push_back(BatchIO::Request(writing[i]->hFilename, &writing[i]->hExisting));
+                comparing.push_back(writing[i]);
+            }
+        }
+        io->read(&reads);
+        for (size_t i = 0; i < comparing.size(); i++) {
+            comparing[i]->ccExists = reads[2*i].ok;
+            comparing[i]->hExists = reads[2*i+1].ok;
+            comparing[i]->existingRead = true;
+        }
+        for (size_t i = 0; i < writing.size(); i++) {
+            Split* split = writing[i];
+            if (split->writeCC && split->ccExists
+                && unchanged(split->ccContents, split->ccExisting.contents(), options)) {
+                split->writeCC = false;
+                if (options.diffAware || options.debug) {
+                    split->err << "Contents of " << split->ccFilename <<
+                        " unchanged, skipping writing" << endl;
+                }
+            }
+            if (split->writeH && split->hExists
+                && unchanged(split->hContents, split->hExisting.contents(), options)) {
+                split->writeH = false;
+                if (options.diffAware || options.debug) {
+                    split->err << "Contents of " << split->hFilename <<
+                        " unchanged, skipping writing" << endl;
+                }
+            }
+        }
+    }
+
+    vector<BatchIO::Request> writes;
+    vector<Split*> written;
+    for (size_t i = 0; i < writing.size(); i++) {
+        Split* split = writing[i];
+        if (split->writeCC) {
+            writes.push_back(BatchIO::Request(split->ccFilename, &split->ccContents));
+            written.push_back(split);
+        }
+        if (split->writeH) {
+            writes.push_back(BatchIO::Request(split->hFilename, &split->hContents));
+            written.push_back(split);
+        }
+        // The map is only of use alongside outputs it exactly describes,
+        // which an output --diff left with stale #line directives isn't.
+        // Failing to write it only costs a full split next time.
+        if (!split->mapContents.empty() && split->mapContents != split->mapExisting
+            && (split->writeH || split->hExisting.contents() == split->hContents)
+            && (split->writeCC || split->ccExisting.contents() == split->ccContents)) {
+            writes.push_back(BatchIO::Request(split->mapFilename, &split->mapContents));
+            written.push_back(NULL);
+        }
+    }
+    io->write(&writes);
+    for (size_t i = 0; i < writes.size(); i++) {
+        if (!writes[i].ok && written[i] != NULL) {
+            written[i]->err << "ERROR: failed to write output: " <<
+                writes[i].filename << endl;
+            written[i]->status = 2;
+        }
+    }
+
+    if (options.journal != NULL) {
+        for (size_t i = 0; i < writing.size(); i++) {
+            Split* split = writing[i];
+            if (split->status == 0 && !split->fromStdin) {
+                options.journal->record(split->cchFilename, split->inputState,
+                                        Util::hash(split->settings),
+                                        split->hFilename, Util::hash(split->hContents),
+                                        split->ccFilename, Util::hash(split->ccContents));
+            }
+        }
+    }
+}
+
+// Splits each batch of inputs as a ThreadPool job.  The console output
+// of each file is buffered and written out in one piece once its batch
+// is done, so that concurrently split files don't interleave.
+//
+class SplitRunner : public ThreadPool::Runner {
+    const vector<string>& mInputs;
+    const vector<vector<size_t> >& mBatches;
+    const Options& mOptions;
+    vector<int> mStatus;
+    size_t mUpToDate;
+    ostream& mOut;
+    ostream& mErr;
+    Mutex mConsoleMutex;
+
+public:
+    SplitRunner(const vector<string>& inputs,
+                const vector<vector<size_t> >& batches,
+                const Options& options,
+                ostream& out, ostream& err)
+        : mInputs(inputs), mBatches(batches), mOptions(options),
+          mStatus(inputs.size(), 0), mUpToDate(0), mOut(out), mErr(err) {}
+
+    void runJob(size_t job) {
+        const vector<size_t>& batch = mBatches[job];
+        vector<Split*> splits;
+        for (size_t i = 0; i < batch.size(); i++) {
+            splits.push_back(new Split(mInputs[batch[i]]));
+        }
+        if (mOptions.streamInputs) {
+            for (size_t i = 0; i < splits.size(); i++) {
+                streamSplit(splits[i], mOptions);
+            }
+        } else {
+            BatchIO io(mOptions.ioUring);
+            splitBatch(splits, mOptions, &io);
+        }
+
+        MutexLock lock(mConsoleMutex);
+        for (size_t i = 0; i < batch.size(); i++) {
+            Split* split = splits[i];
+            string out = split->out.str(), err = split->err.str();
+            if (!out.empty()) {
+                mOut << out << flush;
+            }
+            if (!err.empty()) {
+                mErr << err << flush;
+            }
+            mStatus[batch[i]] = split->status;
+            mUpToDate += split->upToDate;
+            delete split;
+        }
+    }
+
+    // The number of inputs skipped as already up to date.
+    size_t upToDate() const {
+        return mUpToDate;
+    }
+
+    int status(size_t input) const {
+        return mStatus[input];
+    }
+};
+
+// Orders jobs by decreasing input file size.
+//
+struct LargestFirst {
+    const vector<off_t>& sizes;
+    LargestFirst(const vector<off_t>& _sizes) : sizes(_sizes) {}
+    bool operator()(size_t a, size_t b) const {
+        return sizes[a] > sizes[b];
+    }
+};
+
+// Returns the order in which to run the inputs: as given when running
+// serially, otherwise largest first so that the biggest inputs don't
+// start last and leave the run waiting on a single thread.
+static vector<size_t> scheduleInputs(const vector<string>& inputs,
+                                     size_t numThreads) {
+    vector<size_t> order(inputs.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    if (numThreads > 1) {
+        vector<off_t> sizes(inputs.size(), 0);
+        for (size_t i = 0; i < inputs.size(); i++) {
+            struct stat st;
+            if (::stat(inputs[i].c_str(), &st) == 0) {
+                sizes[i] = st.st_size;
+            }
+        }
+        stable_sort(order.begin(), order.end(), LargestFirst(sizes));
+    }
+    return order;
+}
+
+// The most inputs whose file I/O is batched together.
+static const size_t kMaxBatchSize = 64;
+
+// Group the inputs, in the given order, into batches to be split as
+// ThreadPool jobs.  When running in parallel, batches are kept small
+// enough that there are several per thread to balance between them.
+static vector<vector<size_t> > batchInputs(const vector<size_t>& order,
+                                           size_t numThreads) {
+    size_t batchSize = kMaxBatchSize;
+    if (numThreads > 1) {
+        batchSize = max((size_t)1, min(batchSize, order.size() / (numThreads * 4)));
+    }
+    vector<vector<size_t> > batches;
+    for (size_t i = 0; i < order.size(); i += batchSize) {
+        batches.push_back(vector<size_t>(order.begin() + i,
+                                         order.begin() + min(i + batchSize, order.size())));
+    }
+    return batches;
+}
+
+// Split each of the inputs, keeping the most severe failure as the
+// exit code for the whole run.  Returns that exit code.
+static int splitInputs(const vector<string>& inputs,
+                       const Options& options,
+                       size_t numThreads,
+                       ostream& out,
+                       ostream& err) {
+    // Under 'make -j', share make's job slots rather than adding to them.
+    JobServer* jobServer = NULL;
+    if (numThreads > 1) {
+        jobServer = JobServer::fromMakeflags(getenv("MAKEFLAGS"), err);
+    }
+    vector<vector<size_t> > batches = batchInputs(scheduleInputs(inputs, numThreads),
+                                                   numThreads);
+    vector<size_t> jobs(batches.size());
+    for (size_t i = 0; i < jobs.size(); i++) {
+        jobs[i] = i;
+    }
+    // With fewer inputs than threads, split each across the spare ones.
+    // Not under a jobserver though, whose slots are already spoken for.
+    Options splitOptions = options;
+    if (jobServer == NULL && inputs.size() < numThreads) {
+        splitOptions.splitThreads = numThreads / max((size_t)1, inputs.size());
+    }
+    SplitRunner runner(inputs, batches, splitOptions, out, err);
+    ThreadPool(numThreads, jobServer).run(jobs, &runner);
+    delete jobServer;
+    int status = 0;
+    size_t failures = 0;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        if (runner.status(i) != 0) {
+            failures++;
+            status = max(status, runner.status(i));
+        }
+    }
+    if (inputs.size() > 1 && failures > 0) {
+        err << "[CCH] " << failures << " of " << inputs.size() <<
+            " inputs failed to split" << endl;
+    }
+
+    if (options.journal != NULL) {
+        if (!options.journal->save(err)) {
+            status = max(status, 2);
+        }
+        if (inputs.size() > 1 && runner.upToDate() > 0) {
+            out << "[CCH] " << runner.upToDate() << " of " << inputs.size() <<
+                " inputs already up to date" << endl;
+        }
+    }
+    return status;
+}
+
+// Split a single input in memory and compile it with command, for
+// --exec.  The input is either among inputArgs or named in the command
+// by its suffix.  Returns the compiler's exit status.
+static int compileInput(const vector<string>& inputArgs,
+                        const vector<string>& command,
+                        const Options& options,
+                        ostream& err) {
+    vector<string> inputs;
+    for (size_t i = 0; i < inputArgs.size(); i++) {
+        if (!collectInputs(inputArgs[i], &inputs, err)) {
+            return 2;
+        }
+    }
+    size_t inputIndex = command.size();
+    for (size_t i = 1; i < command.size(); i++) {
+        const string& arg = command[i];
+        size_t suffixLength = strlen(Defaults::inputSuffix);
+        if (arg.size() > suffixLength && arg[0] != '-'
+            && arg.compare(arg.size() - suffixLength, suffixLength,
+                           Defaults::inputSuffix) == 0) {
+            inputs.push_back(arg);
+            inputIndex = i;
+        }
+    }
+    if (inputs.size() != 1) {
+        err << "ERROR: --exec compiles exactly one input, given " << inputs.size() << endl;
+        return 1;
+    }
+
+    // Includes relative to the .cc resolve from where it would have
+    // been written.
+    bool fromStdin = (inputs[0] == "-");
+    const string& cchFilename = fromStdin ? options.stdinName : inputs[0];
+    string baseOutputFilename;
+    if (!expandOutputPath(options.outputFormat, cchFilename, &baseOutputFilename)) {
+        err << baseOutputFilename << endl;
+        return 1;
+    }
+    size_t slash = baseOutputFilename.rfind('/');
+    string includeDir = (slash == string::npos)
+        ? "."
+        : baseOutputFilename.substr(0, max<size_t>(slash, 1));
+
+    MappedFile cch;
+    string h, cc;
+    bool read = fromStdin ? readFromDescriptor(STDIN_FILENO, cch.buffer())
+        : options.mapInputs ? cch.open(cchFilename)
+        : readFromFile(cchFilename, cch.buffer());
+    if (!read) {
+        err << "ERROR: failed to open input: " << inputs[0] << endl;
+        return 2;
+    }
+    string error;
+    if (!Splitter::split(cchFilename, cch.contents(), options.emitLineNumbers, banner(options),
+                         &h, &cc, NULL, &error)) {
+        err << "ERROR: " << error << endl;
+        return 1;
+    }
+    return Compiler::run(command, inputIndex, cchFilename, includeDir, h, cc,
+                         options.debug, err);
+}
+
+int Driver::run(int argc, char** argv, ostream& out, ostream& err) {
+    vector<string> inputArgs;
+    Options options;
+    size_t numThreads = 1;
+    bool serve = false;
+    string socketPath;
+    string cacheDir;
+    uint64_t cacheSize = 0;
+    parseSize(Defaults::cacheSize, &cacheSize);
+    bool cacheCompress = false;
+    bool cacheStats = false;
+    string journalFile;
+    vector<string> watchDirs;
+    bool exec = false;
+    bool usage = false;
+
+    static struct option long_options[] = {
+        {"help", no_argument, 0, 'h'},
+        {"debug", no_argument, 0, 'd'},
+        {"input", required_argument, 0, 'i'},
+        {"jobs", required_argument, 0, 'j'},
+        {"output", required_argument, 0, 'o'},
+        {"version", no_argument, 0, 'v'},
+        {"noBanner", no_argument, 0, 1},
+        {"noLineNumbers", no_argument, 0, 2},
+        {"ccExtension", required_argument, 0, 3},
+        {"hExtension", required_argument, 0, 4},
+        {"diff", no_argument, 0, 5},
+        {"serve", optional_argument, 0, 6},
+        {"cacheDir", required_argument, 0, 7},
+        {"cacheSize", required_argument, 0, 8},
+        {"cacheCompress", no_argument, 0, 9},
+        {"cacheHardlink", no_argument, 0, 10},
+        {"cacheStats", no_argument, 0, 11},
+        {"journal", required_argument, 0, 12},
+        {"noIoUring", no_argument, 0, 13},
+        {"watch", required_argument, 0, 14},
+        {"incremental", no_argument, 0, 15},
+        {"exec", no_argument, 0, 16},
+        {"stdout", no_argument, 0, 17},
+        {"hFd", required_argument, 0, 18},
+        {"ccFd", required_argument, 0, 19},
+        {"stdinName", required_argument, 0, 20},
+        {"noMmap", no_argument, 0, 21},
+        {"overwrite", no_argument, 0, 22},
+        {"stream", no_argument, 0, 23},
+        {0, 0, 0, 0}
+    };
+
+    // Reset getopt, as run() may be called repeatedly by the server.
+#ifdef __GLIBC__
+    optind = 0;
+#else
+    optreset = 1;
+    optind = 1;
+#endif
+    for (int c = 0, optindex = 0;
+         (c = getopt_long(argc, argv, "hdi:j:o:v",
+                          long_options, &optindex)) != -1; ) {
+        switch (c) {
+        case 1:   options.includeBanner = false; break;
+        case 2:   options.emitLineNumbers = false; break;
+        case 3:   options.ccExtension = optarg; break;
+        case 4:   options.hExtension = optarg; break;
+        case 5:   options.diffAware = true; break;
+        case 6:   serve = true; socketPath = optarg ? optarg : ""; break;
+        case 7:   cacheDir = optarg; break;
+        case 8:
+            if (!parseSize(optarg, &cacheSize)) {
+                err << "ERROR: invalid cache size '" << optarg << "'" << endl;
+                usage = true;
+            }
+            break;
+        case 9:   cacheCompress = true; break;
+        case 10:  options.cacheHardlink = true; break;
+        case 11:  cacheStats = true; break;
+        case 12:  journalFile = optarg; break;
+        case 13:  options.ioUring = false; break;
+        case 14:
+            // Watched directories are also inputs, split up front
+            // and then re-split as they change.
+            watchDirs.push_back(optarg);
+            inputArgs.push_back(optarg);
+            options.diffAware = true;
+            break;
+        case 15:  options.incremental = true; break;
+        case 16:  exec = true; break;
+        case 17:  options.framed = true; break;
+        case 18:
+        case 19:
+            if (!parseDescriptor(optarg, c == 18 ? &options.hFd : &options.ccFd)) {
+                err << "ERROR: invalid file descriptor '" << optarg << "'" << endl;
+                usage = true;
+            }
+            break;
+        case 20:  options.stdinName = optarg; break;
+        case 21:  options.mapInputs = false; break;
+        case 22:  options.overwrite = true; break;
+        case 23:  options.streamInputs = true; break;
+        case 'd': options.debug = true; break;
+        case 'i': inputArgs.push_back(optarg); break;
+        case 'j': {
+            char* end;
+            long jobs = strtol(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0' || jobs < 0) {
+                err << "ERROR: invalid job count '" << optarg << "'" << endl;
+                usage = true;
+            } else if (jobs == 0) {
+                // Use one thread per online processor.
+                numThreads = max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+            } else {
+                numThreads = jobs;
+            }
+            break;
+        }
+        case 'o': options.outputFormat = optarg; break;
+        case 'v': version(err); return 1;
+        case 'h':
+        case '?':
+        default:  usage = true; break;
+        }
+    }
+    if (options.streamInputs
+        && (options.diffAware || options.incremental || !cacheDir.empty()
+            || !journalFile.empty() || options.framed || exec)) {
+        // Each of which needs an input or its outputs whole.
+        err << "ERROR: --stream can't be combined with --diff, --watch, --incremental,\n"
+            "--cacheDir, --journal, --stdout or --exec" << endl;
+        usage = true;
+    }
+    if (cacheDir.empty() && !options.streamInputs && getenv("CCH_CACHE_DIR") != NULL) {
+        cacheDir = getenv("CCH_CACHE_DIR");
+    }
+    if (cacheStats && cacheDir.empty()) {
+        err << "ERROR: --cacheStats requires a cache directory" << endl;
+        usage = true;
+    }
+    if (options.overwrite && options.diffAware) {
+        err << "ERROR: --overwrite can't be combined with --diff or --watch" << endl;
+        usage = true;
+    }
+    // With --exec, the arguments after '--' are the compiler command.
+    vector<string> command;
+    if (exec) {
+        command.assign(argv + optind, argv + argc);
+        optind = argc;
+        if (command.empty()) {
+            err << "ERROR: --exec requires a compiler command after '--'" << endl;
+            usage = true;
+        }
+    }
+    if (usage
+        || (optind < argc)
+        || (inputArgs.empty() && !serve && !cacheStats && !exec)) {
+
+        if (optind < argc) {
+            err << "Unrecognized arguments:";
+            for (int i = optind; i < argc; i++) {
+                err << " " << argv[i];
+            }
+            err << endl << endl;
+        }
+        if (usage) {
+            version(err);
+        }
+        err << "Usage: " << argv[0] << " [OPTIONS] -i/--input=<file> " <<
+            " [-o/--output=<format string>]" << endl << endl <<
+            "   Required:\n"
+            "      -i <file>, --input=<file> Input CCH file, may be repeated. A directory\n"
+            "                                is searched recursively for " << Defaults::inputSuffix << " files,\n"
+            "                                '@<file>' reads inputs one per line, and '-'\n"
+            "                                reads stdin\n"
+            "   Optional:\n"
+            "      -o <fmt>, --output=<fmt>  Output location format string (Default: \"" << Defaults::outputFormat << "\")\n"
+            "      -j <n>, --jobs=<n>        Split up to n inputs in parallel, 0 for one\n"
+            "                                per processor (Default: 1). Under make, also\n"
+            "                                limited by make's jobserver slots. Otherwise,\n"
+            "                                large inputs are split across spare threads\n"
+            "      -d, --debug               Enable debug output\n"
+            "      -h, --help                Show this help menu and exit\n"
+            "      -v, --version             Show program version and exit\n"
+            "      --noLineNumbers           Don't emit #line directives\n"
+            "      --noBanner                Don't add CCH banner to generated files\n"
+            "      --ccExtension=<ext>       Set output extension (Default: " << Defaults::ccExtension << ")\n"
+            "      --hExtension=<ext>        Set output extension (Default: " << Defaults::hExtension << "\n"
+            "      --cacheDir=<dir>          Cache generated outputs in dir, shared between\n"
+            "                                runs and checkouts (Default: $CCH_CACHE_DIR)\n"
+            "      --cacheSize=<size>        Cache size cap, e.g. 500M (Default: " << Defaults::cacheSize << ")\n"
+            "      --cacheCompress           Compress newly cached outputs\n"
+            "      --cacheHardlink           Hardlink outputs from the cache on a hit\n"
+            "      --cacheStats              Print cache hit/miss statistics\n"
+            "      --journal=<file>          Record input/output state in file, and skip\n"
+            "                                inputs whose outputs are already up to date\n"
+            "      --noIoUring               Read and write files one at a time rather than\n"
+            "                                in batches through io_uring\n"
+            "      --noMmap                  Read large inputs into memory rather than\n"
+            "                                mapping them\n"
+            "      --overwrite               Rewrite every output, rather than leaving those\n"
+            "                                identical to the existing file untouched\n"
+            "      --stream                  Split each input a chunk at a time, writing the\n"
+            "                                outputs as it goes, so that memory is bounded\n"
+            "                                by the largest top level declaration\n"
+            "      --watch=<dir>             Split the .cch files in dir, then keep re-splitting\n"
+            "                                them as they change, until interrupted. May be\n"
+            "                                repeated. Implies --diff\n"
+            "      --incremental             Re-split only the top level declarations that\n"
+            "                                changed since the last split, recording where\n"
+            "                                they are in a " << Defaults::mapSuffix << " file next to the outputs\n"
+            "      --stdout                  Write the outputs to stdout, each framed by a\n"
+            "                                'cch <h|cc> <size> <path>' line, not to files\n"
+            "      --hFd=<n>, --ccFd=<n>     Write the header or implementation to file\n"
+            "                                descriptor n instead of its file\n"
+            "      --stdinName=<name>        Name to split the input '-' (stdin) as\n"
+            "                                (Default: " << Defaults::stdinName << ")\n"
+            "      --exec -- <command...>    Split the input in memory and compile it with\n"
+            "                                command, e.g. 'g++ -c -o foo.o', without writing\n"
+            "                                the outputs. The input may instead be named in\n"
+            "                                the command\n"
+            "      --serve[=<socket>]        Run as a resident server, splitting requests\n"
+            "                                from cch-client (Default socket: " << Protocol::defaultSocketPath() << ")\n"
+            "   Experimental:    (**subject to change/removal**)\n"
+            "      --diff                    Also leave an output untouched if only its #line\n"
+            "                                directives changed\n";
+        return 1;
+    }
+
+    if (!watchDirs.empty() && Server::serving()) {
+        err << "ERROR: --watch can't be run by the server" << endl;
+        return 1;
+    }
+
+    if (exec) {
+        if (Server::serving() || serve || !watchDirs.empty()) {
+            err << "ERROR: --exec can't be combined with --serve or --watch" << endl;
+            return 1;
+        }
+        return compileInput(inputArgs, command, options, err);
+    }
+
+    if (serve) {
+        if (!inputArgs.empty()) {
+            err << "ERROR: --serve does not take inputs" << endl;
+            return 1;
+        }
+        if (Server::serving()) {
+            err << "ERROR: already serving" << endl;
+            return 1;
+        }
+        return Server::serve(!socketPath.empty()
+                             ? socketPath
+                             : Protocol::defaultSocketPath(), err);
+    }
+
+    // Expand directories and response files into the full input list.
+    // An input that can't be expanded fails the run but doesn't stop
+    // the remaining inputs from being split.
+    int status = 0;
+    vector<string> inputs;
+    for (size_t i = 0; i < inputArgs.size(); i++) {
+        if (!collectInputs(inputArgs[i], &inputs, err)) {
+            status = 2;
+        }
+    }
+    size_t stdinInputs = count(inputs.begin(), inputs.end(), "-");
+    bool descriptors = options.hFd >= 0 || options.ccFd >= 0;
+    if (stdinInputs > 1) {
+        err << "ERROR: stdin can only be read as one input" << endl;
+        return 1;
+    }
+    if (Server::serving() && (stdinInputs > 0 || descriptors)) {
+        // They would be the server's own, not the client's.
+        err << "ERROR: stdin and --hFd/--ccFd can't be used by the server" << endl;
+        return 1;
+    }
+    if (descriptors && inputs.size() != 1) {
+        err << "ERROR: --hFd/--ccFd require exactly one input" << endl;
+        return 1;
+    }
+    if (options.streaming() && (options.incremental || !journalFile.empty())) {
+        err << "ERROR: --incremental and --journal need outputs written to files" << endl;
+        return 1;
+    }
+
+    Cache* cache = NULL;
+    if (!cacheDir.empty()) {
+        cache = new Cache(cacheDir, cacheSize, cacheCompress);
+        options.cache = cache;
+    }
+
+    Journal* journal = NULL;
+    if (!journalFile.empty()) {
+        journal = new Journal(journalFile);
+        if (!journal->load(err)) {
+            delete cache;
+            delete journal;
+            return 2;
+        }
+        options.journal = journal;
+    }
+
+    // Watch before the initial split, so that no saves are missed.
+    Watcher* watcher = NULL;
+    if (!watchDirs.empty()) {
+        watcher = new Watcher(Defaults::inputSuffix);
+        for (size_t i = 0; i < watchDirs.size(); i++) {
+            if (!watcher->add(watchDirs[i], err)) {
+                delete watcher;
+                delete cache;
+                delete journal;
+                return 2;
+            }
+        }
+    }
+
+    status = max(status, splitInputs(inputs, options, numThreads, out, err));
+
+    if (watcher != NULL) {
+        // Keep re-splitting changed inputs until stopped, at which point
+        // only a failure to keep watching is reported in the exit code.
+        err << "[CCH] watching for changes" << endl;
+        vector<string> changed;
+        while (watcher->wait(&changed, err)) {
+            splitInputs(changed, options, numThreads, out, err);
+            if (cache != NULL) {
+                cache->flush(NULL, err);
+            }
+        }
+        status = watcher->stopped() ? 0 : 2;
+        delete watcher;
+    }
+    delete journal;
+
+    if (cache != NULL) {
+        Cache::Stats stats;
+        if (!cache->flush(&stats, err)) {
+            status = max(status, 2);
+        } else if (cacheStats) {
+            uint64_t lookups = stats.hits + stats.misses;
+            out << "[CCH] cache " << cacheDir << ": " <<
+                stats.hits << " hits, " << stats.misses << " misses (" <<
+                (lookups > 0 ? 100 * stats.hits / lookups : 0) << "% hit rate), " <<
+                stats.size << " of " << cacheSize << " bytes used" << endl;
+        }
+        delete cache;
+    }
+    return status;
+}
@@ -0,0 +1,16 @@
+#ifndef __DRIVER_H__
+#define __DRIVER_H__
+
+#include <iostream>
+
+using namespace std;
+
+namespace Driver {
+
+    // Parse the command line and run cch, as invoked from main().
+    // Progress output is written to out, and errors/usage to err.
+    // Returns the process exit code.
+    int run(int argc, char** argv, ostream& out, ostream& err);
+}
+
+#endif //__DRIVER_H__
@@ -2,23 +2,55 @@
 #define __INTERFACES_H__
 
 struct Token;
-struct Location;
 class StringView;
 
+// A parser that can be chosen at runtime, e.g. by a plugin.  The
+// pipeline's own stages (see Parser.h) are composed as templates instead,
+// and are called directly, so ParserAdapter wraps one as a Parser when
+// one is needed.
+//
 class Parser {
 public:
     virtual ~Parser() {}
 
     virtual void acceptToken(const Token& token) = 0;
+
+    // Returns true if a '{' following the tokens accepted so far opens a
+    // class or namespace body, whose declarations are then tokenized in
+    // place, between an OPENBRACE and a CLOSEBRACE, rather than captured
+    // whole as a BRACE_GROUP.
+    virtual bool opensScope() const {
+        return false;
+    }
+};
+
+// Adapts any parser stage, with acceptToken() and opensScope() methods,
+// to the Parser interface.
+//
+template <class Stage>
+class ParserAdapter : public Parser {
+    Stage& mStage;
+public:
+    explicit ParserAdapter(Stage& stage)
+        : mStage(stage) {}
+
+    void acceptToken(const Token& token) {
+        mStage.acceptToken(token);
+    }
+
+    bool opensScope() const {
+        return mStage.opensScope();
+    }
 };
 
 class Tokenizer {
 public:
     virtual ~Tokenizer() {}
 
+    // Tokenize code, whose first line is firstLine, into emitter.
     virtual void tokenize(const StringView& code,
                           Parser* emitter,
-                          Location start) = 0;
+                          size_t firstLine) = 0;
 };
 
 #endif //__INTERFACES_H__
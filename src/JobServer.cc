@@ -0,0 +1,155 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>      // for snprintf()
+#include <stdlib.h>     // for strtol()
+#include <unistd.h>
+#include <sstream>
+#include "JobServer.h"
+
+// Open our own non-blocking file description for the read end of the
+// pipe behind fd.  Returns the new fd, or -1 on failure.
+static int reopenNonBlocking(int fd) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+    return ::open(path, O_RDONLY|O_NONBLOCK|O_CLOEXEC);
+}
+
+// Parse a '<read fd>,<write fd>' pair.
+static bool parseFds(const string& value, int* readFd, int* writeFd) {
+    const char* str = value.c_str();
+    char* end;
+    long r = strtol(str, &end, 10);
+    if (end == str || *end != ',') {
+        return false;
+    }
+    str = end + 1;
+    long w = strtol(str, &end, 10);
+    if (end == str || *end != '\0' || r < 0 || w < 0) {
+        return false;
+    }
+    *readFd = r;
+    *writeFd = w;
+    return true;
+}
+
+JobServer::JobServer()
+    : mReadFd(-1), mWriteFd(-1), mOwnsWriteFd(false), mCancelled(false) {
+    mWakeFds[0] = mWakeFds[1] = -1;
+}
+
+JobServer::~JobServer() {
+    // Return any tokens still held, so make's pool isn't depleted.
+    while (!mTokens.empty()) {
+        release();
+    }
+    if (mReadFd >= 0) {
+        ::close(mReadFd);
+    }
+    if (mOwnsWriteFd) {
+        ::close(mWriteFd);
+    }
+    for (int i = 0; i < 2; i++) {
+        if (mWakeFds[i] >= 0) {
+            ::close(mWakeFds[i]);
+        }
+    }
+}
+
+/* static */ JobServer* JobServer::fromMakeflags(const char* makeflags,
+                                                 ostream& err) {
+    if (makeflags == NULL) {
+        return NULL;
+    }
+    // The last jobserver option given wins.
+    string auth;
+    istringstream words(makeflags);
+    for (string word; words >> word; ) {
+        const char* prefixes[] = { "--jobserver-auth=", "--jobserver-fds=" };
+        for (int i = 0; i < 2; i++) {
+            string prefix = prefixes[i];
+            if (word.compare(0, prefix.size(), prefix) == 0) {
+                auth = word.substr(prefix.size());
+            }
+        }
+    }
+    if (auth.empty()) {
+        return NULL;
+    }
+
+    JobServer* jobServer = new JobServer();
+    int readFd, writeFd;
+    if (auth.compare(0, 5, "fifo:") == 0) {
+        string fifo = auth.substr(5);
+        jobServer->mReadFd = ::open(fifo.c_str(), O_RDONLY|O_NONBLOCK|O_CLOEXEC);
+        jobServer->mWriteFd = ::open(fifo.c_str(), O_WRONLY|O_CLOEXEC);
+        jobServer->mOwnsWriteFd = jobServer->mWriteFd >= 0;
+    } else if (parseFds(auth, &readFd, &writeFd)
+               && ::fcntl(readFd, F_GETFD) != -1
+               && ::fcntl(writeFd, F_GETFD) != -1) {
+        jobServer->mReadFd = reopenNonBlocking(readFd);
+        jobServer->mWriteFd = writeFd;
+    }
+    if (jobServer->mReadFd < 0 || jobServer->mWriteFd < 0
+        || ::pipe(jobServer->mWakeFds) != 0) {
+        if (jobServer->mReadFd >= 0) {
+            ::close(jobServer->mReadFd);
+            jobServer->mReadFd = -1;
+        }
+        err << "WARNING: make jobserver '" << auth << "' is unavailable, " <<
+            "running serially (is the rule prefixed with '+'?)" << endl;
+    }
+    return jobServer;
+}
+
+bool JobServer::acquire() {
+    if (!usable()) {
+        return false;
+    }
+    for (;;) {
+        {
+            MutexLock lock(mMutex);
+            if (mCancelled) {
+                return false;
+            }
+        }
+        char token;
+        ssize_t n = ::read(mReadFd, &token, 1);
+        if (n == 1) {
+            MutexLock lock(mMutex);
+            mTokens.push_back(token);
+            return true;
+        } else if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            return false; // make has gone away.
+        }
+        // Wait for either a token or cancel().
+        struct pollfd fds[2];
+        fds[0].fd = mReadFd;
+        fds[0].events = POLLIN;
+        fds[1].fd = mWakeFds[0];
+        fds[1].events = POLLIN;
+        ::poll(fds, 2, -1);
+    }
+}
+
+void JobServer::release() {
+    char token;
+    {
+        MutexLock lock(mMutex);
+        if (mTokens.empty()) {
+            return;
+        }
+        token = mTokens.back();
+        mTokens.pop_back();
+    }
+    while (::write(mWriteFd, &token, 1) < 0 && errno == EINTR);
+}
+
+void JobServer::cancel() {
+    MutexLock lock(mMutex);
+    if (!mCancelled && mWakeFds[1] >= 0) {
+        // Never drained, so every current and future poll() wakes.
+        while (::write(mWakeFds[1], "x", 1) < 0 && errno == EINTR);
+    }
+    mCancelled = true;
+}
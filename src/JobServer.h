@@ -0,0 +1,63 @@
+#ifndef __JOBSERVER_H__
+#define __JOBSERVER_H__
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Mutex.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// Client for GNU make's jobserver, so that parallel splitting inside
+// 'make -jN' shares make's N job slots rather than adding to them.
+//
+// make advertises the jobserver in MAKEFLAGS as '--jobserver-auth=R,W'
+// (a pipe passed as file descriptors, '--jobserver-fds' in older makes)
+// or '--jobserver-auth=fifo:PATH' (a named pipe).  Each byte in the pipe
+// is a job slot token, taken by reading it and returned by writing the
+// same byte back.  The process itself holds one implicit slot.
+//
+// Tokens are read through a non-blocking file description of our own,
+// so that a worker waiting on a token can be woken by cancel() without
+// affecting make or other clients sharing the pipe.
+//
+class JobServer : public ThreadPool::Slots {
+public:
+    // Returns a client for the jobserver advertised in makeflags (the
+    // value of MAKEFLAGS, may be NULL), or NULL if none is advertised.
+    // If one is advertised but isn't usable (e.g. make didn't pass the
+    // descriptors to this recipe), a warning is written to err and the
+    // returned client never grants a slot, limiting work to the implicit
+    // slot rather than oversubscribing.
+    static JobServer* fromMakeflags(const char* makeflags, ostream& err);
+
+    ~JobServer();
+
+    // Returns true if tokens can be taken from the jobserver.
+    bool usable() const {
+        return mReadFd >= 0;
+    }
+
+    bool acquire();
+    void release();
+    void cancel();
+
+private:
+    int mReadFd;       // our own non-blocking read end, -1 if unusable.
+    int mWriteFd;      // write end for returning tokens.
+    bool mOwnsWriteFd;
+    int mWakeFds[2];   // pipe written by cancel() to wake acquire().
+
+    Mutex mMutex;      // guards mTokens and mCancelled.
+    vector<char> mTokens;  // tokens currently held, to be written back.
+    bool mCancelled;
+
+    JobServer();
+
+    // Non-copyable.
+    JobServer(const JobServer&);
+    JobServer& operator=(const JobServer&);
+};
+
+#endif //__JOBSERVER_H__
@@ -0,0 +1,208 @@
+#include <sstream>
+#include <stdlib.h>   // for strtoull()
+#include <sys/stat.h>
+#include "Journal.h"
+#include "Util.h"
+
+bool Journal::FileState::sameStat(const FileState& other) const {
+    return size == other.size
+        && mtimeSec == other.mtimeSec
+        && mtimeNsec == other.mtimeNsec
+        && inode == other.inode;
+}
+
+bool Journal::FileState::stat(const string& path) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    size = st.st_size;
+    mtimeSec = st.st_mtime;
+#if defined(__APPLE__)
+    mtimeNsec = st.st_mtimespec.tv_nsec;
+#else
+    mtimeNsec = st.st_mtim.tv_nsec;
+#endif
+    inode = st.st_ino;
+    return true;
+}
+
+Journal::Journal(const string& filename)
+    : mFilename(filename), mDirty(false) {
+}
+
+// Parse the next space separated number from *p, advancing past it.
+// Returns false if there is no number at *p.
+static bool parseNumber(const char** p, int base, uint64_t* value) {
+    char* end;
+    *value = strtoull(*p, &end, base);
+    if (end == *p) {
+        return false;
+    }
+    *p = end;
+    return true;
+}
+
+static bool parseState(const char** p, Journal::FileState* state) {
+    uint64_t mtimeSec = 0, mtimeNsec = 0;
+    bool parsed = parseNumber(p, 10, &state->size)
+        && parseNumber(p, 10, &mtimeSec)
+        && parseNumber(p, 10, &mtimeNsec)
+        && parseNumber(p, 10, &state->inode)
+        && parseNumber(p, 16, &state->hash);
+    state->mtimeSec = mtimeSec;
+    state->mtimeNsec = mtimeNsec;
+    return parsed;
+}
+
+static ostream& operator<<(ostream& out, const Journal::FileState& state) {
+    return out << state.size << ' ' << state.mtimeSec << ' ' <<
+        state.mtimeNsec << ' ' << state.inode << ' ' <<
+        hex << state.hash << dec;
+}
+
+bool Journal::load(ostream& err) {
+    string contents;
+    struct stat st;
+    if (!Util::readFromFile(mFilename, &contents)) {
+        if (::stat(mFilename.c_str(), &st) != 0) {
+            return true; // No journal yet.
+        }
+        err << "ERROR: failed to read journal " << mFilename << endl;
+        return false;
+    }
+    // Each line is: settings input h cc <tab> input path
+    // A malformed line is skipped, which only costs a re-split.
+    MutexLock lock(mMutex);
+    for (size_t start = 0, end; start < contents.size(); start = end + 1) {
+        end = contents.find('\n', start);
+        if (end == string::npos) {
+            end = contents.size();
+        }
+        size_t tab = contents.find('\t', start);
+        if (tab == string::npos || tab > end) {
+            continue;
+        }
+        // The fields are terminated by the tab, so parsing stops there.
+        const char* p = contents.c_str() + start;
+        Entry entry;
+        if (parseNumber(&p, 16, &entry.settings)
+            && parseState(&p, &entry.input)
+            && parseState(&p, &entry.h)
+            && parseState(&p, &entry.cc)) {
+            mEntries.insert(mEntries.end(),
+                            make_pair(contents.substr(tab + 1, end - tab - 1), entry));
+        }
+    }
+    return true;
+}
+
+/* static */ bool Journal::unchanged(const string& path,
+                                     const FileState& state,
+                                     string* contents,
+                                     bool* changedStat) {
+    FileState current;
+    if (!current.stat(path)) {
+        return false;
+    }
+    *changedStat = !current.sameStat(state);
+    if (!*changedStat) {
+        return true;
+    }
+    return state.hash != 0
+        && Util::readFromFile(path, contents)
+        && Util::hash(*contents) == state.hash;
+}
+
+bool Journal::upToDate(const string& input,
+                       const FileState& inputState,
+                       uint64_t settings,
+                       const string& hFilename,
+                       const string& ccFilename,
+                       string* contents,
+                       bool* contentsRead) {
+    *contentsRead = false;
+    Entry entry;
+    {
+        MutexLock lock(mMutex);
+        map<string, Entry>::const_iterator it = mEntries.find(input);
+        if (it == mEntries.end()) {
+            return false;
+        }
+        entry = it->second;
+    }
+    if (entry.settings != settings) {
+        return false;
+    }
+
+    // Check the input first, as it is what normally changes.
+    bool inputChanged = !inputState.sameStat(entry.input);
+    if (inputChanged) {
+        *contentsRead = Util::readFromFile(input, contents);
+        if (!*contentsRead || Util::hash(*contents) != entry.input.hash) {
+            return false;
+        }
+    }
+    string outputContents;
+    bool hChanged, ccChanged;
+    if (!unchanged(hFilename, entry.h, &outputContents, &hChanged)
+        || !unchanged(ccFilename, entry.cc, &outputContents, &ccChanged)) {
+        return false;
+    }
+
+    // The contents all match, but refresh any stale stat data so the
+    // next run can decide on stat() alone.
+    if (inputChanged || hChanged || ccChanged) {
+        FileState state = inputState;
+        state.hash = entry.input.hash;
+        entry.input = state;
+        entry.h.stat(hFilename);
+        entry.cc.stat(ccFilename);
+        MutexLock lock(mMutex);
+        mEntries[input] = entry;
+        mDirty = true;
+    }
+    return true;
+}
+
+void Journal::record(const string& input,
+                     const FileState& inputState,
+                     uint64_t settings,
+                     const string& hFilename, uint64_t hHash,
+                     const string& ccFilename, uint64_t ccHash) {
+    if (input.find_first_of("\t\n") != string::npos) {
+        return; // Can't be represented in the journal.
+    }
+    Entry entry;
+    entry.settings = settings;
+    entry.input = inputState;
+    entry.h.hash = hHash;
+    entry.cc.hash = ccHash;
+    if (!entry.h.stat(hFilename) || !entry.cc.stat(ccFilename)) {
+        return; // Outputs weren't written, nothing to record.
+    }
+    MutexLock lock(mMutex);
+    mEntries[input] = entry;
+    mDirty = true;
+}
+
+bool Journal::save(ostream& err) {
+    MutexLock lock(mMutex);
+    if (!mDirty) {
+        return true;
+    }
+    stringstream contents;
+    for (map<string, Entry>::const_iterator it = mEntries.begin();
+         it != mEntries.end(); ++it) {
+        const Entry& entry = it->second;
+        contents << hex << entry.settings << dec << ' ' <<
+            entry.input << ' ' << entry.h << ' ' << entry.cc << '\t' <<
+            it->first << '\n';
+    }
+    if (!Util::writeFileAtomically(mFilename, contents.str())) {
+        err << "ERROR: failed to write journal " << mFilename << endl;
+        return false;
+    }
+    mDirty = false;
+    return true;
+}
@@ -0,0 +1,94 @@
+#ifndef __JOURNAL_H__
+#define __JOURNAL_H__
+
+#include <iostream>
+#include <map>
+#include <stdint.h>
+#include <string>
+#include "Mutex.h"
+
+using namespace std;
+
+// A record of the state of each input and its outputs as of the last
+// time it was split, allowing a no-op build to skip inputs by stat()
+// alone, without reading or tokenizing them.
+//
+// An input is up to date if the settings it was split with are unchanged
+// and both the input and its outputs still have their recorded contents.
+// Contents are checked by stat() data (size, mtime and inode) first, and
+// only files whose stat data changed are read and hashed.
+//
+// The journal is a text file with one input per line, loaded in full
+// at startup and rewritten atomically by save().  Lookups and records
+// may be called concurrently from multiple threads.
+//
+class Journal {
+public:
+    struct FileState {
+        uint64_t size;
+        int64_t mtimeSec;
+        int64_t mtimeNsec;
+        uint64_t inode;
+        uint64_t hash;    // content hash, 0 if unknown.
+
+        FileState() : size(0), mtimeSec(0), mtimeNsec(0), inode(0), hash(0) {}
+
+        // Returns true if the stat data of the two states match.
+        bool sameStat(const FileState& other) const;
+
+        // Populate the stat data for path, leaving hash untouched.
+        // Returns false if path can't be stat'd.
+        bool stat(const string& path);
+    };
+
+    explicit Journal(const string& filename);
+
+    // Load the journal.  A missing journal is treated as empty.
+    // Returns false, after reporting to err, if it exists but can't be read.
+    bool load(ostream& err);
+
+    // Returns true if input was last split with the given settings and
+    // neither it nor its outputs have changed since.  inputState must hold
+    // the stat data of the input, taken before reading it.  If the input
+    // had to be read to decide, its contents are returned in contents,
+    // with contentsRead set, so the caller need not read it again.
+    bool upToDate(const string& input,
+                  const FileState& inputState,
+                  uint64_t settings,
+                  const string& hFilename,
+                  const string& ccFilename,
+                  string* contents,
+                  bool* contentsRead);
+
+    // Record that input (with inputState, including its hash) was split
+    // with the given settings to outputs with the given content hashes
+    // (0 if unknown).  The outputs are stat'd to capture their state.
+    void record(const string& input,
+                const FileState& inputState,
+                uint64_t settings,
+                const string& hFilename, uint64_t hHash,
+                const string& ccFilename, uint64_t ccHash);
+
+    // Write the journal, including all new records, if anything changed.
+    // Returns false, after reporting to err, on failure.
+    bool save(ostream& err);
+
+private:
+    struct Entry {
+        uint64_t settings;
+        FileState input;
+        FileState h;
+        FileState cc;
+    };
+
+    const string mFilename;
+    Mutex mMutex;   // guards mEntries and mDirty.
+    map<string, Entry> mEntries;
+    bool mDirty;
+
+    // Returns true if path still has the contents recorded in state.
+    static bool unchanged(const string& path, const FileState& state,
+                          string* contents, bool* changedStat);
+};
+
+#endif //__JOURNAL_H__
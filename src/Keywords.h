@@ -3,22 +3,22 @@
 
 #include "StringView.h"
 
-static struct {
+namespace Keywords {
     // Returns true if the following function must remain
     // entirely in the header.
-    bool isHeaderOnly(const StringView& keyword) {
+    inline bool isHeaderOnly(const StringView& keyword) {
         return keyword == "inline"
             || keyword == "__force_inline";
     }
 
     // Returns true if the keyword cannot exist in the
     // definition of a function/object.
-    bool isStrippedFromDefinition(const StringView& keyword) {
+    inline bool isStrippedFromDefinition(const StringView& keyword) {
         return keyword == "virtual"
             || keyword == "explicit"
             || keyword == "static"
             || keyword == "override";
     }
-} Keywords;
+}
 
 #endif //__KEYWORDS_H__
@@ -0,0 +1,20 @@
+#include <assert.h>
+#include "ByteSet.h"
+#include "LineIndex.h"
+
+static const ByteSet kNewline("\n");
+
+LineIndex::LineIndex(const StringView& code, size_t firstLine)
+    : mCode(code), mFirstLine(firstLine), mPos(0), mLine(firstLine) {
+}
+
+size_t LineIndex::line(size_t pos) const {
+    assert(pos <= mCode.size());
+    if (pos < mPos) {
+        mPos = 0;
+        mLine = mFirstLine;
+    }
+    mLine += kNewline.count(mCode.data(), pos, mPos);
+    mPos = pos;
+    return mLine;
+}
@@ -0,0 +1,33 @@
+#ifndef __LINEINDEX_H__
+#define __LINEINDEX_H__
+
+#include "StringView.h"
+
+// The line numbers of positions in some code, counted from its newlines.
+//
+// Tokens carry only their position, since few ever need a line number:
+// those starting and ending a split declaration, for its #line
+// directives, and any an error is reported at.  Those are asked about
+// in order, nearly always, so the newlines are counted on from the
+// last position asked about, by a vectorized scan (see ByteSet), and
+// each byte is looked at once however long the declarations, e.g. a
+// table of a million entries.  Asking about an earlier position counts
+// again from the start.
+//
+class LineIndex {
+public:
+    // Index code, whose first line is firstLine.
+    LineIndex(const StringView& code, size_t firstLine);
+
+    // Returns the line code[pos] is on, where pos may also be the end.
+    size_t line(size_t pos) const;
+
+private:
+    const StringView mCode;
+    const size_t mFirstLine;
+    // The last position asked about, and its line.
+    mutable size_t mPos;
+    mutable size_t mLine;
+};
+
+#endif //__LINEINDEX_H__
@@ -0,0 +1,63 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "MappedFile.h"
+#include "Util.h"
+
+MappedFile::MappedFile()
+    : mData(NULL), mSize(0) {
+}
+
+MappedFile::~MappedFile() {
+    release();
+}
+
+void MappedFile::release() {
+    if (mData != NULL) {
+        ::munmap(const_cast<char*>(mData), mSize);
+        mData = NULL;
+        mSize = 0;
+    }
+    mBuffer.clear();
+}
+
+bool MappedFile::open(const string& filename) {
+    release();
+    int fd;
+    do {
+        fd = ::open(filename.c_str(), O_RDONLY|O_CLOEXEC);
+    } while (fd < 0 && errno == EINTR);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    bool ok = (::fstat(fd, &st) == 0);
+    if (ok && !(S_ISREG(st.st_mode) && worthMapping(st.st_size) && map(fd, st.st_size))) {
+        // Small, special or unmappable; a directory fails the read.
+        if (S_ISREG(st.st_mode)) {
+            mBuffer.reserve(st.st_size);
+        }
+        ok = Util::readFromDescriptor(fd, &mBuffer);
+    }
+    ::close(fd);
+    return ok;
+}
+
+bool MappedFile::map(int fd, size_t size) {
+    release();
+    if (size == 0) {
+        return true;    // Nothing to map; contents() is empty.
+    }
+    // Private and read only: the splitter never writes to its input.
+    // Like any mapping, it faults if the file is truncated while mapped.
+    void* data = ::mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    ::madvise(data, size, MADV_SEQUENTIAL);
+    mData = static_cast<const char*>(data);
+    mSize = size;
+    return true;
+}
@@ -0,0 +1,67 @@
+#ifndef __MAPPEDFILE_H__
+#define __MAPPEDFILE_H__
+
+#include <string>
+#include "StringView.h"
+
+using namespace std;
+
+// The read-only contents of an input file, mapped into memory rather
+// than copied where that's cheaper.
+//
+// Regular files of at least kMapThreshold bytes are mmap'd, with the
+// kernel told they'll be read sequentially, so splitting works straight
+// from the page cache.  Smaller files are read() into a buffer, since
+// mapping and faulting in a few pages costs more than copying them, as
+// are empty and special files (pipes, devices, /proc), which can't be
+// mapped by size.
+//
+class MappedFile {
+public:
+    static const size_t kMapThreshold = 64 * 1024;
+
+    MappedFile();
+    ~MappedFile();
+
+    // Map or read filename, releasing anything previously held.
+    // Returns true on success, false if there was a read failure.
+    bool open(const string& filename);
+
+    // Map size bytes of the regular file open as fd, e.g. once sized by
+    // a batch.  The caller keeps ownership of fd, which may be closed as
+    // soon as this returns.  Returns false if fd can't be mapped.
+    bool map(int fd, size_t size);
+
+    // Returns true if a regular file of size bytes is worth mapping.
+    static bool worthMapping(size_t size) {
+        return size >= kMapThreshold;
+    }
+
+    // A buffer for contents read by other means, e.g. from a pipe,
+    // which contents() returns while nothing is mapped.
+    string* buffer() {
+        return &mBuffer;
+    }
+
+    StringView contents() const {
+        return (mData != NULL) ? StringView(mData, mSize) : StringView(mBuffer);
+    }
+
+    bool mapped() const {
+        return mData != NULL;
+    }
+
+    // Unmap or clear the contents.
+    void release();
+
+private:
+    const char* mData;  // the mapping, if mapped.
+    size_t mSize;
+    string mBuffer;
+
+    // Non-copyable.
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+};
+
+#endif //__MAPPEDFILE_H__
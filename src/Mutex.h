@@ -0,0 +1,56 @@
+#ifndef __MUTEX_H__
+#define __MUTEX_H__
+
+#include <assert.h>
+#include <pthread.h>
+
+// Minimal wrapper around a pthread mutex.
+//
+class Mutex {
+    pthread_mutex_t mMutex;
+
+    // Non-copyable.
+    Mutex(const Mutex&);
+    Mutex& operator=(const Mutex&);
+
+public:
+    Mutex() {
+        int rc = pthread_mutex_init(&mMutex, NULL);
+        assert(rc == 0);
+        (void)rc;
+    }
+
+    ~Mutex() {
+        pthread_mutex_destroy(&mMutex);
+    }
+
+    void lock() {
+        pthread_mutex_lock(&mMutex);
+    }
+
+    void unlock() {
+        pthread_mutex_unlock(&mMutex);
+    }
+};
+
+// Holds the given mutex locked for the lifetime of the lock.
+//
+class MutexLock {
+    Mutex& mMutex;
+
+    // Non-copyable.
+    MutexLock(const MutexLock&);
+    MutexLock& operator=(const MutexLock&);
+
+public:
+    explicit MutexLock(Mutex& mutex)
+        : mMutex(mutex) {
+        mMutex.lock();
+    }
+
+    ~MutexLock() {
+        mMutex.unlock();
+    }
+};
+
+#endif //__MUTEX_H__
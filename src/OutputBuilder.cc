@@ -0,0 +1,74 @@
+#include <algorithm> // for min(), max()
+#include <string.h> // for memcpy()
+#include "OutputBuilder.h"
+
+OutputBuilder& OutputBuilder::operator<<(const StringView& view) {
+    if (view.size() == 0) {
+        return *this;
+    }
+    // Consecutive tokens are adjacent in the input, so extend the last
+    // fragment where possible.
+    if (!mFragments.empty() && mFragments.back().data != NULL
+        && mFragments.back().data + mFragments.back().size == view.data()) {
+        mFragments.back().size += view.size();
+    } else {
+        Fragment fragment = { view.data(), 0, view.size() };
+        mFragments.push_back(fragment);
+    }
+    mSize += view.size();
+    return *this;
+}
+
+OutputBuilder& OutputBuilder::operator<<(const string& str) {
+    appendOwned(str.data(), str.size());
+    return *this;
+}
+
+OutputBuilder& OutputBuilder::operator<<(size_t value) {
+    char digits[20];
+    int i = sizeof(digits);
+    do {
+        digits[--i] = '0' + value % 10;
+        value /= 10;
+    } while (value != 0);
+    appendOwned(digits + i, sizeof(digits) - i);
+    return *this;
+}
+
+void OutputBuilder::appendOwned(const char* data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    if (!mFragments.empty() && mFragments.back().data == NULL
+        && mFragments.back().offset + mFragments.back().size == mOwned.size()) {
+        mFragments.back().size += size;
+    } else {
+        Fragment fragment = { NULL, mOwned.size(), size };
+        mFragments.push_back(fragment);
+    }
+    mOwned.append(data, size);
+    mSize += size;
+    mCopied += size;
+}
+
+void OutputBuilder::appendTo(string* out, size_t start, size_t end) {
+    size_t at = out->size();
+    out->resize(at + end - start);
+    char* dest = &(*out)[0] + at;
+    size_t fragmentStart = 0;
+    for (size_t i = 0; i < mFragments.size() && fragmentStart < end; i++) {
+        const Fragment& fragment = mFragments[i];
+        size_t fragmentEnd = fragmentStart + fragment.size;
+        if (start < fragmentEnd) {
+            size_t from = max(start, fragmentStart) - fragmentStart;
+            size_t to = min(end, fragmentEnd) - fragmentStart;
+            const char* data = (fragment.data != NULL)
+                ? fragment.data
+                : mOwned.data() + fragment.offset;
+            memcpy(dest, data + from, to - from);
+            dest += to - from;
+        }
+        fragmentStart = fragmentEnd;
+    }
+    mCopied += end - start;
+}
@@ -0,0 +1,68 @@
+#ifndef __OUTPUTBUILDER_H__
+#define __OUTPUTBUILDER_H__
+
+#include <string>
+#include <vector>
+#include "StringView.h"
+
+using namespace std;
+
+// Accumulates an output as a list of fragments to gather, rather than
+// copying each one into a stream as it's written.
+//
+// Nearly all of an output is slices of the input, which are recorded
+// by reference, with runs of adjacent slices merged into one fragment.
+// Only the little generated text (scope prefixes, #line directives) is
+// copied in as it's written.  Appending the result to a string sizes it
+// once, so each byte of the input is copied just once on its way out.
+//
+class OutputBuilder {
+    // A run of bytes, at data if referenced, or at offset in mOwned.
+    struct Fragment {
+        const char* data;
+        size_t offset;
+        size_t size;
+    };
+    vector<Fragment> mFragments;
+    string mOwned;
+    size_t mSize;
+    size_t mCopied;
+
+public:
+    OutputBuilder() : mSize(0), mCopied(0) {}
+
+    // Reference view, which must outlive the builder, e.g. a slice of the
+    // input or a string literal.
+    OutputBuilder& operator<<(const StringView& view);
+    OutputBuilder& operator<<(const char* literal) {
+        return *this << StringView(literal);
+    }
+
+    // Copy str, e.g. text generated on the fly.
+    OutputBuilder& operator<<(const string& str);
+
+    // Write value in decimal.
+    OutputBuilder& operator<<(size_t value);
+
+    // The number of bytes written so far.
+    size_t size() const {
+        return mSize;
+    }
+
+    // The number of bytes copied so far, into the builder or out of it,
+    // e.g. to check each output byte is copied only once.
+    size_t copied() const {
+        return mCopied;
+    }
+
+    // Append bytes [start, end) of the output to out.
+    void appendTo(string* out, size_t start, size_t end);
+    void appendTo(string* out) {
+        appendTo(out, 0, mSize);
+    }
+
+private:
+    void appendOwned(const char* data, size_t size);
+};
+
+#endif //__OUTPUTBUILDER_H__
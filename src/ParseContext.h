@@ -2,10 +2,10 @@
 #define __PARSECONTEXT_H__
 
 #include <assert.h>
-#include <iostream>
-#include <sstream>
 #include <string>
 #include <vector>
+#include "LineIndex.h"
+#include "OutputBuilder.h"
 
 // Holds various pieces of context about the parse.
 //
@@ -15,55 +15,74 @@
 // #line directives if needed.
 //
 class ParseContext {
+public:
     struct ScopeEntry {
         string name;
         bool templated;
+
+        bool operator==(const ScopeEntry& other) const {
+            return name == other.name && templated == other.templated;
+        }
     };
+
+private:
     vector<ScopeEntry> scope;
+    // The scope in connected form, and how many of its entries are
+    // templated, kept up to date as scopes are pushed and popped.
+    string scopePrefix;
+    size_t templatedScopes;
 
     const string cchFile;
     const bool emitLineNumbers;
 
-    ostream* ccfile;
-    ostream* hfile;
+    OutputBuilder* ccfile;
+    OutputBuilder* hfile;
+
+    // The line numbers of token positions in the code parsed.
+    const LineIndex& lines;
+
+    // Where to record the output offsets of #line numbers, if non-NULL.
+    vector<size_t>* ccLineOffsets;
+    vector<size_t>* hLineOffsets;
 
 public:
 
     ParseContext(const string& cchFilename,
-            ostream* ccOutputStream,
-            ostream* hOutputStream,
+            OutputBuilder* ccOutput,
+            OutputBuilder* hOutput,
+            const LineIndex& codeLines,
             bool _emitLineNumbers)
-        : cchFile(cchFilename),
+        : templatedScopes(0),
+          cchFile(cchFilename),
           emitLineNumbers(_emitLineNumbers),
-          ccfile(ccOutputStream),
-          hfile(hOutputStream) {
-
-        cc() << "#include \"" << filename(cchFile) << ".h\"" << endl;
-        h() << "#pragma once" << endl << endl;
+          ccfile(ccOutput),
+          hfile(hOutput),
+          lines(codeLines),
+          ccLineOffsets(NULL),
+          hLineOffsets(NULL) {
+
+        cc() << "#include \"" << filename(cchFile) << ".h\"\n";
+        h() << "#pragma once\n\n";
     }
 
     ~ParseContext() {
-        h() << endl;
-        cc() << endl;
+        h() << "\n";
+        cc() << "\n";
     }
 
-    ostream& cc() {
+    OutputBuilder& cc() {
         return *ccfile;
     }
 
-    ostream& h() {
+    OutputBuilder& h() {
         return *hfile;
     }
 
     // Get the current scope in connected form, with trailing '::'.
     // e.g. if inside class B inside namespace A, return "A::B::"
     //   or if at default scope, return ""
-    string getScope() const {
-        string ret;
-        for (int i = 0; i < scope.size(); i++) {
-            ret += scope[i].name + "::";
-        }
-        return ret;
+    const string& getScope() const {
+        return scopePrefix;
     }
 
     void pushScope(const string& className, bool templated) {
@@ -71,37 +90,64 @@ public:
         entry.name = className;
         entry.templated = templated;
         scope.push_back(entry);
+        scopePrefix += className;
+        scopePrefix += "::";
+        templatedScopes += templated ? 1 : 0;
     }
 
     void popScope() {
         assert(!scope.empty());
+        scopePrefix.resize(scopePrefix.size() - scope.back().name.size() - 2);
+        templatedScopes -= scope.back().templated ? 1 : 0;
         scope.pop_back();
     }
 
+    // The scopes open, outermost first.
+    const vector<ScopeEntry>& scopes() const {
+        return scope;
+    }
+
+    // How many scopes are open.
+    size_t depth() const {
+        return scope.size();
+    }
+
     // Returns true if anything in the scope stack
     // is marked as being templated - all inner classes/scopes
     // are treated as implicitly templated since we don't do
     // actual symbol type processing to see if the template
     // variables are used.
     bool templated() const {
-        for (int i = 0; i < scope.size(); i++) {
-            if (scope[i].templated) {
-                return true;
-            }
-        }
-        return false;
+        return templatedScopes != 0;
+    }
+
+    // Record the offset into each output of the line number of every
+    // #line directive emitted from here on, so that the directives can
+    // later be renumbered if lines are added or removed above them.
+    void recordLineOffsets(vector<size_t>* ccOffsets,
+                           vector<size_t>* hOffsets) {
+        ccLineOffsets = ccOffsets;
+        hLineOffsets = hOffsets;
+    }
+
+    // Returns the line the given position in the code is on.
+    size_t line(size_t pos) const {
+        return lines.line(pos);
     }
 
     // If emitting #line directives is requested, then
-    // emit a #line directive for the given line number
-    // to both the .cc and the .h buffers.
-    void emitLineDirective(int lineno) {
+    // emit a #line directive for the line of the given
+    // position to both the .cc and the .h buffers.
+    void emitLineDirective(size_t pos) {
         if (emitLineNumbers) {
-            stringstream directive;
-            directive << "\n#line " << lineno <<
-                " \"" << cchFile << "\"\n";
-            cc() << directive.str();
-            h() << directive.str();
+            static const char prefix[] = "\n#line ";
+            size_t lineno = line(pos);
+            if (ccLineOffsets != NULL) {
+                ccLineOffsets->push_back(cc().size() + sizeof(prefix) - 1);
+                hLineOffsets->push_back(h().size() + sizeof(prefix) - 1);
+            }
+            cc() << prefix << lineno << " \"" << cchFile << "\"\n";
+            h() << prefix << lineno << " \"" << cchFile << "\"\n";
         }
     }
 
@@ -1,6 +1,7 @@
 #ifndef __PARSER_H__
 #define __PARSER_H__
 
+#include <sstream>
 #include "Interfaces.h"
 #include "TokenStack.h"
 #include "Keywords.h"
@@ -9,12 +10,17 @@
 
 // Simple parser wrapper that transforms certain keywords
 // into their corresponding token types and passes
-// along to the wrapped inner parser.
+// along to the wrapped inner parser, of type Next.
 //
-class WrapperParser : public Parser {
-    Parser& mWrapped;
+// Like BaseParser, it's a stage of the pipeline the tokenizer emits to
+// directly, rather than a Parser (see ParserAdapter), so that tokens
+// pass from stage to stage without virtual calls.
+//
+template <class Next>
+class WrapperParser {
+    Next& mWrapped;
 public:
-    WrapperParser(Parser& wrapped)
+    WrapperParser(Next& wrapped)
         : mWrapped(wrapped) {}
 
     void acceptToken(const Token& token) {
@@ -43,32 +49,85 @@ public:
             mWrapped.acceptToken(tok);
         }
     }
+
+    bool opensScope() const {
+        return mWrapped.opensScope();
+    }
+};
+
+// Notified of each boundary between top level declarations, i.e.
+// each time the parser has reduced every token given to it so far,
+// outside of any class or namespace body.
+//
+class BoundaryListener {
+public:
+    virtual ~BoundaryListener() {}
+
+    // end is the position just past the last token reduced.
+    virtual void boundary(size_t end) = 0;
 };
 
 // This parser evaluates the token stack each time a token is added,
 // allowing for the stack to be reduced as soon as a pattern is matched.
 //
-class BaseParser : public Parser {
+class BaseParser {
     // The stack of unreduced tokens.
     TokenStack mTokens;
-    // The tokenizer used to recurse into class bodies.
-    Tokenizer* mTokenizer;
     // The parse context and output accumulator.
     ParseContext* mCtx;
+    // Notified of top level boundaries, if non-NULL.
+    BoundaryListener* mListener;
+    // How many class/namespace bodies are open.
+    int mDepth;
+    // Why the tokens couldn't be parsed, empty if they could.
+    string mError;
+    bool mFinished;
 
 public:
     BaseParser(ParseContext* ctx,
-               Tokenizer* tokenizer)
-        : mTokenizer(tokenizer), mCtx(ctx) {}
+               BoundaryListener* listener = NULL)
+        : mCtx(ctx), mListener(listener), mDepth(ctx->depth()), mFinished(false) {}
 
     ~BaseParser() {
-        evalTokenStack();
-        finalize();
+        finish();
+    }
+
+    // Reduce what's left of the token stack, flushing any trailing
+    // comments and whitespace to the header.  Returns false if tokens
+    // were left unreduced, or any failed to parse, setting error().
+    bool finish() {
+        if (!mFinished) {
+            mFinished = true;
+            evalTokenStack();
+            finalize();
+        }
+        return mError.empty();
+    }
+
+    const string& error() const {
+        return mError;
     }
 
     void acceptToken(const Token& token) {
         mTokens.push_back(token);
         evalTokenStack();
+        if (mListener != NULL && mDepth == 0 && mTokens.empty()) {
+            mListener->boundary(token.end());
+        }
+    }
+
+    bool opensScope() const {
+        return mTokens.containsType(CLASS) || mTokens.containsType(NAMESPACE);
+    }
+
+    // Returns true if every token accepted so far has been reduced.
+    bool reduced() const {
+        return mTokens.empty();
+    }
+
+    // Drop any unreduced tokens, e.g. those left by a cut off input.
+    void discard() {
+        mTokens.clear();
     }
 
 private:
@@ -89,16 +148,16 @@ private:
         if (mTokens.empty()) {
             // Do nothing if there are no tokens.  This conditional guards
             // all future access to mTokens from needing to check empty().
-        } else if (mTokens.back().type == PREPROC) {
+        } else if (mTokens.lastType() == PREPROC) {
             // When a preprocessor directive is encountered, dump it
             // and any leading whitespace/comments out to the header.
-            mTokens.flushToStream(mCtx->h());
-        } else if (mTokens.back().type == COLON) {
+            mTokens.flushTo(mCtx->h());
+        } else if (mTokens.lastType() == COLON) {
             if (isLabel(mTokens)) {
                 // Flush the label out to the header.
-                mTokens.flushToStream(mCtx->h());
+                mTokens.flushTo(mCtx->h());
             }
-        } else if (mTokens.back().type == SEMICOLON) {   // Handle general statements.
+        } else if (mTokens.lastType() == SEMICOLON) {   // Handle general statements.
             // Split if there is an ASSIGN and no USING statement.
             bool splitAssignmentToCCFile = mTokens.containsType(ASSIGN)
                 && !mTokens.containsType(USING);
@@ -107,18 +166,18 @@ private:
                 // a PARENS_GROUP is encountered before the '='.
                 // If so, only split it out if followed by another parens
                 // group - i.e. an assignment of a function pointer.
-                for (int i = 0; i < mTokens.size() && mTokens[i].type != ASSIGN; i++) {
-                    if (mTokens[i].type == PARENS_GROUP) {
+                for (int i = 0; i < mTokens.size() && mTokens.type(i) != ASSIGN; i++) {
+                    if (mTokens.type(i) == PARENS_GROUP) {
                         splitAssignmentToCCFile =
-                            (i + 1 < mTokens.size() && mTokens[i+1].type == PARENS_GROUP);
+                            (i + 1 < mTokens.size() && mTokens.type(i+1) == PARENS_GROUP);
                         break;
                     }
                 }
             } else {
                 // If we aren't already splitting out, check to see
                 // if the static keyword appears in the variable type.
-                for (int i = 0; i < mTokens.size() && mTokens[i].type != ASSIGN; i++) {
-                    if (mTokens[i].value == "static") {
+                for (int i = 0; i < mTokens.size() && mTokens.type(i) != ASSIGN; i++) {
+                    if (mTokens.value(i) == "static") {
                         splitAssignmentToCCFile = true;
                         break;
                     }
@@ -126,150 +185,148 @@ private:
             }
             if (!splitAssignmentToCCFile) {
                 // Dump everything to the header.
-                mTokens.flushToStream(mCtx->h());
+                mTokens.flushTo(mCtx->h());
             } else {
-                mCtx->emitLineDirective(mTokens[0].start.line);
+                mCtx->emitLineDirective(mTokens.start(0));
                 int i = 0;
-                for (; i < mTokens.size() && mTokens[i].type != ASSIGN; i++);
-                for (; i-1 >= 0 && mTokens[i-1].type == WHITESPACE; i--);
+                for (; i < mTokens.size() && mTokens.type(i) != ASSIGN; i++);
+                for (; i-1 >= 0 && mTokens.type(i-1) == WHITESPACE; i--);
                 int splitPoint = i;
-                for (i--; i >= 0 && mTokens[i].type != TOKEN; i--);
+                for (i--; i >= 0 && mTokens.type(i) != TOKEN; i--);
                 int identifier = i;
                 for (i = 0; i < splitPoint; i++) {
-                    mCtx->h() << mTokens[i].value;
+                    mCtx->h() << mTokens.value(i);
                     if (i == identifier) {
                         // Add scope prefix to the variable name.
-                        mCtx->cc() << mCtx->getScope() << mTokens[i].value;
-                    } else if (Keywords.isStrippedFromDefinition(mTokens[i].value)) {
+                        mCtx->cc() << mCtx->getScope() << mTokens.value(i);
+                    } else if (Keywords::isStrippedFromDefinition(mTokens.value(i))) {
                         // If the keyword is stripped from the definition, leave
                         // a commented out version to annotate.
-                        mCtx->cc() << "/* " << mTokens[i].value << " */";
+                        mCtx->cc() << "/* " << mTokens.value(i) << " */";
                     } else {
-                        mCtx->cc() << mTokens[i].value;
+                        mCtx->cc() << mTokens.value(i);
                     }
                 }
                 if (i < mTokens.size()) {
                     mCtx->h() << ";";
                 }
                 for (; i < mTokens.size(); i++) {
-                    mCtx->cc() << mTokens[i].value;
+                    mCtx->cc() << mTokens.value(i);
                 }
-                mCtx->emitLineDirective(mTokens.back().end.line);
+                mCtx->emitLineDirective(mTokens.end(mTokens.size()-1));
                 mTokens.clear();
             }
-        } else if (mTokens.back().type == BRACE_GROUP
-                   && (mTokens.containsType(CLASS) || mTokens.containsType(NAMESPACE))) {
-            // In the case of a NAMESPACE or CLASS, the BRACE_GROUP here
-            // is the body of that namespace or class, so we must recurse
-            // into it.
+        } else if (mTokens.lastType() == OPENBRACE) {
+            // The opening of a NAMESPACE or CLASS body, whose tokens
+            // follow up to the matching CLOSEBRACE.
             bool templated = false;
             string scopeName;
             for (int i = 0; i+1 < mTokens.size(); i++) {
                 // If we encounter the CLASS or NAMESPACE token,
-                if (mTokens[i].type == CLASS || mTokens[i].type == NAMESPACE) {
+                if (mTokens.type(i) == CLASS || mTokens.type(i) == NAMESPACE) {
                     // skip past any whitespace/comments to the next token,
-                    for (i++; i < mTokens.size() && (mTokens[i].type == WHITESPACE || mTokens[i].type == COMMENT); i++);
+                    for (i++; i < mTokens.size() && (mTokens.type(i) == WHITESPACE || mTokens.type(i) == COMMENT); i++);
                     // and capture the token as the scope name.
-                    if (i < mTokens.size() && mTokens[i].type == TOKEN) {
-                        scopeName = mTokens[i].value.toString();
+                    if (i < mTokens.size() && mTokens.type(i) == TOKEN) {
+                        scopeName = mTokens.value(i).toString();
                     }
                     break;
-                } else if (mTokens[i].type == TEMPLATE) {
+                } else if (mTokens.type(i) == TEMPLATE) {
                     // If we encounter a TEMPLATE token on the way, mark
                     // this whole scope as being templated.
                     templated = true;
                 }
             }
             mCtx->pushScope(scopeName, templated);
-            {
-                StringView body = mTokens.back().value;
-                Location start = mTokens.back().start;
-                assert(body[0] == '{');
-                assert(body[body.size()-1] == '}');
-                // Trim off outer braces to prevent infinite brace group capture.
-                body = body.slice(1, body.size()-1);
-                // Remove the brace group from the token stack.
-                mTokens.pop_back();
-                // Flush the opening of the class/namespace out to header.
-                mTokens.flushToStream(mCtx->h());
-                mCtx->h() << "{";
-
-                WrapperParser wrapper(*this);
-                mTokenizer->tokenize(body, &wrapper, start);
-
-                mTokens.flushToStream(mCtx->h());
-                mCtx->h() << "}";
-            }
+            // Flush the opening of the class/namespace out to header.
+            mTokens.pop_back();
+            mTokens.flushTo(mCtx->h());
+            mCtx->h() << "{";
+            mDepth++;
+        } else if (mTokens.lastType() == CLOSEBRACE) {
+            // The end of the body, flushing whatever of it is left.
+            assert(mDepth > 0);
+            mTokens.pop_back();
+            mTokens.flushTo(mCtx->h());
+            mCtx->h() << "}";
+            mDepth--;
             mCtx->popScope();
-        } else if (mTokens.back().type == BRACE_GROUP) {
+        } else if (mTokens.lastType() == BRACE_GROUP) {
             // Handle functions with bodies.
             int i = 0;
             bool keepInHeader = false;
             int identifier = -1;  // index to the TOKEN that is the function name.
-            for (; i < mTokens.size() && (mTokens[i].type == TOKEN ||
-                                          mTokens[i].type == WHITESPACE ||
-                                          mTokens[i].type == COMMENT ||
-                                          mTokens[i].type == TEMPLATE); i++) {
-                if (Keywords.isHeaderOnly(mTokens[i].value)
-                    || mTokens[i].type == TEMPLATE) {
+            for (; i < mTokens.size() && (mTokens.type(i) == TOKEN ||
+                                          mTokens.type(i) == WHITESPACE ||
+                                          mTokens.type(i) == COMMENT ||
+                                          mTokens.type(i) == TEMPLATE); i++) {
+                if (Keywords::isHeaderOnly(mTokens.value(i))
+                    || mTokens.type(i) == TEMPLATE) {
                     keepInHeader = true;
                 }
-                if (mTokens[i].type == TOKEN) {
+                if (mTokens.type(i) == TOKEN) {
                     identifier = i;
                 }
             }
 
-            if (mTokens[i].type != PARENS_GROUP) {
+            if (mTokens.type(i) != PARENS_GROUP) {
                 // If the first token after the identifier is not a
                 // PARENS_GROUP (or whitespace/comments), this isn't a function.
                 return;
             }
             // Jump over PARENS_GROUP, then advance over all
             // normal tokens, comments, and whitespace.
-            for (i++; i < mTokens.size() && (mTokens[i].type == TOKEN ||
-                                             mTokens[i].type == COMMENT ||
-                                             mTokens[i].type == WHITESPACE); i++);
+            for (i++; i < mTokens.size() && (mTokens.type(i) == TOKEN ||
+                                             mTokens.type(i) == COMMENT ||
+                                             mTokens.type(i) == WHITESPACE); i++);
             int initializerList = -1;
-            if (i < mTokens.size() && mTokens[i].type == COLON) {
+            if (i < mTokens.size() && mTokens.type(i) == COLON) {
                 initializerList = i;
                 // Walk over initializer list.
                 for (i++; i < mTokens.size() &&
-                         (mTokens[i].type == TOKEN ||
-                          mTokens[i].type == COMMENT ||
-                          mTokens[i].type == WHITESPACE ||
-                          mTokens[i].type == PARENS_GROUP); i++);
+                         (mTokens.type(i) == TOKEN ||
+                          mTokens.type(i) == COMMENT ||
+                          mTokens.type(i) == WHITESPACE ||
+                          mTokens.type(i) == PARENS_GROUP); i++);
             }
-            assert(i + 1 == mTokens.size());
-            assert(mTokens[i].type == BRACE_GROUP);
+            if (i + 1 != mTokens.size()) {
+                // Something unexpected between the parameters and the
+                // body, e.g. an attribute, that can't be split around.
+                fail(mTokens.start(i), "unexpected " + mTokens.value(i).toString() +
+                     " before function body");
+                mTokens.clear();
+                return;
+            }
+            assert(mTokens.type(i) == BRACE_GROUP);
             // We have a function with body!
             if (mCtx->templated() || keepInHeader) {
-                mTokens.flushToStream(mCtx->h());
+                mTokens.flushTo(mCtx->h());
             } else {
-                mCtx->emitLineDirective(mTokens[0].start.line);
+                mCtx->emitLineDirective(mTokens.start(0));
                 // The boundary for what to emit to the header either ends
                 // at the initializer list, if present, or at the BRACE_GROUP.
                 int headerStop = (initializerList != -1)
                     ? initializerList
                     : mTokens.size() - 1;
                 // Walk backwards from the header cutoff over any whitespace.
-                for (; headerStop - 1 >= 0 && mTokens[headerStop-1].type == WHITESPACE; headerStop--);
+                for (; headerStop - 1 >= 0 && mTokens.type(headerStop-1) == WHITESPACE; headerStop--);
                 for (i = 0; i < headerStop; i++) {
-                    mCtx->h() << mTokens[i].value;
+                    mCtx->h() << mTokens.value(i);
                     if (i == identifier) {
-                        mCtx->cc() << mCtx->getScope() << mTokens[i].value;
-                    } else if (Keywords.isStrippedFromDefinition(mTokens[i].value)) {
+                        mCtx->cc() << mCtx->getScope() << mTokens.value(i);
+                    } else if (Keywords::isStrippedFromDefinition(mTokens.value(i))) {
                         // If the keyword is stripped from the definition, leave
                         // a commented out version to annotate.
-                        mCtx->cc() << "/* " << mTokens[i].value << " */";
+                        mCtx->cc() << "/* " << mTokens.value(i) << " */";
                     } else {
-                        mCtx->cc() << mTokens[i].value;
+                        mCtx->cc() << mTokens.value(i);
                     }
                 }
                 mCtx->h() << ";";
                 for (; i < mTokens.size(); i++) {
-                    mCtx->cc() << mTokens[i].value;
+                    mCtx->cc() << mTokens.value(i);
                 }
-                mCtx->emitLineDirective(mTokens.back().end.line);
+                mCtx->emitLineDirective(mTokens.end(mTokens.size()-1));
                 mTokens.clear();
             }
         }
@@ -278,27 +335,36 @@ private:
     static bool isLabel(const TokenStack& tokens) {
         // Should be only comments or whitespace before the 'keyword'':' pair.
         for (int i = 0; i < tokens.size()-2; i++) {
-            if (tokens[i].type != COMMENT && tokens[i].type != WHITESPACE) {
+            if (tokens.type(i) != COMMENT && tokens.type(i) != WHITESPACE) {
                 return false;
             }
         }
         return true;
     }
 
+    // Record the first parse failure, at the given position.
+    void fail(size_t pos, const string& message) {
+        if (mError.empty()) {
+            stringstream error;
+            error << "line " << mCtx->line(pos) << ": " << message;
+            mError = error.str();
+        }
+    }
+
     void finalize() {
         // Make sure any remaining tokens are either comments or whitespace,
         // since they are flushed only to the header.
         for (int i = 0; i < mTokens.size(); i++) {
-            if (mTokens[i].type != COMMENT && mTokens[i].type != WHITESPACE) {
-                cerr << "ERROR: exiting with unconsumed tokens." <<
-                    " Tokens: " << mTokens.toString() << endl <<
-                    "Please open an issue at " << Version::kRepoURL <<
-                    " including source .cch, if possible." << endl;
-                abort();
+            if (mTokens.type(i) != COMMENT && mTokens.type(i) != WHITESPACE) {
+                fail(mTokens.start(i), "unconsumed tokens: " + mTokens.toString() +
+                     "\nPlease open an issue at " + Version::kRepoURL +
+                     " including source .cch, if possible.");
+                mTokens.clear();
+                return;
             }
         }
         // Flush all remaining tokens to the header.
-        mTokens.flushToStream(mCtx->h());
+        mTokens.flushTo(mCtx->h());
     }
 };
 
@@ -0,0 +1,262 @@
+#include <string.h>  // for strchr()
+#include "ByteSet.h"
+#include "Prescan.h"
+
+using namespace Prescan;
+
+// The bytes the tokenizer acts on in each capture it skips through.
+static const ByteSet kNewline("\n"), kStar("*");
+static const ByteSet kDoubleQuoteBytes("\"\\"), kSingleQuoteBytes("'\\");
+static const ByteSet kBraceBytes("'\"/{}"), kParensBytes("'\"/()");
+static const ByteSet kBracketBytes("'\"/[]"), kAngleBytes("'\"/<>");
+
+// A scope body open at some point in the code.
+struct OpenScope {
+    string name;
+    bool isNamespace;
+};
+
+// As the tokenizer's character classes: ASCII only, whatever the locale.
+static bool isIdentifierChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+        || (c >= '0' && c <= '9') || c == '_';
+}
+
+static bool isSpace(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// Returns true if word is the whole of a token, rather than the start
+// of one, when followed by c.
+static bool endsToken(char c) {
+    return isSpace(c) || c == '{' || c == '<' || c == '/';
+}
+
+// The functions below return the index of the last byte of what starts
+// at code[start], or code.size() if it runs on past the end.
+
+// A string or character literal.
+static size_t skipLiteral(const StringView& code, size_t start) {
+    const ByteSet& bytes = (code[start] == '"') ? kDoubleQuoteBytes : kSingleQuoteBytes;
+    for (size_t i = start + 1; i < code.size(); i++) {
+        i = bytes.find(code.data(), code.size(), i);
+        if (i == code.size() || code[i] != '\\') {
+            return i;
+        }
+        i++; // Skip escaped character.
+    }
+    return code.size();
+}
+
+// A '//' or '/*' comment.
+static size_t skipComment(const StringView& code, size_t start) {
+    if (code[start+1] == '/') {
+        return kNewline.find(code.data(), code.size(), start + 2);
+    }
+    for (size_t i = start + 2; i < code.size(); i++) {
+        i = kStar.find(code.data(), code.size(), i);
+        if (i + 1 < code.size() && code[i+1] == '/') {
+            return i + 1;
+        }
+    }
+    return code.size();
+}
+
+// A preprocessor directive, including any lines it's continued onto.
+static size_t skipDirective(const StringView& code, size_t start) {
+    for (size_t i = start + 1; i < code.size(); i++) {
+        i = kNewline.find(code.data(), code.size(), i);
+        if (i == code.size() || code[i-1] != '\\') {
+            return i;
+        }
+    }
+    return code.size();
+}
+
+// A '{}', '()', '[]' or '<>' group, nested only in its own kind.
+static size_t skipGroup(const StringView& code, size_t start) {
+    const char open = code[start];
+    const ByteSet& bytes = (open == '{') ? kBraceBytes
+        : (open == '(') ? kParensBytes
+        : (open == '[') ? kBracketBytes
+        : kAngleBytes;
+    int depth = 1;
+    for (size_t i = start + 1; i < code.size(); i++) {
+        i = bytes.find(code.data(), code.size(), i);
+        if (i == code.size()) {
+            break;
+        }
+        char c = code[i];
+        if (c == '\'' || c == '"') {
+            i = skipLiteral(code, i);
+        } else if (c == '/') {
+            if (i + 1 < code.size() && (code[i+1] == '/' || code[i+1] == '*')) {
+                i = skipComment(code, i);
+            }
+        } else if (c == open) {
+            depth++;
+        } else if (--depth == 0) {
+            return i;
+        }
+    }
+    return code.size();
+}
+
+// An operator's name following the 'operator' keyword, e.g. '<<' or
+// '()', up to the start of its parameters.  Returns the index just past
+// the name.
+static size_t skipOperator(const StringView& code, size_t start) {
+    size_t i = start;
+    for (; i < code.size() && isSpace(code[i]); i++);
+    for (; i < code.size() && strchr("+-*/%^&|!=<>~,", code[i]) != NULL; i++);
+    if (i + 1 < code.size()
+        && ((code[i] == '(' && code[i+1] == ')') || (code[i] == '[' && code[i+1] == ']'))) {
+        i += 2;
+    }
+    return i;
+}
+
+void Prescan::findCuts(const StringView& code, size_t spacing, vector<Cut>* cuts) {
+    vector<OpenScope> scopes;
+    size_t classScopes = 0;
+    size_t next = spacing;
+
+    // What the declaration so far holds.
+    bool sawNamespace = false, sawClass = false;
+    bool sawParens = false, sawAssign = false;
+    bool wantName = false;  // the next token names the namespace.
+    string name;
+    // Whether the next byte starts a token, as a '#' must to start a
+    // directive.
+    bool tokenStart = true;
+
+    for (size_t i = 0; i < code.size(); i++) {
+        const char c = code[i];
+        bool endsDeclaration = false;
+        if (isSpace(c)) {
+            tokenStart = true;
+            continue;
+        }
+        switch (c) {
+        case '"':
+        case '\'':
+            i = skipLiteral(code, i);
+            tokenStart = true;
+            wantName = false;
+            break;
+        case '/':
+            if (i + 1 < code.size() && (code[i+1] == '/' || code[i+1] == '*')) {
+                i = skipComment(code, i);
+                tokenStart = true;
+            } else {
+                tokenStart = wantName = false;
+            }
+            break;
+        case '#':
+            if (tokenStart) {
+                // The parser flushes a directive along with whatever
+                // came before it.
+                i = skipDirective(code, i);
+                endsDeclaration = true;
+            } else {
+                tokenStart = wantName = false;
+            }
+            break;
+        case '<':
+            if (i + 1 < code.size() && code[i+1] == '<') {
+                i++; // A left-shift operator, not a group.
+                tokenStart = wantName = false;
+                break;
+            }
+            // Fall through.
+        case '(':
+        case '[':
+            sawParens |= (c == '(');
+            i = skipGroup(code, i);
+            tokenStart = true;
+            wantName = false;
+            break;
+        case '{':
+            if (sawNamespace || sawClass) {
+                OpenScope scope;
+                scope.name = name;
+                scope.isNamespace = !sawClass;
+                scopes.push_back(scope);
+                classScopes += sawClass ? 1 : 0;
+                sawNamespace = sawClass = sawParens = sawAssign = wantName = false;
+                name.clear();
+            } else {
+                i = skipGroup(code, i);
+                // A function's body ends it, an initializer doesn't.
+                endsDeclaration = sawParens && !sawAssign;
+            }
+            tokenStart = true;
+            break;
+        case '}':
+            if (!scopes.empty()) {
+                classScopes -= scopes.back().isNamespace ? 0 : 1;
+                scopes.pop_back();
+                endsDeclaration = true;
+            }
+            tokenStart = true;
+            break;
+        case ';':
+            endsDeclaration = true;
+            tokenStart = true;
+            break;
+        case '=':
+            sawAssign = true;
+            tokenStart = true;
+            wantName = false;
+            break;
+        case ':':
+            if (i + 1 < code.size() && code[i+1] == ':') {
+                i++;
+                tokenStart = false;
+            } else {
+                tokenStart = true;
+            }
+            wantName = false;
+            break;
+        default:
+            if (!isIdentifierChar(c)) {
+                tokenStart = wantName = false;
+                break;
+            }
+            size_t end = i + 1;
+            for (; end < code.size() && isIdentifierChar(code[end]); end++);
+            const StringView word = code.slice(i, end);
+            const bool whole = tokenStart && (end == code.size() || endsToken(code[end]));
+            if (wantName) {
+                // The name runs on over any '::'s, e.g. 'a::b'.
+                for (; end + 1 < code.size() && code[end] == ':' && code[end+1] == ':'; ) {
+                    for (end += 2; end < code.size() && isIdentifierChar(code[end]); end++);
+                }
+                name = code.slice(i, end).toString();
+                wantName = false;
+            } else if (whole && word == "namespace") {
+                sawNamespace = wantName = true;
+            } else if (whole && (word == "class" || word == "struct" || word == "union")) {
+                sawClass = true;
+            } else if (tokenStart && word == "operator") {
+                end = skipOperator(code, end);
+            }
+            i = end - 1;
+            tokenStart = false;
+            break;
+        }
+        if (endsDeclaration) {
+            sawNamespace = sawClass = sawParens = sawAssign = wantName = false;
+            name.clear();
+            if (classScopes == 0 && i + 1 >= next && i + 1 < code.size()) {
+                Cut cut;
+                cut.pos = i + 1;
+                for (size_t s = 0; s < scopes.size(); s++) {
+                    cut.namespaces.push_back(scopes[s].name);
+                }
+                cuts->push_back(cut);
+                next = cut.pos + spacing;
+            }
+        }
+    }
+}
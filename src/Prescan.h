@@ -0,0 +1,34 @@
+#ifndef __PRESCAN_H__
+#define __PRESCAN_H__
+
+#include <string>
+#include <vector>
+#include "StringView.h"
+
+using namespace std;
+
+// A quick pass over a .cch file for where to cut it, so that the pieces
+// can be split in parallel.
+//
+// It follows comments, literals, directives, groups and scope bodies
+// as the tokenizer does, but parses nothing, so its cuts are guesses:
+// after a ';', a directive, a function body or a scope's closing brace,
+// outside everything but namespace bodies, along with the namespaces
+// open.  A guess that's wrong (e.g. a ';' that doesn't end a
+// declaration) shows when the piece before it is parsed, which doesn't
+// end between declarations in those namespaces.
+//
+namespace Prescan {
+
+    struct Cut {
+        size_t pos;                 // just past the declaration before.
+        vector<string> namespaces;  // the names of those open, outermost
+                                    //   first, as ParseContext has them.
+    };
+
+    // Append cuts in code, in order, the first at least spacing bytes in,
+    // and each at least spacing bytes past the one before.
+    void findCuts(const StringView& code, size_t spacing, vector<Cut>* cuts);
+}
+
+#endif //__PRESCAN_H__
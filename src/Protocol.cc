@@ -0,0 +1,280 @@
+#include <errno.h>
+#include <stdio.h>      // for snprintf()
+#include <stdlib.h>     // for getenv(), strtol()
+#include <string.h>     // for strncpy(), strerror()
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <sstream>
+#include "Protocol.h"
+
+const char* const Protocol::kEnvironment[] = { "MAKEFLAGS", "CCH_CACHE_DIR", "TMPDIR" };
+const size_t Protocol::kEnvironmentSize = sizeof(kEnvironment) / sizeof(kEnvironment[0]);
+
+// Guards against garbage lengths from a misbehaving peer.
+static const uint32_t kMaxStringSize = 64 * 1024 * 1024;
+static const uint32_t kMaxStrings = 64 * 1024;
+
+static bool writeAll(int fd, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = ::write(fd, p, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool readAll(int fd, void* data, size_t size) {
+    char* p = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t n = ::read(fd, p, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+// The per-user directory in /tmp holding the default socket when there
+// is no $XDG_RUNTIME_DIR.
+static string privateTmpDir() {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/cch-%u", (unsigned)::getuid());
+    return path;
+}
+
+string Protocol::defaultSocketPath() {
+    const char* env = ::getenv("CCH_SOCKET");
+    if (env != NULL && *env != '\0') {
+        return env;
+    }
+    const char* runtimeDir = ::getenv("XDG_RUNTIME_DIR");
+    if (runtimeDir != NULL && *runtimeDir != '\0') {
+        return string(runtimeDir) + "/cch.sock";
+    }
+    return privateTmpDir() + "/cch.sock";
+}
+
+bool Protocol::checkSocketDir(const string& socketPath, string* error) {
+    size_t slash = socketPath.rfind('/');
+    string dir = (slash == string::npos) ? "."
+        : (slash == 0) ? "/"
+        : socketPath.substr(0, slash);
+    if (dir == privateTmpDir() && ::mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST) {
+        *error = "failed to create " + dir + ": " + strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (::lstat(dir.c_str(), &st) != 0) {
+        *error = "failed to stat " + dir + ": " + strerror(errno);
+        return false;
+    }
+    if (!S_ISDIR(st.st_mode) || st.st_uid != ::getuid() || (st.st_mode & (S_IWGRP | S_IWOTH)) != 0) {
+        *error = dir + " is not a directory private to this user";
+        return false;
+    }
+    return true;
+}
+
+bool Protocol::peerIsSelf(int fd) {
+#ifdef SO_PEERCRED
+    struct ucred cred;
+    socklen_t size = sizeof(cred);
+    if (::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &size) != 0) {
+        return false;
+    }
+    return cred.uid == ::getuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    if (::getpeereid(fd, &uid, &gid) != 0) {
+        return false;
+    }
+    return uid == ::getuid();
+#endif
+}
+
+int Protocol::connectTo(const string& socketPath) {
+    struct sockaddr_un addr;
+    if (socketPath.size() >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+    if (::connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || !peerIsSelf(fd)) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool Protocol::sendString(int fd, const string& str) {
+    uint32_t size = str.size();
+    return writeAll(fd, &size, sizeof(size))
+        && writeAll(fd, str.data(), str.size());
+}
+
+bool Protocol::recvString(int fd, string* str) {
+    uint32_t size;
+    if (!readAll(fd, &size, sizeof(size)) || size > kMaxStringSize) {
+        return false;
+    }
+    str->resize(size);
+    return size == 0 || readAll(fd, &(*str)[0], size);
+}
+
+bool Protocol::sendInt(int fd, int32_t value) {
+    return writeAll(fd, &value, sizeof(value));
+}
+
+bool Protocol::recvInt(int fd, int32_t* value) {
+    return readAll(fd, value, sizeof(*value));
+}
+
+bool Protocol::sendStrings(int fd, const vector<string>& strs) {
+    if (!sendInt(fd, strs.size())) {
+        return false;
+    }
+    for (size_t i = 0; i < strs.size(); i++) {
+        if (!sendString(fd, strs[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Protocol::sendFds(int fd, const vector<int>& fds) {
+    if (fds.size() > kMaxFds) {
+        return false;
+    }
+    unsigned char count = fds.size();
+    struct iovec iov;
+    iov.iov_base = &count;
+    iov.iov_len = 1;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    union {
+        struct cmsghdr header;
+        char buffer[CMSG_SPACE(sizeof(int) * kMaxFds)];
+    } control;
+    if (!fds.empty()) {
+        memset(&control, 0, sizeof(control));
+        msg.msg_control = control.buffer;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+        memcpy(CMSG_DATA(cmsg), &fds[0], sizeof(int) * fds.size());
+    }
+    ssize_t n;
+    do {
+        n = ::sendmsg(fd, &msg, 0);
+    } while (n < 0 && errno == EINTR);
+    return n == 1;
+}
+
+bool Protocol::recvFds(int fd, vector<int>* fds) {
+    unsigned char count;
+    struct iovec iov;
+    iov.iov_base = &count;
+    iov.iov_len = 1;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    union {
+        struct cmsghdr header;
+        char buffer[CMSG_SPACE(sizeof(int) * kMaxFds)];
+    } control;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+    ssize_t n;
+    do {
+        n = ::recvmsg(fd, &msg, 0);
+    } while (n < 0 && errno == EINTR);
+    fds->clear();
+    for (struct cmsghdr* cmsg = (n == 1) ? CMSG_FIRSTHDR(&msg) : NULL; cmsg != NULL;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            size_t received = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (size_t i = 0; i < received; i++) {
+                int receivedFd;
+                memcpy(&receivedFd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+                fds->push_back(receivedFd);
+            }
+        }
+    }
+    if (n != 1 || (msg.msg_flags & MSG_CTRUNC) != 0 || fds->size() != count) {
+        for (size_t i = 0; i < fds->size(); i++) {
+            ::close((*fds)[i]);
+        }
+        fds->clear();
+        return false;
+    }
+    return true;
+}
+
+bool Protocol::jobServerFds(const char* makeflags, int* readFd, int* writeFd) {
+    if (makeflags == NULL) {
+        return false;
+    }
+    // The last jobserver option given wins.
+    string auth;
+    istringstream words(makeflags);
+    for (string word; words >> word; ) {
+        const char* prefixes[] = { "--jobserver-auth=", "--jobserver-fds=" };
+        for (int i = 0; i < 2; i++) {
+            string prefix = prefixes[i];
+            if (word.compare(0, prefix.size(), prefix) == 0) {
+                auth = word.substr(prefix.size());
+            }
+        }
+    }
+    const char* str = auth.c_str();
+    char* end;
+    long r = strtol(str, &end, 10);
+    if (end == str || *end != ',') {
+        return false;
+    }
+    str = end + 1;
+    long w = strtol(str, &end, 10);
+    if (end == str || *end != '\0' || r < 0 || w < 0) {
+        return false;
+    }
+    *readFd = r;
+    *writeFd = w;
+    return true;
+}
+
+bool Protocol::recvStrings(int fd, vector<string>* strs) {
+    int32_t count;
+    if (!recvInt(fd, &count) || count < 0 || (uint32_t)count > kMaxStrings) {
+        return false;
+    }
+    strs->resize(count);
+    for (int32_t i = 0; i < count; i++) {
+        if (!recvString(fd, &(*strs)[i])) {
+            return false;
+        }
+    }
+    return true;
+}
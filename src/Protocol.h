@@ -0,0 +1,76 @@
+#ifndef __PROTOCOL_H__
+#define __PROTOCOL_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Wire format shared by the cch server and cch-client, spoken over
+// a local Unix domain socket.  All integers are in native byte order
+// as both ends are always on the same host.
+//
+//   request:  u32 count, then count strings:
+//             the client's working directory followed by its arguments.
+//             u32 count, then count 'NAME=value' strings: the client's
+//             values of the environment variables cch reads.
+//             u8 count, carrying that many descriptors as SCM_RIGHTS:
+//             the client's make jobserver pipe, if it was passed one.
+//   response: string stdout, string stderr, i32 exit code.
+//
+// where each string is a u32 length followed by that many bytes.
+//
+namespace Protocol {
+
+    // The environment variables cch reads, which a served request takes
+    // from the client rather than from the server.
+    extern const char* const kEnvironment[];
+    extern const size_t kEnvironmentSize;
+
+    // The most descriptors sent with a request.
+    static const size_t kMaxFds = 2;
+
+    // Returns the socket path to use when none is specified: $CCH_SOCKET
+    // if set, otherwise cch.sock in $XDG_RUNTIME_DIR or, failing that,
+    // in a per-user directory in /tmp.
+    string defaultSocketPath();
+
+    // Checks the directory holding socketPath is one only this user can
+    // create sockets in: a real directory (not a symlink) owned by this
+    // user and not writable by anyone else.  The per-user directory in
+    // /tmp is created if missing.  Returns false with error set otherwise.
+    bool checkSocketDir(const string& socketPath, string* error);
+
+    // Returns true if the peer connected on fd runs as this user.
+    bool peerIsSelf(int fd);
+
+    // Connect to the server listening on socketPath, refusing a server
+    // run by another user.  Returns the connected fd, or -1 on failure.
+    int connectTo(const string& socketPath);
+
+    // Send/receive a length-prefixed string.
+    // Return false if the connection failed.
+    bool sendString(int fd, const string& str);
+    bool recvString(int fd, string* str);
+
+    // Send/receive a 32-bit integer.
+    bool sendInt(int fd, int32_t value);
+    bool recvInt(int fd, int32_t* value);
+
+    // Send/receive a list of strings, as a count followed by each string.
+    bool sendStrings(int fd, const vector<string>& strs);
+    bool recvStrings(int fd, vector<string>* strs);
+
+    // Send/receive up to kMaxFds descriptors.  Those received are new
+    // descriptors in the receiving process for the same open files.
+    bool sendFds(int fd, const vector<int>& fds);
+    bool recvFds(int fd, vector<int>* fds);
+
+    // Returns true if makeflags (the value of MAKEFLAGS, may be NULL)
+    // advertises a jobserver as a pipe passed as descriptors, setting
+    // readFd and writeFd to them.  See JobServer.
+    bool jobServerFds(const char* makeflags, int* readFd, int* writeFd);
+}
+
+#endif //__PROTOCOL_H__
@@ -0,0 +1,209 @@
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>     // for setenv(), unsetenv()
+#include <string.h>     // for strerror()
+#include <sys/socket.h>
+#include <sys/stat.h>   // for umask()
+#include <sys/time.h>   // for struct timeval
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <sstream>
+#include <vector>
+#include "Driver.h"
+#include "Protocol.h"
+#include "Server.h"
+
+// How long a connection may stall while sending its request or
+// receiving the response before it is dropped.
+static const int kTimeoutSeconds = 30;
+
+static volatile sig_atomic_t sStopRequested = 0;
+static bool sServing = false;
+
+static void requestStop(int) {
+    sStopRequested = 1;
+}
+
+// Installed for SIGCHLD so that a finished request interrupts accept()
+// and is reaped promptly.
+static void childExited(int) {
+}
+
+// Replace the forwarded environment variables with the client's values.
+// A jobserver passed to the client as descriptors is rewritten to name
+// the copies received here, or disabled (with a warning from JobServer)
+// if they did not arrive, rather than naming unrelated server descriptors.
+static void applyEnvironment(const vector<string>& env, const vector<int>& fds) {
+    for (size_t i = 0; i < Protocol::kEnvironmentSize; i++) {
+        ::unsetenv(Protocol::kEnvironment[i]);
+    }
+    for (size_t i = 0; i < env.size(); i++) {
+        size_t equals = env[i].find('=');
+        if (equals == string::npos) {
+            continue;
+        }
+        string name = env[i].substr(0, equals);
+        for (size_t j = 0; j < Protocol::kEnvironmentSize; j++) {
+            if (name == Protocol::kEnvironment[j]) {
+                ::setenv(name.c_str(), env[i].c_str() + equals + 1, 1);
+            }
+        }
+    }
+    int readFd, writeFd;
+    if (Protocol::jobServerFds(::getenv("MAKEFLAGS"), &readFd, &writeFd)) {
+        stringstream makeflags;
+        makeflags << ::getenv("MAKEFLAGS") << " --jobserver-auth=";
+        if (fds.size() == 2) {
+            makeflags << fds[0] << "," << fds[1];
+        } else {
+            makeflags << "-1,-1";
+        }
+        ::setenv("MAKEFLAGS", makeflags.str().c_str(), 1);
+    }
+}
+
+// Handle a single client connection: read the request, run it from the
+// client's working directory in the client's environment and send back
+// its output and exit code.
+static void handleRequest(int fd) {
+    vector<string> request, env;
+    vector<int> fds;
+    if (!Protocol::recvStrings(fd, &request) || request.empty()
+        || !Protocol::recvStrings(fd, &env) || !Protocol::recvFds(fd, &fds)) {
+        return;
+    }
+    applyEnvironment(env, fds);
+    stringstream out, err;
+    int status;
+    if (::chdir(request[0].c_str()) != 0) {
+        err << "ERROR: server failed to enter directory " << request[0] <<
+            ": " << strerror(errno) << endl;
+        status = 2;
+    } else {
+        // Build an argv for the driver, with request[0] standing in
+        // for the program name.
+        vector<char*> argv;
+        static char program[] = "cch";
+        argv.push_back(program);
+        for (size_t i = 1; i < request.size(); i++) {
+            argv.push_back(&request[i][0]);
+        }
+        argv.push_back(NULL);
+        status = Driver::run(argv.size() - 1, &argv[0], out, err);
+    }
+    if (Protocol::sendString(fd, out.str())) {
+        if (Protocol::sendString(fd, err.str())) {
+            Protocol::sendInt(fd, status);
+        }
+    }
+}
+
+bool Server::serving() {
+    return sServing;
+}
+
+int Server::serve(const string& socketPath, ostream& err) {
+    struct sockaddr_un addr;
+    if (socketPath.size() >= sizeof(addr.sun_path)) {
+        err << "ERROR: socket path too long: " << socketPath << endl;
+        return 1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+    string dirError;
+    if (!Protocol::checkSocketDir(socketPath, &dirError)) {
+        err << "ERROR: refusing to serve on " << socketPath << ": " << dirError << endl;
+        return 1;
+    }
+
+    // Refuse to take over the socket of a live server, but
+    // clean up one left behind by a server that died.
+    int existing = Protocol::connectTo(socketPath);
+    if (existing >= 0) {
+        ::close(existing);
+        err << "ERROR: a server is already listening on " << socketPath << endl;
+        return 1;
+    }
+    ::unlink(socketPath.c_str());
+
+    int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        err << "ERROR: failed to create socket: " << strerror(errno) << endl;
+        return 1;
+    }
+    // Only the owning user may connect.
+    mode_t oldMask = ::umask(0077);
+    int rc = ::bind(listener, (struct sockaddr*)&addr, sizeof(addr));
+    ::umask(oldMask);
+    if (rc != 0 || ::listen(listener, SOMAXCONN) != 0) {
+        err << "ERROR: failed to listen on " << socketPath << ": " <<
+            strerror(errno) << endl;
+        ::close(listener);
+        return 1;
+    }
+
+    // Install the stop handlers without SA_RESTART, so that a signal
+    // interrupts accept() and lets the loop below exit cleanly.
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = requestStop;
+    sigemptyset(&action.sa_mask);
+    ::sigaction(SIGINT, &action, NULL);
+    ::sigaction(SIGTERM, &action, NULL);
+    action.sa_handler = childExited;
+    ::sigaction(SIGCHLD, &action, NULL);
+    // A client going away mid-response must not take the server down.
+    ::signal(SIGPIPE, SIG_IGN);
+
+    err << "[CCH] serving on " << socketPath << endl;
+    sServing = true;
+    while (!sStopRequested) {
+        while (::waitpid(-1, NULL, WNOHANG) > 0) {
+        }
+        int fd = ::accept(listener, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            err << "ERROR: accept failed: " << strerror(errno) << endl;
+            break;
+        }
+        if (!Protocol::peerIsSelf(fd)) {
+            ::close(fd);
+            continue;
+        }
+        struct timeval timeout;
+        timeout.tv_sec = kTimeoutSeconds;
+        timeout.tv_usec = 0;
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        // Each request runs in its own child, so that its working
+        // directory and environment are its own and a slow or stalled
+        // client does not hold up the others.
+        pid_t pid = ::fork();
+        if (pid == 0) {
+            ::close(listener);
+            ::signal(SIGINT, SIG_DFL);
+            ::signal(SIGTERM, SIG_DFL);
+            ::signal(SIGCHLD, SIG_DFL);
+            handleRequest(fd);
+            ::_exit(0);
+        }
+        if (pid < 0) {
+            err << "ERROR: fork failed: " << strerror(errno) << endl;
+        }
+        ::close(fd);
+    }
+    sServing = false;
+
+    ::close(listener);
+    ::unlink(socketPath.c_str());
+    // Let requests in flight finish.
+    while (::waitpid(-1, NULL, 0) > 0 || errno == EINTR) {
+    }
+    return sStopRequested ? 0 : 1;
+}
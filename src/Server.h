@@ -0,0 +1,27 @@
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// A resident cch process that accepts split requests from cch-client
+// over a local Unix domain socket, avoiding process startup per file.
+//
+// Requests carry the client's working directory, command line and the
+// environment variables cch reads, and each is run in a child process
+// through Driver::run(), so a served request behaves exactly like invoking
+// cch with the same arguments from that directory.
+//
+namespace Server {
+
+    // Listen on socketPath and serve requests until SIGINT/SIGTERM.
+    // Errors are written to err.  Returns the process exit code.
+    int serve(const string& socketPath, ostream& err);
+
+    // Returns true if called from within a served request.
+    bool serving();
+}
+
+#endif //__SERVER_H__
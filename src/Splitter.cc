@@ -0,0 +1,830 @@
+#include <algorithm>  // for count(), max()
+#include <ctype.h>    // for isdigit()
+#include "Parser.h"
+#include "Prescan.h"
+#include "Splitter.h"
+#include "ThreadPool.h"
+#include "Tokenizer.h"
+#include "Util.h"
+#include "Version.h"
+
+using namespace Splitter;
+
+// The outputs of splitting part of an input, and their map.  The
+// outputs reference the input, which must outlive them.
+struct Piece {
+    OutputBuilder h;
+    OutputBuilder cc;
+    size_t hStart, hEnd;    // the range of each output that is the
+    size_t ccStart, ccEnd;  //   piece, less any prologue or epilogue.
+    Map map;    // offsets are from hStart and ccStart.
+    vector<ParseContext::ScopeEntry> scopes;  // those open at the end.
+
+    Piece() : hStart(0), hEnd(0), ccStart(0), ccEnd(0) {}
+
+    void appendH(string* out) {
+        h.appendTo(out, hStart, hEnd);
+    }
+
+    void appendCC(string* out) {
+        cc.appendTo(out, ccStart, ccEnd);
+    }
+};
+
+// Starts a new segment at the input's start and at each top level
+// boundary the parser reaches.
+//
+class SegmentRecorder : public BoundaryListener {
+    const size_t mInputStart;
+    const LineIndex& mLines;
+    const OutputBuilder& mH;
+    const OutputBuilder& mCC;
+    const size_t mHSkip;        // output bytes before the piece starts.
+    const size_t mCCSkip;
+    vector<Segment>* mSegments;
+
+public:
+    SegmentRecorder(size_t inputStart, const LineIndex& lines,
+                    const OutputBuilder& h, const OutputBuilder& cc,
+                    size_t hSkip, size_t ccSkip,
+                    vector<Segment>* segments)
+        : mInputStart(inputStart), mLines(lines), mH(h), mCC(cc),
+          mHSkip(hSkip), mCCSkip(ccSkip), mSegments(segments) {
+        add(inputStart, lines.line(0));
+    }
+
+    void boundary(size_t end) {
+        add(mInputStart + end, mLines.line(end));
+    }
+
+private:
+    void add(size_t inputStart, size_t line) {
+        Segment segment;
+        segment.inputStart = inputStart;
+        segment.line = line;
+        segment.hStart = mH.size() - mHSkip;
+        segment.ccStart = mCC.size() - mCCSkip;
+        mSegments->push_back(segment);
+    }
+};
+
+// Returns true if pos falls between the two colons of a '::', which
+// the tokenizer reads as part of a token rather than as a COLON.
+static bool splitsScopeOperator(const StringView& code, size_t pos) {
+    return 0 < pos && pos < code.size() && code[pos-1] == ':' && code[pos] == ':';
+}
+
+// Hand out the offsets of #line numbers in an output (lines, which are
+// skip bytes ahead of the segment offsets) to the segments of map that
+// emitted them.
+static void assignLines(const vector<size_t>& lines, size_t skip,
+                        bool toH, Map* map) {
+    vector<Segment>& segments = map->segments;
+    vector<size_t>& assigned = toH ? map->hLines : map->ccLines;
+    size_t i = 0;
+    for (size_t s = 0; s < segments.size(); s++) {
+        size_t start = toH ? segments[s].hStart : segments[s].ccStart;
+        (toH ? segments[s].hLines : segments[s].ccLines) = assigned.size();
+        for (; i < lines.size()
+                 && (s + 1 == segments.size()
+                     || lines[i] - skip < (toH ? segments[s+1].hStart : segments[s+1].ccStart));
+             i++) {
+            assigned.push_back(lines[i] - skip - start);
+        }
+    }
+}
+
+// Returns false, setting error, if code is too large to split.
+static bool checkSize(const StringView& code, string* error) {
+    if (code.size() > kMaxInputSize) {
+        *error = "input too large to split (over 4GiB)";
+        return false;
+    }
+    return true;
+}
+
+// Split cch[start, end), beginning at a boundary between declarations on
+// the given line, in the bodies of the given namespaces, into piece.
+// Unless whole, the prologue ParseContext writes is left out of the
+// outputs.  If mapped, the piece's segments are recorded, and it must
+// begin at top level.
+//
+// If partial, end must also be a boundary between declarations (at top
+// level, if mapped) for the piece to be split on its own, and the
+// epilogue is left out.  Returns false if it isn't (e.g. the piece ends
+// part way through a declaration), or if the piece is malformed,
+// setting error, in which case piece is incomplete.  Also fails, setting
+// error, if the piece is over kMaxInputSize.
+static bool splitPiece(const string& cchFilename,
+                       const StringView& cch,
+                       size_t start, size_t end, size_t line,
+                       const vector<string>& namespaces,
+                       bool emitLineNumbers,
+                       bool whole, bool mapped, bool partial,
+                       Piece* piece,
+                       string* error) {
+    if (!checkSize(cch.slice(start, end), error)) {
+        return false;
+    }
+    OutputBuilder& h = piece->h;
+    OutputBuilder& cc = piece->cc;
+    vector<size_t> hLines, ccLines;
+    vector<Segment>& segments = piece->map.segments;
+    size_t hSkip = 0, ccSkip = 0;
+    size_t hEnd = 0, ccEnd = 0;
+    const StringView code = cch.slice(start, end);
+    LineIndex lines(code, line);
+    {
+        ParseContext ctx(cchFilename, &cc, &h, lines, emitLineNumbers);
+        for (size_t i = 0; i < namespaces.size(); i++) {
+            ctx.pushScope(namespaces[i], false);
+        }
+        if (!whole) {
+            hSkip = h.size();
+            ccSkip = cc.size();
+        }
+        if (mapped) {
+            ctx.recordLineOffsets(&ccLines, &hLines);
+        }
+        SegmentRecorder recorder(start, lines, h, cc, hSkip, ccSkip, &segments);
+        {
+            BaseTokenizer tokenizer(partial, namespaces.size());
+            BaseParser parser(&ctx, mapped ? &recorder : NULL);
+            WrapperParser<BaseParser> typeChanger(parser);
+            tokenizer.tokenize(code, &typeChanger, line);
+
+            if (partial) {
+                // If mapped, the recorder's last segment starts at the
+                // end boundary.
+                if (tokenizer.endedMidToken() || !parser.reduced()
+                    || !parser.error().empty()
+                    || (mapped && segments.back().inputStart != end)
+                    || splitsScopeOperator(cch, end)) {
+                    parser.discard();
+                    return false;
+                }
+                segments.pop_back();
+            }
+            // A malformed input leaves the parser with tokens it can't
+            // reduce, so the tokenizer's error says more.
+            if (!parser.finish() || tokenizer.failed()) {
+                *error = tokenizer.failed() ? tokenizer.error() : parser.error();
+                return false;
+            }
+        }
+        hEnd = h.size();
+        ccEnd = cc.size();
+        piece->scopes = ctx.scopes();
+    }
+    if (!partial) {
+        hEnd = h.size();
+        ccEnd = cc.size();
+    }
+    piece->hStart = hSkip;
+    piece->hEnd = hEnd;
+    piece->ccStart = ccSkip;
+    piece->ccEnd = ccEnd;
+
+    if (mapped) {
+        assignLines(hLines, hSkip, true, &piece->map);
+        assignLines(ccLines, ccSkip, false, &piece->map);
+        for (size_t i = 0; i < segments.size(); i++) {
+            size_t segmentEnd = (i + 1 < segments.size()) ? segments[i+1].inputStart : end;
+            segments[i].hash = Util::hash(cch.slice(segments[i].inputStart, segmentEnd));
+        }
+    }
+    return true;
+}
+
+// Records the last top level boundary before the end of the code, and
+// the size of each output there.
+//
+class LastBoundary : public BoundaryListener {
+    const size_t mEnd;
+    const OutputBuilder& mH;
+    const OutputBuilder& mCC;
+
+public:
+    size_t end;     // 0 until a boundary is found.
+    size_t hSize;
+    size_t ccSize;
+
+    LastBoundary(size_t codeEnd, const OutputBuilder& h, const OutputBuilder& cc)
+        : mEnd(codeEnd), mH(h), mCC(cc), end(0), hSize(h.size()), ccSize(cc.size()) {}
+
+    void boundary(size_t boundaryEnd) {
+        // A declaration ending right at the end of the code may yet run
+        // on, e.g. a ':' into a '::'.
+        if (boundaryEnd < mEnd) {
+            end = boundaryEnd;
+            hSize = mH.size();
+            ccSize = mCC.size();
+        }
+    }
+};
+
+// Split the run of whole top level declarations at the start of cch,
+// which begins at a top level boundary on the given line and is cut off
+// part way through, into piece.  Unless whole, the prologue is left out.
+// Sets end to where the run ends, 0 if not even one declaration is
+// whole, and endLine to its line.  Returns false, setting error, if the
+// run is malformed.
+static bool splitPrefix(const string& cchFilename,
+                        const StringView& cch,
+                        size_t line,
+                        bool emitLineNumbers,
+                        bool whole,
+                        Piece* piece,
+                        size_t* end,
+                        size_t* endLine,
+                        string* error) {
+    if (!checkSize(cch, error)) {
+        return false;
+    }
+    LineIndex lines(cch, line);
+    ParseContext ctx(cchFilename, &piece->cc, &piece->h, lines, emitLineNumbers);
+    if (!whole) {
+        piece->hStart = piece->h.size();
+        piece->ccStart = piece->cc.size();
+    }
+    LastBoundary last(cch.size(), piece->h, piece->cc);
+    BaseTokenizer tokenizer(true);
+    BaseParser parser(&ctx, &last);
+    WrapperParser<BaseParser> typeChanger(parser);
+    tokenizer.tokenize(cch, &typeChanger, line);
+    // What follows the last boundary is split again with what follows.
+    parser.discard();
+    if (!parser.error().empty()) {
+        *error = parser.error();
+        return false;
+    }
+    *end = last.end;
+    *endLine = lines.line(last.end);
+    piece->hEnd = last.hSize;
+    piece->ccEnd = last.ccSize;
+    return true;
+}
+
+// Returns the index just past the #line offsets of segment i.
+static size_t linesEnd(const Map& map, size_t i, bool inH) {
+    if (i + 1 < map.segments.size()) {
+        return inH ? map.segments[i+1].hLines : map.segments[i+1].ccLines;
+    }
+    return inH ? map.hLines.size() : map.ccLines.size();
+}
+
+// Append value to out in the given base (10 or 16), as a stream would
+// but without the overhead, as maps can hold millions of numbers.
+static void appendNumber(string* out, uint64_t value, int base = 10) {
+    char digits[20];
+    int i = sizeof(digits);
+    // Divide by constants, which compile to multiplications.
+    if (base == 16) {
+        do {
+            digits[--i] = "0123456789abcdef"[value % 16];
+            value /= 16;
+        } while (value != 0);
+    } else {
+        do {
+            digits[--i] = '0' + value % 10;
+            value /= 10;
+        } while (value != 0);
+    }
+    out->append(digits + i, sizeof(digits) - i);
+}
+
+// Append previous[start, end) to output, adding lineDelta to each #line
+// number at lines[first, last), which are offsets from start, and
+// appending their offsets from the start of what was appended to
+// newLines.  Returns false if an offset doesn't point at a line number.
+static bool appendRenumbered(const StringView& previous, size_t start, size_t end,
+                             const vector<size_t>& lines, size_t first, size_t last,
+                             int64_t lineDelta, string* output, vector<size_t>* newLines) {
+    if (first > last || last > lines.size()) {
+        return false;
+    }
+    if (lineDelta == 0) {
+        output->append(previous.data() + start, end - start);
+        newLines->insert(newLines->end(), lines.begin() + first, lines.begin() + last);
+        return true;
+    }
+    size_t outputStart = output->size();
+    size_t copied = start;
+    for (size_t i = first; i < last; i++) {
+        size_t pos = start + lines[i];
+        if (pos < copied || end <= pos) {
+            return false;
+        }
+        uint64_t line = 0;
+        size_t digitsEnd = pos;
+        for (; digitsEnd < end && isdigit(previous[digitsEnd]); digitsEnd++) {
+            line = line * 10 + (previous[digitsEnd] - '0');
+        }
+        if (digitsEnd == pos) {
+            return false;
+        }
+        output->append(previous.data() + copied, pos - copied);
+        newLines->push_back(output->size() - outputStart);
+        appendNumber(output, line + lineDelta);
+        copied = digitsEnd;
+    }
+    output->append(previous.data() + copied, end - copied);
+    return true;
+}
+
+// Returns true if map is in order and fits within h and cc, and they
+// have the contents it was made for.
+static bool describes(const Map& map, const StringView& h, const StringView& cc) {
+    const vector<Segment>& segments = map.segments;
+    if (segments.empty() || segments[0].inputStart != 0
+        || segments[0].hLines != 0 || segments[0].ccLines != 0) {
+        return false;
+    }
+    for (size_t i = 0; i + 1 < segments.size(); i++) {
+        const Segment& next = segments[i+1];
+        if (next.inputStart < segments[i].inputStart
+            || next.line < segments[i].line
+            || next.hStart < segments[i].hStart
+            || next.ccStart < segments[i].ccStart
+            || next.hLines < segments[i].hLines
+            || next.ccLines < segments[i].ccLines) {
+            return false;
+        }
+    }
+    return segments.back().inputStart <= map.inputSize
+        && segments.back().hStart <= h.size()
+        && segments.back().ccStart <= cc.size()
+        && segments.back().hLines <= map.hLines.size()
+        && segments.back().ccLines <= map.ccLines.size()
+        && Util::hash(h) == map.hHash
+        && Util::hash(cc) == map.ccHash;
+}
+
+// Splits the pieces of an input between its cuts, one per job.
+//
+class PieceRunner : public ThreadPool::Runner {
+    const string& mFilename;
+    const StringView& mInput;
+    const bool mEmitLineNumbers;
+    const vector<Prescan::Cut>& mCuts;
+    const vector<size_t>& mLines;   // the line each piece starts on.
+    vector<Piece>& mPieces;
+    vector<char> mSplit;            // whether each piece split on its own.
+
+public:
+    PieceRunner(const string& cchFilename, const StringView& cch, bool emitLineNumbers,
+                const vector<Prescan::Cut>& cuts, const vector<size_t>& lines,
+                vector<Piece>& pieces)
+        : mFilename(cchFilename), mInput(cch), mEmitLineNumbers(emitLineNumbers),
+          mCuts(cuts), mLines(lines), mPieces(pieces), mSplit(pieces.size(), 0) {}
+
+    void runJob(size_t job) {
+        const bool first = (job == 0), last = (job == mCuts.size());
+        string error;
+        mSplit[job] = splitPiece(mFilename, mInput,
+                                 first ? 0 : mCuts[job-1].pos,
+                                 last ? mInput.size() : mCuts[job].pos,
+                                 mLines[job],
+                                 first ? vector<string>() : mCuts[job-1].namespaces,
+                                 mEmitLineNumbers, first, false, !last,
+                                 &mPieces[job], &error);
+    }
+
+    // Returns true if piece i split on its own, ending between
+    // declarations in the namespaces the next piece was started in.
+    bool split(size_t i) const {
+        if (!mSplit[i]) {
+            return false;
+        }
+        if (i == mCuts.size()) {
+            return true;
+        }
+        const vector<ParseContext::ScopeEntry>& scopes = mPieces[i].scopes;
+        const vector<string>& namespaces = mCuts[i].namespaces;
+        if (scopes.size() != namespaces.size()) {
+            return false;
+        }
+        for (size_t s = 0; s < scopes.size(); s++) {
+            if (scopes[s].name != namespaces[s] || scopes[s].templated) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+string Splitter::banner() {
+    string banner = "// Generated by CCH (";
+    banner += Version::kRepoURL;
+    banner += ") ";
+    banner += Version::kBuildVersion;
+    banner += "\n";
+    return banner;
+}
+
+bool Splitter::split(const string& cchFilename,
+                     const StringView& cch,
+                     bool emitLineNumbers,
+                     const string& banner,
+                     string* h,
+                     string* cc,
+                     Map* map,
+                     string* error,
+                     size_t numThreads) {
+    if (map == NULL && numThreads > 1
+        && splitParallel(cchFilename, cch, emitLineNumbers, banner, numThreads,
+                         kPieceSize, h, cc)) {
+        return true;
+    }
+    Piece piece;
+    if (!splitPiece(cchFilename, cch, 0, cch.size(), 1, vector<string>(), emitLineNumbers,
+                    true, map != NULL, false, &piece, error)) {
+        *error = cchFilename + ", " + *error;
+        return false;
+    }
+    h->reserve(banner.size() + piece.hEnd - piece.hStart);
+    *h = banner;
+    piece.appendH(h);
+    cc->reserve(banner.size() + piece.ccEnd - piece.ccStart);
+    *cc = banner;
+    piece.appendCC(cc);
+    if (map != NULL) {
+        map->inputSize = cch.size();
+        map->hHash = Util::hash(*h);
+        map->ccHash = Util::hash(*cc);
+        map->segments.swap(piece.map.segments);
+        map->hLines.swap(piece.map.hLines);
+        map->ccLines.swap(piece.map.ccLines);
+        for (size_t i = 0; i < map->segments.size(); i++) {
+            map->segments[i].hStart += banner.size();
+            map->segments[i].ccStart += banner.size();
+        }
+    }
+    return true;
+}
+
+bool Splitter::splitParallel(const string& cchFilename,
+                             const StringView& cch,
+                             bool emitLineNumbers,
+                             const string& banner,
+                             size_t numThreads,
+                             size_t pieceSize,
+                             string* h,
+                             string* cc) {
+    if (cch.size() < 2 * pieceSize) {
+        return false;
+    }
+    vector<Prescan::Cut> cuts;
+    Prescan::findCuts(cch, max(pieceSize, cch.size() / (4 * numThreads)), &cuts);
+    if (cuts.empty()) {
+        return false;
+    }
+    LineIndex lineIndex(cch, 1);
+    vector<size_t> lines(1, 1);
+    for (size_t i = 0; i < cuts.size(); i++) {
+        lines.push_back(lineIndex.line(cuts[i].pos));
+    }
+
+    vector<Piece> pieces(cuts.size() + 1);
+    PieceRunner runner(cchFilename, cch, emitLineNumbers, cuts, lines, pieces);
+    vector<size_t> jobs(pieces.size());
+    for (size_t i = 0; i < jobs.size(); i++) {
+        jobs[i] = i;
+    }
+    ThreadPool(numThreads).run(jobs, &runner);
+
+    size_t hSize = banner.size(), ccSize = banner.size();
+    for (size_t i = 0; i < pieces.size(); i++) {
+        if (!runner.split(i)) {
+            return false;
+        }
+        hSize += pieces[i].hEnd - pieces[i].hStart;
+        ccSize += pieces[i].ccEnd - pieces[i].ccStart;
+    }
+    h->reserve(hSize);
+    *h = banner;
+    cc->reserve(ccSize);
+    *cc = banner;
+    for (size_t i = 0; i < pieces.size(); i++) {
+        pieces[i].appendH(h);
+        pieces[i].appendCC(cc);
+    }
+    return true;
+}
+
+bool Splitter::resplit(const string& cchFilename,
+                       const StringView& input,
+                       bool emitLineNumbers,
+                       const Map& previous,
+                       const StringView& previousH,
+                       const StringView& previousCC,
+                       string* h,
+                       string* cc,
+                       Map* map,
+                       size_t* retokenized) {
+    if (!describes(previous, previousH, previousCC)) {
+        return false;
+    }
+    const vector<Segment>& segments = previous.segments;
+    const size_t n = segments.size();
+
+    // Keep the leading declarations that are unchanged.  The last
+    // segment is never kept this way, as it runs to the end of input.
+    size_t k = 0;
+    for (; k + 1 < n; k++) {
+        size_t segmentEnd = segments[k+1].inputStart;
+        if (segmentEnd > input.size()
+            || Util::hash(input.slice(segments[k].inputStart, segmentEnd)) != segments[k].hash) {
+            break;
+        }
+    }
+    // A declaration ending in ':' runs on if now followed by another ':'.
+    for (; k > 0 && splitsScopeOperator(input, segments[k].inputStart); k--);
+    const size_t start = segments[k].inputStart;
+
+    // Keep the trailing declarations that are unchanged, moved by
+    // however much the input grew or shrank, without overlapping those
+    // already kept.
+    const int64_t delta = (int64_t)input.size() - (int64_t)previous.inputSize;
+    size_t j = n;
+    for (; j > k; j--) {
+        const Segment& segment = segments[j-1];
+        int64_t segmentStart = (int64_t)segment.inputStart + delta;
+        size_t segmentEnd = (j < n ? segments[j].inputStart : previous.inputSize) + delta;
+        if (segmentStart < (int64_t)start
+            || Util::hash(input.slice(segmentStart, segmentEnd)) != segment.hash) {
+            break;
+        }
+    }
+
+    // Split what's in between on its own, unless it doesn't end on a
+    // declaration boundary, in which case split all the rest.
+    // A malformed input is left for a full split to report.
+    Piece middle;
+    string error;
+    size_t end = (j < n) ? segments[j].inputStart + delta : input.size();
+    if (j < n && !splitPiece(cchFilename, input, start, end, segments[k].line,
+                             vector<string>(), emitLineNumbers, false, true, true, &middle, &error)) {
+        middle = Piece();
+        j = n;
+        end = input.size();
+    }
+    if (j == n && !splitPiece(cchFilename, input, start, end, segments[k].line,
+                              vector<string>(), emitLineNumbers, false, true, false, &middle, &error)) {
+        return false;
+    }
+
+    // Size the outputs for the kept declarations around the middle.
+    h->reserve(previousH.size() + middle.hEnd - middle.hStart);
+    cc->reserve(previousCC.size() + middle.ccEnd - middle.ccStart);
+    h->assign(previousH.data(), segments[k].hStart);
+    cc->assign(previousCC.data(), segments[k].ccStart);
+    map->settings = previous.settings;
+    map->inputSize = input.size();
+    map->segments.reserve(k + middle.map.segments.size() + (n - j));
+    map->segments.assign(segments.begin(), segments.begin() + k);
+    map->hLines.assign(previous.hLines.begin(), previous.hLines.begin() + segments[k].hLines);
+    map->ccLines.assign(previous.ccLines.begin(), previous.ccLines.begin() + segments[k].ccLines);
+    for (size_t i = 0; i < middle.map.segments.size(); i++) {
+        Segment segment = middle.map.segments[i];
+        segment.hStart += h->size();
+        segment.ccStart += cc->size();
+        segment.hLines += map->hLines.size();
+        segment.ccLines += map->ccLines.size();
+        map->segments.push_back(segment);
+    }
+    map->hLines.insert(map->hLines.end(), middle.map.hLines.begin(), middle.map.hLines.end());
+    map->ccLines.insert(map->ccLines.end(), middle.map.ccLines.begin(), middle.map.ccLines.end());
+    middle.appendH(h);
+    middle.appendCC(cc);
+
+    if (j < n) {
+        // Everything after the middle moved by the lines it gained or lost.
+        int64_t lineDelta = (int64_t)(segments[k].line
+                                      + count(input.data() + start, input.data() + end, '\n'))
+            - (int64_t)segments[j].line;
+        for (size_t i = j; i < n; i++) {
+            Segment segment = segments[i];
+            segment.inputStart += delta;
+            segment.line += lineDelta;
+            segment.hStart = h->size();
+            segment.ccStart = cc->size();
+            segment.hLines = map->hLines.size();
+            segment.ccLines = map->ccLines.size();
+            size_t hEnd = (i + 1 < n) ? segments[i+1].hStart : previousH.size();
+            size_t ccEnd = (i + 1 < n) ? segments[i+1].ccStart : previousCC.size();
+            if (!appendRenumbered(previousH, segments[i].hStart, hEnd, previous.hLines,
+                                  segments[i].hLines, linesEnd(previous, i, true),
+                                  lineDelta, h, &map->hLines)
+                || !appendRenumbered(previousCC, segments[i].ccStart, ccEnd, previous.ccLines,
+                                     segments[i].ccLines, linesEnd(previous, i, false),
+                                     lineDelta, cc, &map->ccLines)) {
+                return false;
+            }
+            map->segments.push_back(segment);
+        }
+    }
+    map->hHash = Util::hash(*h);
+    map->ccHash = Util::hash(*cc);
+    *retokenized = end - start;
+    return true;
+}
+
+Stream::Stream(const string& cchFilename,
+               bool emitLineNumbers,
+               const string& banner,
+               Sink* sink,
+               size_t chunkSize)
+    : mFilename(cchFilename), mEmitLineNumbers(emitLineNumbers), mBanner(banner),
+      mSink(sink), mChunkSize(chunkSize), mThreshold(chunkSize), mLine(1),
+      mStarted(false) {
+}
+
+bool Stream::feed(const char* data, size_t size) {
+    if (!mError.empty()) {
+        return false;
+    }
+    mPending.append(data, size);
+    if (mPending.size() >= mThreshold) {
+        splitPending(true);
+    }
+    return mError.empty();
+}
+
+bool Stream::finish() {
+    if (mError.empty()) {
+        splitPending(false);
+    }
+    string().swap(mPending);
+    return mError.empty();
+}
+
+// Split the pending input and write its outputs, up to the last top
+// level boundary in it if partial, otherwise all of it.
+void Stream::splitPending(bool partial) {
+    Piece piece;
+    size_t end = 0, endLine = 0;
+    string error;
+    bool ok = partial
+        ? splitPrefix(mFilename, mPending, mLine, mEmitLineNumbers, !mStarted,
+                      &piece, &end, &endLine, &error)
+        : splitPiece(mFilename, mPending, 0, mPending.size(), mLine, vector<string>(),
+                     mEmitLineNumbers, !mStarted, false, false, &piece, &error);
+    if (!ok) {
+        mError = mFilename + ", " + error;
+        return;
+    }
+    if (partial && end == 0) {
+        // A declaration runs on past what's pending; wait for twice as
+        // much, so that it's re-tokenized only so many times.
+        mThreshold = 2 * mPending.size();
+        return;
+    }
+    mH.clear();
+    mCC.clear();
+    if (!mStarted) {
+        mH = mCC = mBanner;
+    }
+    piece.appendH(&mH);
+    piece.appendCC(&mCC);
+    if (!mSink->write(mH, mCC)) {
+        mError = "failed to write output";
+        return;
+    }
+    mStarted = true;
+    if (partial) {
+        mPending.erase(0, end);
+        mLine = endLine;
+        mThreshold = max(mChunkSize, 2 * mPending.size());
+    }
+}
+
+static void serializeLines(string* out, const vector<size_t>& lines,
+                           size_t begin, size_t end) {
+    *out += ' ';
+    appendNumber(out, end - begin);
+    for (size_t i = begin; i < end; i++) {
+        *out += ' ';
+        appendNumber(out, lines[i]);
+    }
+}
+
+string Map::serialize() const {
+    // A header line, then a line per segment of:
+    //   inputStart line hash hStart #hLines hLines... ccStart #ccLines ccLines...
+    string out = "cchmap ";
+    appendNumber(&out, settings, 16);
+    out += ' ';
+    appendNumber(&out, inputSize);
+    out += ' ';
+    appendNumber(&out, hHash, 16);
+    out += ' ';
+    appendNumber(&out, ccHash, 16);
+    out += ' ';
+    appendNumber(&out, segments.size());
+    out += '\n';
+    for (size_t i = 0; i < segments.size(); i++) {
+        const Segment& segment = segments[i];
+        appendNumber(&out, segment.inputStart);
+        out += ' ';
+        appendNumber(&out, segment.line);
+        out += ' ';
+        appendNumber(&out, segment.hash, 16);
+        out += ' ';
+        appendNumber(&out, segment.hStart);
+        serializeLines(&out, hLines, segment.hLines, linesEnd(*this, i, true));
+        out += ' ';
+        appendNumber(&out, segment.ccStart);
+        serializeLines(&out, ccLines, segment.ccLines, linesEnd(*this, i, false));
+        out += '\n';
+    }
+    return out;
+}
+
+// Parse the next whitespace separated number, in the given base (10 or
+// 16), from *p, advancing past it.  Returns false if there is no number
+// at *p, or it has too many digits to be sure it doesn't overflow.
+static bool parseNumber(const char** p, int base, uint64_t* value) {
+    const char* c = *p;
+    for (; *c == ' ' || *c == '\n'; c++);
+    const char* start = c;
+    *value = 0;
+    for (;; c++) {
+        if ('0' <= *c && *c <= '9') {
+            *value = *value * base + (*c - '0');
+        } else if (base == 16 && 'a' <= *c && *c <= 'f') {
+            *value = *value * base + (*c - 'a' + 10);
+        } else {
+            break;
+        }
+    }
+    if (c == start || c - start > (base == 16 ? 16 : 19)) {
+        return false;
+    }
+    *p = c;
+    return true;
+}
+
+static bool parseSize(const char** p, size_t* value) {
+    uint64_t parsed;
+    if (!parseNumber(p, 10, &parsed)) {
+        return false;
+    }
+    *value = parsed;
+    return true;
+}
+
+// Parse a count and that many offsets, appending them to lines.
+static bool parseLines(const char** p, vector<size_t>* lines) {
+    size_t count;
+    if (!parseSize(p, &count)) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        size_t offset;
+        if (!parseSize(p, &offset)) {
+            return false;
+        }
+        lines->push_back(offset);
+    }
+    return true;
+}
+
+bool Map::parse(const string& serialized) {
+    static const char kMagic[] = "cchmap ";
+    if (serialized.compare(0, sizeof(kMagic) - 1, kMagic) != 0) {
+        return false;
+    }
+    const char* p = serialized.c_str() + sizeof(kMagic) - 1;
+    size_t count;
+    if (!parseNumber(&p, 16, &settings)
+        || !parseSize(&p, &inputSize)
+        || !parseNumber(&p, 16, &hHash)
+        || !parseNumber(&p, 16, &ccHash)
+        || !parseSize(&p, &count)) {
+        return false;
+    }
+    // A segment takes at least 16 bytes, which bounds a corrupt count.
+    segments.clear();
+    segments.reserve(min(count, serialized.size() / 16));
+    hLines.clear();
+    ccLines.clear();
+    for (size_t i = 0; i < count; i++) {
+        Segment segment;
+        segment.hLines = hLines.size();
+        if (!parseSize(&p, &segment.inputStart)
+            || !parseSize(&p, &segment.line)
+            || !parseNumber(&p, 16, &segment.hash)
+            || !parseSize(&p, &segment.hStart)
+            || !parseLines(&p, &hLines)
+            || !parseSize(&p, &segment.ccStart)) {
+            return false;
+        }
+        segment.ccLines = ccLines.size();
+        if (!parseLines(&p, &ccLines)) {
+            return false;
+        }
+        segments.push_back(segment);
+    }
+    return true;
+}
@@ -0,0 +1,182 @@
+#ifndef __SPLITTER_H__
+#define __SPLITTER_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "StringView.h"
+
+using namespace std;
+
+// Splits the contents of a .cch file into its .h and .cc outputs.
+//
+// A split can also produce a map of the input's top level declarations:
+// where each starts in the input and in the outputs, a hash of its input
+// bytes, and where the #line directives emitted for it are.  Given the
+// map and outputs of an earlier split, an edited input can be re-split
+// by re-tokenizing only the declarations that changed, and splicing
+// their outputs between the earlier outputs of the declarations before
+// and after them, renumbering the #line directives of those after.
+// The result is byte for byte that of a full split.
+//
+namespace Splitter {
+
+    // A top level declaration, along with any whitespace and comments
+    // before it.  Offsets into the outputs are from the start of each.
+    struct Segment {
+        size_t inputStart;
+        size_t line;        // the line number at inputStart.
+        uint64_t hash;      // hash of the segment's input bytes.
+        size_t hStart;
+        size_t ccStart;
+        size_t hLines;      // index of the segment's first #line offset
+        size_t ccLines;     //   in Map::hLines, and in Map::ccLines.
+
+        Segment()
+            : inputStart(0), line(1), hash(0), hStart(0), ccStart(0),
+              hLines(0), ccLines(0) {}
+    };
+
+    // The map of a split.  The last segment holds whatever follows the
+    // last declaration, and its outputs run to the end of each output.
+    struct Map {
+        uint64_t settings;      // hash of the settings split with,
+                                //   left for the caller to check.
+        size_t inputSize;
+        uint64_t hHash;         // hashes of the outputs.
+        uint64_t ccHash;
+        vector<Segment> segments;
+        // The offsets of the #line numbers each segment emitted, from
+        // the segment's start in the output, segment by segment.
+        vector<size_t> hLines;
+        vector<size_t> ccLines;
+
+        Map() : settings(0), inputSize(0), hHash(0), ccHash(0) {}
+
+        string serialize() const;
+
+        // Returns false if serialized isn't a well formed map.
+        bool parse(const string& serialized);
+    };
+
+    // The banner naming cch and its version, to start outputs with.
+    string banner();
+
+    // The size of piece splitParallel() cuts an input into, at least.
+    static const size_t kPieceSize = 1024 * 1024;
+
+    // The largest input that can be split, as token offsets are kept in
+    // 32 bits (see TokenStack).  Larger inputs fail with an error.
+    static const uint64_t kMaxInputSize = 0xffffffffu;
+
+    // Split cch, read from cchFilename, into h and cc, each starting with
+    // banner.  If map is non-NULL, it is set to the map of the split.
+    // Otherwise, a large input is split on up to numThreads threads (see
+    // splitParallel()).  Returns false, setting error, if cch is malformed.
+    bool split(const string& cchFilename,
+               const StringView& cch,
+               bool emitLineNumbers,
+               const string& banner,
+               string* h,
+               string* cc,
+               Map* map,
+               string* error,
+               size_t numThreads = 1);
+
+    // Split cch as split() would without a map, but by cutting it between
+    // declarations, at top level or in namespace bodies, into pieces of
+    // at least pieceSize, and splitting those on up to numThreads
+    // threads at once.  The outputs are byte for byte those of split().
+    // Returns false, leaving cch to split(), if it's smaller than two
+    // pieces or can't be cut, e.g. because it's malformed.
+    bool splitParallel(const string& cchFilename,
+                       const StringView& cch,
+                       bool emitLineNumbers,
+                       const string& banner,
+                       size_t numThreads,
+                       size_t pieceSize,
+                       string* h,
+                       string* cc);
+
+    // Re-split cch given the map and outputs of an earlier split of the
+    // same file with the same settings, setting h, cc and map as split()
+    // would, and retokenized to the number of input bytes re-tokenized.
+    // Returns false, leaving a full split to the caller, if the map
+    // doesn't describe the earlier outputs, or cch is malformed.
+    bool resplit(const string& cchFilename,
+                 const StringView& cch,
+                 bool emitLineNumbers,
+                 const Map& previous,
+                 const StringView& previousH,
+                 const StringView& previousCC,
+                 string* h,
+                 string* cc,
+                 Map* map,
+                 size_t* retokenized);
+
+    // Receives the outputs of a streamed split, a part at a time.
+    class Sink {
+    public:
+        virtual ~Sink() {}
+
+        // Append the next part of the .h and of the .cc.  Returns false
+        // if they couldn't be written, which ends the split.
+        virtual bool write(const string& h, const string& cc) = 0;
+    };
+
+    // Splits an input fed to it a chunk at a time, in bounded memory.
+    //
+    // Input is held only until the parser reaches a top level boundary,
+    // at which point the outputs of everything before it are written to
+    // the sink and that input dropped.  Memory is then bounded by the
+    // chunk size plus the largest single top level declaration, so an
+    // input wrapped in a single namespace is still held whole.
+    //
+    // The outputs are byte for byte those of split(), but are written
+    // before the rest of the input is known to be well formed, so the
+    // sink should be able to discard them.
+    class Stream {
+    public:
+        static const size_t kChunkSize = 1024 * 1024;
+
+        Stream(const string& cchFilename,
+               bool emitLineNumbers,
+               const string& banner,
+               Sink* sink,
+               size_t chunkSize = kChunkSize);
+
+        // Split the input following what was fed so far, once at least
+        // a chunk of it is pending.  Returns false if the input is
+        // malformed or the sink failed, setting error().
+        bool feed(const char* data, size_t size);
+
+        // Split the rest of the input.  Returns false as feed() does.
+        bool finish();
+
+        const string& error() const {
+            return mError;
+        }
+
+    private:
+        const string mFilename;
+        const bool mEmitLineNumbers;
+        const string mBanner;
+        Sink* mSink;
+        const size_t mChunkSize;
+        string mPending;    // input not yet split.
+        size_t mThreshold;  // pending size to next try splitting at.
+        size_t mLine;       // the line number mPending starts on.
+        bool mStarted;      // set once the prologue has been written.
+        string mH;          // the parts being written, kept to reuse.
+        string mCC;
+        string mError;
+
+        void splitPending(bool partial);
+
+        // Non-copyable.
+        Stream(const Stream&);
+        Stream& operator=(const Stream&);
+    };
+}
+
+#endif //__SPLITTER_H__
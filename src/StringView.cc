@@ -1,6 +1,6 @@
 #include "StringView.h"
 
-ostream& operator<< (ostream& out, const StringView& s) {
+std::ostream& operator<< (std::ostream& out, const StringView& s) {
     out.write(s.data(), s.size());
     return out;
 }
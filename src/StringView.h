@@ -6,8 +6,6 @@
 #include <string.h>  // for strlen, memcmp, memchr
 #include <string>
 
-using namespace std;
-
 // Provides an immutable view on a span of memory.
 // The standard use case is to access slices
 // of a backing string without any string creation.
@@ -16,16 +14,17 @@ class StringView {
     const char* mData;
     size_t mSize;
 
+public:
+    // View size bytes at data, e.g. of a memory mapping.
     StringView(const char* data, size_t size)
         : mData(data), mSize(size) {
     }
 
-public:
     StringView(const char* str)
         : mData(str), mSize(strlen(str)) {
     }
 
-    StringView(const string& str)
+    StringView(const std::string& str)
         : mData(str.data()), mSize(str.size()) {
     }
 
@@ -77,12 +76,12 @@ public:
         return true;
     }
 
-    string toString() const {
-        return string(mData, mData + mSize);
+    std::string toString() const {
+        return std::string(mData, mData + mSize);
     }
 };
 
 // Allow for writing a StringView directly to an ostream.
-ostream& operator<< (ostream& out, const StringView& s);
+std::ostream& operator<< (std::ostream& out, const StringView& s);
 
 #endif //__STRINGVIEW_H__
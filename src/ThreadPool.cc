@@ -0,0 +1,109 @@
+#include <algorithm> // for min()
+#include <pthread.h>
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(size_t numThreads, Slots* slots)
+    : mNumThreads(numThreads > 0 ? numThreads : 1), mSlots(slots), mRunner(NULL) {
+}
+
+void ThreadPool::run(const vector<size_t>& jobs, Runner* runner) {
+    if (mNumThreads == 1 || jobs.size() <= 1) {
+        for (size_t i = 0; i < jobs.size(); i++) {
+            runner->runJob(jobs[i]);
+        }
+        return;
+    }
+
+    size_t numThreads = min(mNumThreads, jobs.size());
+    mRunner = runner;
+    mQueues.resize(numThreads);
+    for (size_t i = 0; i < numThreads; i++) {
+        mQueues[i] = new Queue();
+    }
+    for (size_t i = 0; i < jobs.size(); i++) {
+        mQueues[i % numThreads]->jobs.push_back(jobs[i]);
+    }
+
+    // The calling thread acts as worker 0.
+    vector<Worker> workers(numThreads);
+    vector<pthread_t> threads(numThreads);
+    for (size_t i = 0; i < numThreads; i++) {
+        workers[i].pool = this;
+        workers[i].id = i;
+    }
+    size_t started = 1;
+    for (; started < numThreads; started++) {
+        if (pthread_create(&threads[started], NULL,
+                           &ThreadPool::threadMain, &workers[started]) != 0) {
+            // Not fatal: the threads that did start steal the queued work.
+            break;
+        }
+    }
+    work(0);
+    // Every job has been taken, so release any workers
+    // still waiting for a slot to run one.
+    if (mSlots != NULL) {
+        mSlots->cancel();
+    }
+    for (size_t i = 1; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (size_t i = 0; i < numThreads; i++) {
+        delete mQueues[i];
+    }
+    mQueues.clear();
+    mRunner = NULL;
+}
+
+bool ThreadPool::nextJob(size_t id, size_t* job) {
+    for (size_t i = 0; i < mQueues.size(); i++) {
+        Queue* queue = mQueues[(id + i) % mQueues.size()];
+        MutexLock lock(queue->mutex);
+        if (!queue->jobs.empty()) {
+            *job = queue->jobs.front();
+            queue->jobs.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::hasJobs() {
+    for (size_t i = 0; i < mQueues.size(); i++) {
+        MutexLock lock(mQueues[i]->mutex);
+        if (!mQueues[i]->jobs.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::work(size_t id) {
+    if (id == 0 || mSlots == NULL) {
+        for (size_t job; nextJob(id, &job); ) {
+            mRunner->runJob(job);
+        }
+        return;
+    }
+    // Take a slot before each job, rather than with a job in hand, so
+    // that a worker waiting on a slot never holds up work that the
+    // calling thread could otherwise do.
+    while (hasJobs() && mSlots->acquire()) {
+        size_t job;
+        bool found = nextJob(id, &job);
+        if (found) {
+            mRunner->runJob(job);
+        }
+        mSlots->release();
+        if (!found) {
+            break;
+        }
+    }
+}
+
+/* static */ void* ThreadPool::threadMain(void* arg) {
+    Worker* worker = static_cast<Worker*>(arg);
+    worker->pool->work(worker->id);
+    return NULL;
+}
@@ -0,0 +1,88 @@
+#ifndef __THREADPOOL_H__
+#define __THREADPOOL_H__
+
+#include <deque>
+#include <stddef.h>
+#include <vector>
+#include "Mutex.h"
+
+using namespace std;
+
+// Runs a fixed set of jobs, identified by index, across a pool of
+// worker threads with work stealing.
+//
+// Jobs are dealt round-robin onto per-worker queues in the order given,
+// so callers that order jobs largest-first get each worker starting on
+// the biggest remaining inputs.  A worker drains its own queue from the
+// front and, once empty, steals from the front of another worker's queue.
+// Stealing from the front (rather than the traditional back) keeps the
+// largest remaining job moving first, so one big input isn't left to
+// run alone at the end of the pool.
+//
+class ThreadPool {
+public:
+    class Runner {
+    public:
+        virtual ~Runner() {}
+
+        // Run the job with the given index.  Called concurrently from
+        // multiple threads, but never twice for the same job.
+        virtual void runJob(size_t job) = 0;
+    };
+
+    // Limits how many workers may run jobs at once, on top of the pool
+    // size, e.g. to share job slots with other processes.  The calling
+    // thread always has an implicit slot, so only the additional
+    // workers acquire one before each job.
+    class Slots {
+    public:
+        virtual ~Slots() {}
+
+        // Block until a slot is available and take it.
+        // Returns false if cancel() was called first.
+        virtual bool acquire() = 0;
+
+        // Return a slot taken by acquire().
+        virtual void release() = 0;
+
+        // Wake all workers blocked in acquire(), making it
+        // return false from now on.
+        virtual void cancel() = 0;
+    };
+
+    // Create a pool of numThreads workers, optionally limited by slots.
+    explicit ThreadPool(size_t numThreads, Slots* slots = NULL);
+
+    // Run all jobs, blocking until every job has completed.
+    // With a single thread, jobs are run in order on the calling thread.
+    void run(const vector<size_t>& jobs, Runner* runner);
+
+private:
+    struct Queue {
+        Mutex mutex;
+        deque<size_t> jobs;
+    };
+
+    struct Worker {
+        ThreadPool* pool;
+        size_t id;
+    };
+
+    const size_t mNumThreads;
+    Slots* mSlots;
+    vector<Queue*> mQueues;
+    Runner* mRunner;
+
+    // Pop the next job for worker id, stealing if its queue is empty.
+    // Returns false once there is no work left anywhere.
+    bool nextJob(size_t id, size_t* job);
+
+    // Returns true if any queue still holds a job.
+    bool hasJobs();
+
+    void work(size_t id);
+
+    static void* threadMain(void* arg);
+};
+
+#endif //__THREADPOOL_H__
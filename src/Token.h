@@ -1,30 +1,33 @@
 #ifndef __TOKEN_H__
 #define __TOKEN_H__
 
+#include <string>
 #include "StringView.h"
 
+using namespace std;
+
 enum TokenEnum {
     INVALIDTOKEN, TOKEN, CLASS, ASSIGN, STRING_LITERAL, COMMENT, PREPROC,
     SEMICOLON, COLON, BRACE_GROUP, PARENS_GROUP, WHITESPACE,
     OPENBRACE, CLOSEBRACE, TEMPLATE, USING, NAMESPACE
 };
 
-struct Location {
-    size_t pos;    // absolute index into string. 0-indexed.
-    size_t line;   // line number in file.        1-indexed.
-    size_t column; // character column in file.   0-indexed.
-    Location() : pos(0), line(1), column(0) {}
-};
+// The number of TokenEnum values, NAMESPACE being the last.
+const int kTokenTypes = NAMESPACE + 1;
 
 struct Token {
     StringView value;
     TokenEnum type;
-    Location start;
-    Location end;
+    size_t start;   // index into the code tokenized.  See LineIndex
+                    // for its line number.
+
+    Token(StringView _value, TokenEnum _type, size_t _start)
+        : value(_value), type(_type), start(_start) {}
 
-    Token(StringView _value, TokenEnum _type,
-          Location _start, Location _end)
-        : value(_value), type(_type), start(_start), end(_end) {}
+    // The index just past the token.
+    size_t end() const {
+        return start + value.size();
+    }
 
     string toString() const;
 
@@ -1,46 +1,132 @@
 #ifndef __TOKENSTACK_H__
 #define __TOKENSTACK_H__
 
+#include <stdint.h>
+#include <string.h>  // for memset()
 #include <vector>
+#include "OutputBuilder.h"
 #include "Token.h"
 
-// Wrapper around a vector of Tokens
-// with a few convenience methods.
+// A stack of Tokens with a few convenience methods.
 //
-class TokenStack : public vector<Token> {
+// The parser scans the stack by type on every token pushed, and the
+// stack may hold hundreds of comments and whitespace in front of a
+// heavily annotated declaration, so each field is kept in an array of
+// its own: a byte per type, and 32 bit offsets and sizes.  Tokens are
+// slices of the same code, so their values are sliced out of it again
+// on demand, and offsets are from the first token on the stack, which
+// limits a declaration to 4GB.  How many of each type are on the stack
+// is counted as they're pushed and popped, so the parser can ask
+// whether it holds a type without scanning it.
+//
+class TokenStack {
+    // Where the code of the first token is, and its start.
+    const char* mCode;
+    size_t mStart;
+
+    vector<unsigned char> mTypes;
+    vector<uint32_t> mOffsets;
+    vector<uint32_t> mSizes;
+    size_t mCounts[kTokenTypes];
+
 public:
+    TokenStack() : mCode(NULL), mStart(0) {
+        memset(mCounts, 0, sizeof(mCounts));
+    }
+
     ~TokenStack() {
         // If the stack is not empty on destruction
         // it means there are lost tokens that
-        // have not been flushed to a stream.
+        // have not been flushed to an output.
         assert(empty());
     }
 
+    // Push a token, which must be from the same code as those on the
+    // stack, and after them.
+    void push_back(const Token& token) {
+        if (empty()) {
+            mCode = token.value.data();
+            mStart = token.start;
+        }
+        size_t offset = token.start - mStart;
+        assert(token.value.data() == mCode + offset);
+        assert(offset + token.value.size() <= (uint32_t)-1);
+        mTypes.push_back((unsigned char)token.type);
+        mCounts[token.type]++;
+        mOffsets.push_back((uint32_t)offset);
+        mSizes.push_back((uint32_t)token.value.size());
+    }
+
+    void pop_back() {
+        assert(!empty());
+        mCounts[mTypes.back()]--;
+        mTypes.pop_back();
+        mOffsets.pop_back();
+        mSizes.pop_back();
+    }
+
+    void clear() {
+        mTypes.clear();
+        mOffsets.clear();
+        mSizes.clear();
+        memset(mCounts, 0, sizeof(mCounts));
+    }
+
+    size_t size() const {
+        return mTypes.size();
+    }
+
+    bool empty() const {
+        return mTypes.empty();
+    }
+
+    TokenEnum type(size_t i) const {
+        return (TokenEnum)mTypes[i];
+    }
+
+    StringView value(size_t i) const {
+        return StringView(mCode + mOffsets[i], mSizes[i]);
+    }
+
+    // The position of token i in the code tokenized.
+    size_t start(size_t i) const {
+        return mStart + mOffsets[i];
+    }
+
+    // The position just past token i.
+    size_t end(size_t i) const {
+        return start(i) + mSizes[i];
+    }
+
+    TokenEnum lastType() const {
+        assert(!empty());
+        return type(size() - 1);
+    }
+
+    Token get(size_t i) const {
+        return Token(value(i), type(i), start(i));
+    }
+
     // Returns true if the specified token type
     // is present in the stack.
     bool containsType(TokenEnum type) const {
-        for (int i = 0; i < size(); i++) {
-            if ((*this)[i].type == type) {
-                return true;
-            }
-        }
-        return false;
+        return mCounts[type] != 0;
     }
 
     // Write all token values to the specified
-    // stream and clear the token stack.
-    void flushToStream(ostream& stream) {
-        for (int i = 0; i < size(); i++) {
-            stream << (*this)[i].value;
+    // output and clear the token stack.
+    void flushTo(OutputBuilder& output) {
+        for (size_t i = 0; i < size(); i++) {
+            output << value(i);
         }
         clear();
     }
 
     string toString() const {
         string ret = "TokenStack [";
-        for (int i = 0; i < size(); i++) {
+        for (size_t i = 0; i < size(); i++) {
             if (i > 0) { ret += " >> "; }
-            ret += (*this)[i].toString();
+            ret += get(i).toString();
         }
         return ret + "]";
     }
@@ -1,82 +1,131 @@
 #ifndef __TOKENIZER_H__
 #define __TOKENIZER_H__
 
+#include <sstream>
+#include <string.h>
 #include <vector>
+#include "ByteSet.h"
 #include "Interfaces.h"
+#include "LineIndex.h"
 #include "StringView.h"
 #include "Token.h"
 
 // This tokenizer iterates over the input text, splitting it into
 // appropriate instances of Token and sending them to the specified emitter.
 //
+// Each byte is scanned once.  Function bodies and initializers are
+// captured whole, but class and namespace bodies are tokenized in place,
+// with the scopes open tracked on the state stack rather than by
+// recursing, however deeply they nest.  Within comments, literals and
+// captured groups, it skips straight to the next byte that could end
+// or nest them (see ByteSet).
+//
+// Tokens are emitted to a parser whose type is a template parameter, so
+// that each stage of the pipeline is called directly and can be inlined.
+// Any Parser can still be emitted to through the Tokenizer interface.
+//
 class BaseTokenizer : public Tokenizer {
-    class TokenTracker;
+    template <class Emitter> class TokenTracker;
+
+    // Whether code may end part way through a token, and whether it has.
+    const bool mPartial;
+    bool mEndedMidToken;
+    // How many scope bodies the code starts in.
+    const size_t mOpenScopes;
+    // Why the code couldn't be tokenized, empty if it could.
+    string mError;
 
 public:
+    // If partial, the code tokenized may be cut off part way through a
+    // token, comment or group (e.g. a slice of a file).  Rather than that
+    // being an error, the remainder is emitted as an INVALIDTOKEN and
+    // endedMidToken() is set.  It may also end in a scope's body, between
+    // its declarations, without that being cut off.
+    //
+    // The code may start in the bodies of openScopes nested scopes, e.g.
+    // the code after a cut between declarations in a namespace, whose
+    // closing braces it is then expected to hold.
+    explicit BaseTokenizer(bool partial = false, size_t openScopes = 0)
+        : mPartial(partial), mEndedMidToken(false), mOpenScopes(openScopes) {}
+
+    // Returns true if partial and any code tokenized so far was cut off.
+    bool endedMidToken() const {
+        return mEndedMidToken;
+    }
+
+    // Returns true if any code tokenized so far was malformed, in which
+    // case error() describes the first problem and tokens may be missing.
+    bool failed() const {
+        return !mError.empty();
+    }
+
+    const string& error() const {
+        return mError;
+    }
+
     void tokenize(const StringView& code,
                   Parser* emitter,
-                  Location start = Location()) {
-        TokenTracker token(code, emitter, start);
+                  size_t firstLine = 1) {
+        tokenize<Parser>(code, emitter, firstLine);
+    }
+
+    // Tokenize code into emitter, which accepts tokens and answers
+    // opensScope() as a Parser would.
+    template <class Emitter>
+    void tokenize(const StringView& code,
+                  Emitter* emitter,
+                  size_t firstLine = 1) {
+        TokenTracker<Emitter> token(code, emitter, firstLine);
         tokenize(code, token);
-        assert(token.getBytesConsumed() == code.size());
+        assert(failed() || token.getBytesConsumed() == code.size());
     }
 
 private:
 
     // Tokenize the input string, accumulating and emitting tokens
     // through the TokenTracker.
-    void tokenize(const StringView& code, TokenTracker& token) {
-
-        static struct {
-            TokenizerState getStateForChar(char c) const {
-                switch (c) {
-                case '{': case '}': return BRACE_CAPTURE;
-                case '(': case ')': return PARENS_CAPTURE;
-                case '[': case ']': return BRACKET_CAPTURE;
-                case '<': case '>': return ANGLE_CAPTURE;
-                default: assert(false && "No state for specified char");
-                    // Keep older versions of g++ happy that fail to deduce
-                    // that assert(false) implies the function doesn't return.
-                    return INVALIDSTATE;
-                }
-            }
-
-            TokenEnum getTokenForChar(char c) const {
-                switch (c) {
-                case '{': case '}': return BRACE_GROUP;
-                case '(': case ')': return PARENS_GROUP;
-                case '[': case ']': return TOKEN;
-                case '<': case '>': return TOKEN;
-                default: assert(false && "No token type for specified char");
-                    // Keep older versions of g++ happy that fail to deduce
-                    // that assert(false) implies the function doesn't return.
-                    return INVALIDTOKEN;
-                }
-            }
-        } CharMap;
+    template <class Emitter>
+    void tokenize(const StringView& code, TokenTracker<Emitter>& token) {
 
         StateStack states;
+        for (size_t i = 0; i < mOpenScopes; i++) {
+            states.pushScope(string::npos);
+        }
+
+        // The only bytes each capture state acts on; the rest are skipped.
+        const ByteSet commentBytes("*"), lineBytes("\n");
+        const ByteSet doubleQuoteBytes("\"\\"), singleQuoteBytes("'\\");
+        const ByteSet braceBytes("'\"/{}"), parensBytes("'\"/()");
+        const ByteSet bracketBytes("'\"/[]"), angleBytes("'\"/<>");
 
         // This is the analog to the lexer in a traditional lex/yacc configuration.
         // This loop consumes the input and pushes tokens onto the token stack.
         for (size_t i = 0; i < code.size(); i++) {
             token.setEnd(i);
-            if (states.currentState() == NORMAL
-                && token.get() == "operator") {
-                // This still feels hackish, but I have
-                // yet to find a more elegant solution.
-                states.pushState(OPERATOR);
-            }
             switch (states.currentState()) {
             case NORMAL:
-                switch (code[i]) {
-                case '\'':
-                case '"':
+                switch (charClass(code[i])) {
+                case LTR:
+                case DIG:
+                    // Take the rest of the identifier or number at once.
+                    if (token.empty()) {
+                        size_t start = i;
+                        for (; i+1 < code.size() && isIdentifierChar(code[i+1]); i++);
+                        if (i+1 < code.size() && code.slice(start, i+1) == "operator") {
+                            // The keyword starts an operator's name.
+                            token.setEnd(i+1);
+                            states.pushState(OPERATOR);
+                        }
+                    } else {
+                        for (; i+1 < code.size() && isIdentifierChar(code[i+1]); i++);
+                    }
+                    break;
+                case QUO:
                     token.flush();
                     states.pushState(LITERAL_CAPTURE);
                     states.setCurrentStateMatchChar(code[i]);
                     break;
-                case '/':
+                case SLA:
                     if (i+1 < code.size()) {
                         if (code[i+1] == '*') {
                             token.flush();
@@ -89,53 +138,66 @@ private:
                         }
                     }
                     break;
-                case '<':
-                    if (code[i] == '<' && i+1 < code.size() && code[i+1] == '<') {
+                case LBR:
+                    token.flush();
+                    if (token.opensScope()) {
+                        token.emitToken("{", OPENBRACE);
+                        states.pushScope(token.start());
+                    } else {
+                        states.pushState(BRACE_CAPTURE);
+                    }
+                    break;
+                case RBR:
+                    // Closes the innermost scope, if any; otherwise it's
+                    // left as part of a token.
+                    if (states.inScope()) {
+                        token.emitToken("}", CLOSEBRACE);
+                        states.popState();
+                    }
+                    break;
+                case LAN:
+                    if (i+1 < code.size() && code[i+1] == '<') {
                         i++; // Skip over left-shift operator '<<' as just a normal token.
                         break;
                     }
-                case '{':
-                case '(':
-                case '[':
+                case LGR:
                     token.flush();
-                    states.pushState(CharMap.getStateForChar(code[i]));
+                    states.pushState(getStateForChar(code[i]));
                     break;
-                case '=':
+                case EQU:
                     token.emitToken("=", ASSIGN);
                     break;
-                case ':':
+                case COL:
                     if (i + 1 < code.size() && code[i+1] == ':') {
                         i++; // Skip '::' pairs.
                     } else {
                         token.emitToken(":", COLON);
                     }
                     break;
-                case ';':
+                case SEM:
                     token.emitToken(";", SEMICOLON);
                     break;
-                case '#':
+                case HSH:
                     // Only switch to preprocessor mode if this '#'
                     // is the first character of the token.
                     if (token.empty()) {
                         states.pushState(PREPROCESSOR);
                     }
                     break;
-                case ' ':
-                case '\n':
-                case '\r':
-                case '\t':
-                case '\v':
-                case '\f':
+                case SPC:
                     token.flush();
                     // Capture the entire span of whitespace.
-                    for (; i+1 < code.size() && isspace(code[i+1]); i++);
+                    for (; i+1 < code.size() && isSpace(code[i+1]); i++);
                     token.setEnd(i+1);
                     token.flush(WHITESPACE);
                     break;
+                case OTH:
+                    break;
                 }
                 break;
             case PREPROCESSOR:
-                if (code[i] == '\n' && code[i-1] != '\\') {
+                i = lineBytes.find(code.data(), code.size(), i);
+                if (i < code.size() && code[i-1] != '\\') {
                     token.setEnd(i+1);
                     if (states.currentStateEmit()) {
                         token.flush(PREPROC);
@@ -144,6 +206,11 @@ private:
                 }
                 break;
             case LITERAL_CAPTURE:
+                i = (states.getCurrentStateMatchChar() == '"' ? doubleQuoteBytes : singleQuoteBytes)
+                    .find(code.data(), code.size(), i);
+                if (i == code.size()) {
+                    break;
+                }
                 if (code[i] == '\\' && i+1 < code.size()) {
                     i++; // Skip escaped character.
                 } else if (code[i] == states.getCurrentStateMatchChar()) {
@@ -155,6 +222,7 @@ private:
                 }
                 break;
             case C_COMMENT:
+                i = commentBytes.find(code.data(), code.size(), i);
                 if (i+1 < code.size() && code[i] == '*' && code[i+1] == '/') {
                     i++; // The terminal '*/' is two characters long,
                     // so skip forward one to capture the full terminal.
@@ -166,7 +234,8 @@ private:
                 }
                 break;
             case CPP_COMMENT:
-                if (code[i] == '\n') {
+                i = lineBytes.find(code.data(), code.size(), i);
+                if (i < code.size()) {
                     token.setEnd(i+1);
                     if (states.currentStateEmit()) {
                         token.flush(COMMENT);
@@ -178,6 +247,13 @@ private:
             case PARENS_CAPTURE:
             case BRACKET_CAPTURE:
             case ANGLE_CAPTURE:
+                i = (states.currentState() == BRACE_CAPTURE ? braceBytes
+                     : states.currentState() == PARENS_CAPTURE ? parensBytes
+                     : states.currentState() == BRACKET_CAPTURE ? bracketBytes
+                     : angleBytes).find(code.data(), code.size(), i);
+                if (i == code.size()) {
+                    break;
+                }
                 switch (code[i]) {
                 case '\'':
                 case '"':
@@ -202,7 +278,7 @@ private:
                 case '(':
                 case '[':
                 case '<':
-                    if (states.currentState() == CharMap.getStateForChar(code[i])) {
+                    if (states.currentState() == getStateForChar(code[i])) {
                         states.currentStateDepth()++;
                     }
                     break;
@@ -210,11 +286,11 @@ private:
                 case ')':
                 case ']':
                 case '>':
-                    if (states.currentState() == CharMap.getStateForChar(code[i])) {
+                    if (states.currentState() == getStateForChar(code[i])) {
                         // If the depth reaches 0, then this character was the balanced
                         // match to the character that opened this state, so emit and pop.
                         if (--states.currentStateDepth() == 0) {
-                            TokenEnum tokenType = CharMap.getTokenForChar(code[i]);
+                            TokenEnum tokenType = getTokenForChar(code[i]);
                             token.setEnd(i+1);
                             if (states.currentStateEmit()) {
                                 token.flush(tokenType);
@@ -225,13 +301,13 @@ private:
                     break;
                 }
                 break;
+            case OPERATOR_GROUP:
+                // The '()' or '[]' operator's group has been captured.
+                token.flush();
+                states.popState();
+                i--; // Unconsume this current unrelated character.
+                break;
             case OPERATOR:
-                if (states.currentStateDepth() == 347) {
-                    token.flush();
-                    states.popState();
-                    i--; // Unconsume this current unrelated character.
-                    break;
-                }
                 switch (code[i]) {
                 case '-': case '+':
                 case '*': case '/':
@@ -263,11 +339,12 @@ private:
                     break;
                 case '(':
                 case '[':
-                    // Mark this state to emit next time we get back to it.
-                    states.currentStateDepth() = 347;
+                    // Emit the name once the group is captured.
+                    states.popState();
+                    states.pushState(OPERATOR_GROUP);
                     // Switch to a group capture, but do not emit.
                     // This accumulates the group into the current token.
-                    states.pushState(CharMap.getStateForChar(code[i]));
+                    states.pushState(getStateForChar(code[i]));
                     states.currentStateEmit() = false;
                     break;
                 case ' ':
@@ -276,10 +353,10 @@ private:
                 case '\t':
                 case '\v':
                 case '\f':
-                    if (token.get() == "operator") {
+                    if (token.size() == kOperatorLength) {
                         // If this is the first character in the operator
                         // capture, accumulate all whitespace.
-                        for (; i < code.size() && isspace(code[i]); i++);
+                        for (; i < code.size() && isSpace(code[i]); i++);
                     } else {
                         token.flush();
                         states.popState();
@@ -291,24 +368,37 @@ private:
                         i += 2;
                         // Handle the user-defined literal case.
                         // Capture any whitespace, if present.
-                        for (; i < code.size() && isspace(code[i]); i++);
+                        for (; i < code.size() && isSpace(code[i]); i++);
                         // Capture any combo of '_' or alphabetic.
-                        for (; i < code.size() && (isalpha(code[i]) || code[i] == '_'); i++);
+                        for (; i < code.size() && charClass(code[i]) == LTR; i++);
                         token.setEnd(i);
                         i--;
                     }
                 default:
-                    if (token.get() != "operator") {
+                    if (token.size() != kOperatorLength) {
                         // As long as there was at least some whitespace
                         // after 'operator' consider the type conversion
                         // operator case.
-                        if (isalpha(code[i]) || code[i] == '_') {
-                            for (; i < code.size() && code[i] != '('; i++);
+                        if (charClass(code[i]) == LTR) {
+                            // Stop short of any brace or ';', should the
+                            // '(' be missing, and of trailing whitespace.
+                            for (; i < code.size() && !strchr("({};", code[i]); i++);
+                            for (; isSpace(code[i-1]); i--);
                             token.setEnd(i);
                             i--;
                         }
                     }
-                    token.flush();
+                    if (isSpace(token.get()[token.size()-1])) {
+                        // Nothing after the whitespace names an operator.
+                        if (mError.empty()) {
+                            stringstream error;
+                            error << "line " << token.line(token.start()) << ": malformed operator";
+                            mError = error.str();
+                        }
+                        token.flush(INVALIDTOKEN);
+                    } else {
+                        token.flush();
+                    }
                     states.popState();
                     break;
                 }
@@ -316,74 +406,89 @@ private:
             case INVALIDSTATE: assert(false && "Should never be in INVALIDSTATE");
             }
         }
-        if (states.currentState() == LITERAL_CAPTURE
-            || states.currentState() == BRACE_CAPTURE
-            || states.currentState() == PARENS_CAPTURE
-            || states.currentState() == BRACKET_CAPTURE
-            || states.currentState() == ANGLE_CAPTURE) {
-            // If we are still in any of the capture modes at the end of
-            // code block, the input is definitely malformed.
-            cout << "Unclosed capture" << endl;
-            // TODO: gracefully exit instead of exit(),
-            //   and print the location of the offending start character.
-            exit(1);
+        token.setEnd(code.size());
+        if (mPartial && (states.currentState() != NORMAL || !token.empty())) {
+            // Emit whatever was cut off, unparseable as it is.
+            mEndedMidToken = true;
+            states.reset();
+            token.flush(INVALIDTOKEN);
+            return;
+        }
+        if (mPartial && !states.atTopLevel()) {
+            // Cut off between declarations in a scope's body.
+            states.reset();
+            return;
+        }
+        // A top level line comment or directive may end with the code,
+        // for want of a final newline.
+        TokenizerState state = states.currentState();
+        bool endsWithCode = (states.size() == 2
+                             && (state == CPP_COMMENT || state == PREPROCESSOR));
+        size_t scopeStart = states.outermostScopeStart();
+        if (scopeStart != string::npos || (!states.atTopLevel() && !endsWithCode)) {
+            // If we are still in any of the capture modes, comments or
+            // scopes at the end of code block, the input is definitely
+            // malformed.
+            if (mError.empty()) {
+                stringstream error;
+                error << "line " << token.line(scopeStart != string::npos ? scopeStart : token.start()) <<
+                    ": unclosed capture";
+                mError = error.str();
+            }
+            states.reset();
+            return;
         }
         // Push the remaining token (if any).
-        token.setEnd(code.size());
-        token.flush();
+        token.flush(state == CPP_COMMENT ? COMMENT : state == PREPROCESSOR ? PREPROC : TOKEN);
+        states.reset();
     }
 
     // Tracks beginning and end of a subsection of the
     // backing string with the ability to flush that
     // subsection out as a Token to the specified emitter.
     //
+    template <class Emitter>
     class TokenTracker {
         const StringView mBackingString;
-        Parser* mEmitter;
+        Emitter* mEmitter;
+        const size_t mFirstLine;
 
-        Location mStart;
-        Location mEnd;
+        size_t mStart;
+        size_t mEnd;
         size_t mBytesConsumed;
 
     public:
 
         TokenTracker(const StringView& backingString,
-                     Parser* emitter, Location start)
+                     Emitter* emitter, size_t firstLine)
             : mBackingString(backingString), mEmitter(emitter),
-              mStart(start), mEnd(start), mBytesConsumed(0) {
-            // Preserve column/row numbers but set the position
-            // (relative to backing string) to 0.
-            mStart.pos = mEnd.pos = 0;
+              mFirstLine(firstLine), mStart(0), mEnd(0), mBytesConsumed(0) {
         }
 
         void flush(TokenEnum type = TOKEN) {
             emit(get(), type);
-            reset(mEnd.pos);
+            reset(mEnd);
             assert(empty());
         }
 
+        // Emit the token, which must be next in the backing string, on
+        // its own, after any before it.
         void emitToken(const StringView& token, TokenEnum type) {
             flush();
-            emit(token, type);
-            reset(mEnd.pos + token.size());
+            setEnd(mEnd + token.size());
+            assert(get() == token);
+            emit(get(), type);
+            reset(mEnd);
         }
 
         void setEnd(size_t index) {
             assert(index <= mBackingString.size());
-            assert(mEnd.pos <= index);
-            for (size_t i = mEnd.pos; i < index; i++) {
-                if (mBackingString[i] == '\n') {
-                    mEnd.line++;
-                    mEnd.column = 0;
-                } else {
-                    mEnd.column++;
-                }
-            }
-            mEnd.pos = index;
+            assert(mEnd <= index);
+            mEnd = index;
         }
 
         size_t size() const {
-            return mEnd.pos - mStart.pos;
+            return mEnd - mStart;
         }
 
         bool empty() const {
@@ -391,7 +496,22 @@ private:
         }
 
         StringView get() const {
-            return mBackingString.slice(mStart.pos, mEnd.pos);
+            return mBackingString.slice(mStart, mEnd);
+        }
+
+        // The position the current token starts at.
+        size_t start() const {
+            return mStart;
+        }
+
+        // Returns the line pos is on, for reporting errors at.
+        size_t line(size_t pos) const {
+            return LineIndex(mBackingString, mFirstLine).line(pos);
+        }
+
+        // Returns true if a '{' here opens a class or namespace body.
+        bool opensScope() const {
+            return mEmitter->opensScope();
         }
 
         size_t getBytesConsumed() const {
@@ -401,8 +521,8 @@ private:
     private:
         void reset(size_t index) {
             assert(index <= mBackingString.size());
-            assert(mEnd.pos <= index);
-            mEnd.pos = index;
+            assert(mEnd <= index);
+            mEnd = index;
             mStart = mEnd;
         }
 
@@ -415,7 +535,7 @@ private:
                     }
                     assert(!isspace(token[token.size()-1]));
                 }
-                mEmitter->acceptToken(Token(token, type, mStart, mEnd));
+                mEmitter->acceptToken(Token(token, type, mStart));
                 mBytesConsumed += token.size();
             }
         }
@@ -424,9 +544,79 @@ private:
     enum TokenizerState {
         INVALIDSTATE, NORMAL, CPP_COMMENT, C_COMMENT, LITERAL_CAPTURE,
         BRACE_CAPTURE, PARENS_CAPTURE, BRACKET_CAPTURE, ANGLE_CAPTURE,
-        PREPROCESSOR, OPERATOR
+        PREPROCESSOR, OPERATOR, OPERATOR_GROUP
+    };
+
+    static const size_t kOperatorLength = 8;  // strlen("operator")
+
+    // What a byte is to the NORMAL state, which switches on it: any
+    // other byte (OTH) is simply part of the current token.
+    enum CharClass {
+        OTH,        // anything else, including all bytes over 0x7F
+        SPC,        // whitespace, as isspace() in the C locale
+        LTR,        // a letter or '_'
+        DIG,        // a digit
+        QUO,        // ' "
+        SLA,        // /
+        LBR,        // {
+        RBR,        // }
+        LAN,        // <
+        LGR,        // ( [
+        EQU,        // =
+        COL,        // :
+        SEM,        // ;
+        HSH         // #
     };
 
+    static CharClass charClass(char c) {
+        static const unsigned char kClasses[256] = {
+            /* 0x00 */ OTH, OTH, OTH, OTH, OTH, OTH, OTH, OTH, OTH, SPC, SPC, SPC, SPC, SPC, OTH, OTH,
+            /* 0x10 */ OTH, OTH, OTH, OTH, OTH, OTH, OTH, OTH, OTH, OTH, OTH, OTH, OTH, OTH, OTH, OTH,
+            /* 0x20 */ SPC, OTH, QUO, HSH, OTH, OTH, OTH, QUO, LGR, OTH, OTH, OTH, OTH, OTH, OTH, SLA,
+            /* 0x30 */ DIG, DIG, DIG, DIG, DIG, DIG, DIG, DIG, DIG, DIG, COL, SEM, LAN, EQU, OTH, OTH,
+            /* 0x40 */ OTH, LTR, LTR, LTR, LTR, LTR, LTR, LTR, LTR, LTR, LTR, LTR, LTR, LTR, LTR, LTR,
+            /* 0x50 */ LTR, LTR, LTR, LTR, LTR, LTR, LTR, LTR, LTR, LTR, LTR, LGR, OTH, OTH, OTH, LTR,
+            /* 0x60 */ OTH, LTR, LTR, LTR, LTR, LTR, LTR, LTR, LTR, LTR, LTR, LTR, LTR, LTR, LTR, LTR,
+            /* 0x70 */ LTR, LTR, LTR, LTR, LTR, LTR, LTR, LTR, LTR, LTR, LTR, LBR, OTH, RBR, OTH, OTH,
+            // 0x80 - 0xFF are OTH.
+        };
+        return static_cast<CharClass>(kClasses[static_cast<unsigned char>(c)]);
+    }
+
+    static bool isSpace(char c) {
+        return charClass(c) == SPC;
+    }
+
+    static bool isIdentifierChar(char c) {
+        return charClass(c) == LTR || charClass(c) == DIG;
+    }
+
+    static TokenizerState getStateForChar(char c) {
+        switch (c) {
+        case '{': case '}': return BRACE_CAPTURE;
+        case '(': case ')': return PARENS_CAPTURE;
+        case '[': case ']': return BRACKET_CAPTURE;
+        case '<': case '>': return ANGLE_CAPTURE;
+        default: assert(false && "No state for specified char");
+            // Keep older versions of g++ happy that fail to deduce
+            // that assert(false) implies the function doesn't return.
+            return INVALIDSTATE;
+        }
+    }
+
+    static TokenEnum getTokenForChar(char c) {
+        switch (c) {
+        case '{': case '}': return BRACE_GROUP;
+        case '(': case ')': return PARENS_GROUP;
+        case '[': case ']': return TOKEN;
+        case '<': case '>': return TOKEN;
+        default: assert(false && "No token type for specified char");
+            // Keep older versions of g++ happy that fail to deduce
+            // that assert(false) implies the function doesn't return.
+            return INVALIDTOKEN;
+        }
+    }
+
     // StateStack provides syntactic sugar around a vector
     // of TokenizerStates.  In addition to more informative
     // method names, it also tracks extra state data and
@@ -441,18 +631,21 @@ private:
             bool chr_set;
             int depth;
             bool emit;
+            size_t start;   // the position a scope was opened at.
             ss(TokenizerState _state)
                 : state(_state),
                   chr(0),
                   chr_set(false),
                   depth(1),
-                  emit(true) {}
+                  emit(true),
+                  start(string::npos) {}
             ss()
                 : state(INVALIDSTATE),
                   chr(0),
                   chr_set(false),
                   depth(1),
-                  emit(true) {}
+                  emit(true),
+                  start(string::npos) {}
         };
 
         vector<ss> mStates;
@@ -477,6 +670,44 @@ private:
             mStates.pop_back();
         }
 
+        // Enter a class or namespace body, opened at the given position,
+        // which is tokenized as the top level is until its closing brace.
+        void pushScope(size_t start) {
+            pushState(NORMAL);
+            mStates.back().start = start;
+        }
+
+        // Returns true if in a scope's body, outside any capture in it.
+        bool inScope() const {
+            return mStates.size() > 1 && currentState() == NORMAL;
+        }
+
+        // The number of states open, including the initial NORMAL state.
+        size_t size() const {
+            return mStates.size();
+        }
+
+        // Returns true if outside any scope or capture.
+        bool atTopLevel() const {
+            return mStates.size() == 1;
+        }
+
+        // The position the outermost open scope was opened at, npos if
+        // none is, or it was open from the start.
+        size_t outermostScopeStart() const {
+            for (size_t i = 1; i < mStates.size(); i++) {
+                if (mStates[i].state == NORMAL) {
+                    return mStates[i].start;
+                }
+            }
+            return string::npos;
+        }
+
+        // Abandon all states but the initial NORMAL state.
+        void reset() {
+            mStates.resize(1);
+        }
+
         TokenizerState currentState() const {
             assert(!mStates.empty());
             return mStates.back().state;
@@ -1,39 +1,307 @@
+#include <algorithm>
+#include <dirent.h>   // for opendir(), readdir()
+#include <errno.h>
+#include <fcntl.h>    // for open()
 #include <fstream>
 #include <iostream>
-#include <libgen.h> // for dirname(), basename()
+#include <libgen.h>   // for dirname(), basename()
 #include <sstream>
 #include <string>
+#include <pthread.h>  // for pthread_self()
+#include <stdio.h>    // for rename(), snprintf()
+#include <string.h>   // for memcmp(), memcpy()
+#include <sys/stat.h> // for stat()
+#include <unistd.h>   // for read(), write(), close(), unlink()
 #include "Util.h"
 
+// Returns the index of the first byte at which a and b differ, or the
+// size of the shorter if one starts with the other.  Whole blocks are
+// compared with memcmp, which libc vectorizes, and then the block that
+// differs a word at a time.
+static size_t mismatch(const StringView& a, const StringView& b) {
+    static const size_t kBlock = 1024;
+    const size_t size = min(a.size(), b.size());
+    size_t i = 0;
+    for (; i + kBlock <= size && ::memcmp(a.data() + i, b.data() + i, kBlock) == 0;
+         i += kBlock);
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t wordA, wordB;
+        ::memcpy(&wordA, a.data() + i, sizeof(wordA));
+        ::memcpy(&wordB, b.data() + i, sizeof(wordB));
+        if (wordA != wordB) {
+            break;
+        }
+    }
+    for (; i < size && a[i] == b[i]; i++);
+    return i;
+}
+
+static bool isLineDirective(const StringView& line) {
+    return line.size() >= 5 && ::memcmp(line.data(), "#line", 5) == 0;
+}
+
+// The index just past the end of the first line of s.
+static size_t lineEnd(const StringView& s) {
+    size_t end;
+    return s.find('\n', &end) ? end + 1 : s.size();
+}
+
 bool Util::diff(StringView a, StringView b) {
-    size_t end = 0;
-    while (a.find('\n', &end)) {
-        end += 1; // capture the '\n' too.
-        StringView lineA = a.slice(0, end);
-        StringView lineB = b.slice(0, min(end, b.size()));
-        if (lineA.size() >= 5 && ::memcmp(lineA.data(), "#line", 5) == 0) {
-            if (lineB.size() >= 5 && ::memcmp(lineB.data(), "#line", 5) != 0) {
-                return true;
-            }
-        } else if (lineA != lineB) {
+    for (;;) {
+        size_t at = mismatch(a, b);
+        if (at == a.size() && at == b.size()) {
+            return false;
+        }
+        // Everything before the difference matches, so its line starts
+        // at the same place in both.
+        size_t lineStart = at;
+        for (; lineStart > 0 && a[lineStart-1] != '\n'; lineStart--);
+        a = a.slice(lineStart, a.size());
+        b = b.slice(lineStart, b.size());
+        if (!isLineDirective(a) || !isLineDirective(b)) {
             return true;
         }
-        a = a.slice(lineA.size(), a.size());
-        b = b.slice(lineB.size(), b.size());
+        a = a.slice(lineEnd(a), a.size());
+        b = b.slice(lineEnd(b), b.size());
+    }
+}
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// Final avalanche from MurmurHash3, so every input bit affects every output bit.
+static inline uint64_t fmix64(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+uint64_t Util::hash(StringView data, uint64_t seed) {
+    // A single-lane variant of MurmurHash3's 64-bit mixing,
+    // consuming the input a word at a time.
+    const uint64_t c1 = 0x87c37b91114253d5ULL;
+    const uint64_t c2 = 0x4cf5ad432745937fULL;
+    const char* p = data.data();
+    size_t size = data.size();
+    uint64_t h = seed ^ (size * c1);
+    for (; size >= 8; p += 8, size -= 8) {
+        uint64_t k;
+        ::memcpy(&k, p, 8);
+        k *= c1;
+        k = rotl64(k, 31);
+        k *= c2;
+        h ^= k;
+        h = rotl64(h, 27) * 5 + 0x52dce729;
+    }
+    uint64_t tail = 0;
+    for (size_t i = 0; i < size; i++) {
+        tail |= (uint64_t)(unsigned char)p[i] << (8 * i);
     }
-    return a != b;
+    tail *= c1;
+    tail = rotl64(tail, 31);
+    tail *= c2;
+    h ^= tail;
+    return fmix64(h);
 }
 
 bool Util::readFromFile(const string& filename,
                         string* contents) {
     ifstream inputFile(filename.c_str(),
                        ios::in|ios::binary|ios::ate);
-    if (!inputFile.good()) {
-        return false;
+    streamoff size = inputFile.tellg();
+    if (!inputFile.good() || size < 0 || (uint64_t)size > contents->max_size()) {
+        return false;   // e.g. a directory, which opens but has no size.
     }
-    contents->resize(inputFile.tellg());
+    contents->resize(size);
     inputFile.seekg(0, ios::beg);
     inputFile.read(&(*contents)[0], contents->size());
+    return inputFile.good();
+}
+
+bool Util::readFromDescriptor(int fd,
+                              string* contents) {
+    contents->clear();
+    char buffer[65536];
+    for (;;) {
+        ssize_t n = ::read(fd, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0) {
+            return false;
+        } else if (n == 0) {
+            return true;
+        }
+        contents->append(buffer, n);
+    }
+}
+
+bool Util::readFromDescriptor(int fd,
+                              size_t size,
+                              string* contents) {
+    contents->resize(size);
+    size_t read = 0;
+    while (read < size) {
+        ssize_t n = ::read(fd, &(*contents)[read], size - read);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0) {
+            return false;
+        } else if (n == 0) {
+            break;
+        }
+        read += n;
+    }
+    contents->resize(read);
+    return true;
+}
+
+bool Util::writeToDescriptor(int fd,
+                             const string& contents) {
+    const char* p = contents.data();
+    size_t remaining = contents.size();
+    while (remaining > 0) {
+        ssize_t n = ::write(fd, p, remaining);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            return false;
+        }
+        p += n;
+        remaining -= n;
+    }
+    return true;
+}
+
+string Util::temporaryFilename(const string& filename,
+                               unsigned n) {
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), ".tmp.%d.%lx.%u",
+             (int)::getpid(), (unsigned long)pthread_self(), n);
+    return filename + suffix;
+}
+
+int Util::openForWriting(const string& filename,
+                         string* tmpFilename) {
+    struct stat st;
+    bool exists = (::lstat(filename.c_str(), &st) == 0);
+    if (exists && !S_ISREG(st.st_mode)) {
+        // Write through e.g. a symlink or /dev/null rather than replace it.
+        tmpFilename->clear();
+        return ::open(filename.c_str(), O_WRONLY|O_TRUNC|O_CLOEXEC);
+    }
+    *tmpFilename = temporaryFilename(filename);
+    int fd = ::open(tmpFilename->c_str(), O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0666);
+    // The replacement keeps the mode of the file it replaces.
+    if (fd >= 0 && exists && ::fchmod(fd, st.st_mode & 07777) != 0) {
+        ::close(fd);
+        ::unlink(tmpFilename->c_str());
+        return -1;
+    }
+    return fd;
+}
+
+bool Util::writeFileAtomically(const string& filename,
+                               const string& contents) {
+    string tmpFilename;
+    int fd = openForWriting(filename, &tmpFilename);
+    if (fd < 0) {
+        return false;
+    }
+    bool written = writeToDescriptor(fd, contents);
+    if (::close(fd) != 0 || !written
+        || (!tmpFilename.empty() && ::rename(tmpFilename.c_str(), filename.c_str()) != 0)) {
+        if (!tmpFilename.empty()) {
+            ::unlink(tmpFilename.c_str());
+        }
+        return false;
+    }
+    return true;
+}
+
+bool Util::isDirectory(const string& path) {
+    struct stat st;
+    return ::stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+bool Util::listFiles(const string& dirname,
+                     const string& suffix,
+                     vector<string>* files) {
+    DIR* dir = ::opendir(dirname.c_str());
+    if (dir == NULL) {
+        return false;
+    }
+    // Directory entries, paired with whether each is known to be a
+    // directory/regular file from the entry's type, saving a stat().
+    vector<pair<string, unsigned char> > entries;
+    for (struct dirent* entry; (entry = ::readdir(dir)) != NULL; ) {
+        string name = entry->d_name;
+        if (name != "." && name != "..") {
+#ifdef _DIRENT_HAVE_D_TYPE
+            entries.push_back(make_pair(name, entry->d_type));
+#else
+            entries.push_back(make_pair(name, DT_UNKNOWN));
+#endif
+        }
+    }
+    ::closedir(dir);
+    // Sort so that the walk order is stable regardless of filesystem.
+    sort(entries.begin(), entries.end());
+
+    bool success = true;
+    string prefix = dirname;
+    if (prefix.empty() || prefix[prefix.size()-1] != '/') {
+        prefix += '/';
+    }
+    for (size_t i = 0; i < entries.size(); i++) {
+        string path = prefix + entries[i].first;
+        bool isDir = entries[i].second == DT_DIR;
+        bool isFile = entries[i].second == DT_REG;
+        if (!isDir && !isFile) {
+            // Unknown type or a symlink.  Symlinked files are followed,
+            // symlinked directories are not, as they may form a cycle.
+            struct stat st;
+            if (::lstat(path.c_str(), &st) != 0) {
+                continue; // Entry removed mid-walk.
+            }
+            bool isLink = S_ISLNK(st.st_mode);
+            if (isLink && ::stat(path.c_str(), &st) != 0) {
+                continue; // Dangling symlink.
+            }
+            isDir = S_ISDIR(st.st_mode) && !isLink;
+            isFile = S_ISREG(st.st_mode);
+        }
+        if (isDir) {
+            success = listFiles(path, suffix, files) && success;
+        } else if (isFile
+                   && path.size() >= suffix.size()
+                   && path.compare(path.size() - suffix.size(),
+                                   suffix.size(), suffix) == 0) {
+            files->push_back(path);
+        }
+    }
+    return success;
+}
+
+bool Util::readResponseFile(const string& filename,
+                            vector<string>* entries) {
+    string contents;
+    if (!readFromFile(filename, &contents)) {
+        return false;
+    }
+    istringstream lines(contents);
+    for (string line; getline(lines, line); ) {
+        const char* whitespace = " \t\r\n\v\f";
+        size_t start = line.find_first_not_of(whitespace);
+        if (start == string::npos || line[start] == '#') {
+            continue;
+        }
+        size_t end = line.find_last_not_of(whitespace);
+        entries->push_back(line.substr(start, end - start + 1));
+    }
     return true;
 }
 
@@ -1,19 +1,88 @@
 #ifndef __UTIL_H__
 #define __UTIL_H__
 
+#include <stdint.h>
+#include <string>
+#include <vector>
 #include "StringView.h"
 
+using namespace std;
+
 namespace Util {
 
     // Diff two strings, skipping any full '#line' directives
     // as long as they occur on the same line in both strings.
+    // The strings are compared a block at a time, only going line by
+    // line where they differ.
     bool diff(StringView a, StringView b);
 
+    // Fast non-cryptographic 64-bit hash of data, suitable for
+    // content addressing.  Different seeds give independent hashes.
+    uint64_t hash(StringView data, uint64_t seed = 0);
+
     // Read the contents of filename.
     // Returns true on success, false if there was a read failure.
     bool readFromFile(const string& filename,
                       string* contents);
 
+    // Read from fd until end of file, e.g. from a pipe, into contents.
+    // Returns true on success, false if there was a read failure.
+    bool readFromDescriptor(int fd,
+                            string* contents);
+
+    // Read the next size bytes from fd into contents, or as many as
+    // there are before end of file.
+    // Returns true on success, false if there was a read failure.
+    bool readFromDescriptor(int fd,
+                            size_t size,
+                            string* contents);
+
+    // Write all of contents to fd, retrying short writes.
+    // Returns true on success, false if there was a write failure.
+    bool writeToDescriptor(int fd,
+                           const string& contents);
+
+    // The name of a temporary file to write filename's contents to before
+    // renaming it into place, unique to this thread of this process and
+    // to n, e.g. for writing several at once.
+    string temporaryFilename(const string& filename,
+                             unsigned n = 0);
+
+    // Open a temporary file to write filename's contents to, setting
+    // tmpFilename, for the caller to rename into place once written.  The
+    // temporary file takes the mode of the file it replaces.  If filename
+    // exists but isn't a regular file, e.g. a symlink or /dev/null, opens
+    // it to write through in place instead, clearing tmpFilename.
+    // Returns the descriptor, or -1 on failure.
+    int openForWriting(const string& filename,
+                       string* tmpFilename);
+
+    // Write contents to filename by way of a temporary file renamed into
+    // place, so that concurrent readers never see a partial file.
+    // An existing filename that isn't a regular file, e.g. a symlink or
+    // /dev/null, is written through in place instead.
+    // Returns true on success, false if there was a write failure.
+    bool writeFileAtomically(const string& filename,
+                             const string& contents);
+
+    // Returns true if path exists and is a directory.
+    bool isDirectory(const string& path);
+
+    // Recursively walk the directory dirname, appending the path of every
+    // regular file ending in suffix to files, in sorted order.  Symlinks
+    // to files are followed but symlinks to directories are not.
+    // Returns true on success, false if a directory could not be read.
+    bool listFiles(const string& dirname,
+                   const string& suffix,
+                   vector<string>* files);
+
+    // Read a response file, appending each non-empty line
+    // (with surrounding whitespace trimmed) to entries.
+    // Lines beginning with '#' are treated as comments.
+    // Returns true on success, false if there was a read failure.
+    bool readResponseFile(const string& filename,
+                          vector<string>* entries);
+
     // Given an output format string and the original input
     // filename, generate the expanded output path.
     // Returns true on success, setting outputPath to the expansion.
@@ -0,0 +1,188 @@
+#include <algorithm> // for sort(), unique()
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>     // for strerror()
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "Watcher.h"
+
+// How long the watched directories must be quiet before changes are
+// reported, and the longest a change waits on a continuing burst.
+static const int kQuietMs = 2;
+static const int kMaxDelayMs = 50;
+
+// The directory events that may mean a file was saved, or that a new
+// directory needs watching.
+static const uint32_t kEvents = IN_CLOSE_WRITE|IN_MOVED_TO|IN_CREATE;
+
+static volatile sig_atomic_t sStopRequested = 0;
+
+static void requestStop(int) {
+    sStopRequested = 1;
+}
+
+static int64_t nowMs() {
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static string joinPath(const string& dirname, const string& name) {
+    if (!dirname.empty() && dirname[dirname.size()-1] == '/') {
+        return dirname + name;
+    }
+    return dirname + "/" + name;
+}
+
+Watcher::Watcher(const string& suffix)
+    : mSuffix(suffix), mFd(::inotify_init1(IN_NONBLOCK|IN_CLOEXEC)) {
+    // Install the stop handlers without SA_RESTART, so
+    // that a signal interrupts wait() and lets it return.
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = requestStop;
+    sigemptyset(&action.sa_mask);
+    ::sigaction(SIGINT, &action, NULL);
+    ::sigaction(SIGTERM, &action, NULL);
+}
+
+Watcher::~Watcher() {
+    if (mFd >= 0) {
+        ::close(mFd);
+    }
+}
+
+bool Watcher::add(const string& dirname, ostream& err) {
+    vector<string> files;
+    if (mFd < 0 || !addTree(dirname, &files)) {
+        err << "ERROR: failed to watch " << dirname << ": " << strerror(errno) << endl;
+        return false;
+    }
+    mRoots.push_back(dirname);
+    return true;
+}
+
+bool Watcher::addTree(const string& dirname, vector<string>* files) {
+    // Watch before listing, so a file added in between isn't missed.
+    int wd = ::inotify_add_watch(mFd, dirname.c_str(), kEvents|IN_ONLYDIR);
+    if (wd < 0) {
+        return false;
+    }
+    mDirs[wd] = dirname;
+
+    DIR* dir = ::opendir(dirname.c_str());
+    if (dir == NULL) {
+        return false;
+    }
+    vector<string> subdirs;
+    for (struct dirent* entry; (entry = ::readdir(dir)) != NULL; ) {
+        string name = entry->d_name;
+        if (name == "." || name == "..") {
+            continue;
+        }
+        string path = joinPath(dirname, name);
+        struct stat st;
+        if (::stat(path.c_str(), &st) != 0) {
+            continue; // Removed mid-walk.
+        }
+        if (S_ISDIR(st.st_mode)) {
+            subdirs.push_back(path);
+        } else if (S_ISREG(st.st_mode)
+                   && path.size() >= mSuffix.size()
+                   && path.compare(path.size() - mSuffix.size(),
+                                   mSuffix.size(), mSuffix) == 0) {
+            files->push_back(path);
+        }
+    }
+    ::closedir(dir);
+
+    bool success = true;
+    for (size_t i = 0; i < subdirs.size(); i++) {
+        success = addTree(subdirs[i], files) && success;
+    }
+    return success;
+}
+
+bool Watcher::stopped() const {
+    return sStopRequested;
+}
+
+bool Watcher::wait(vector<string>* changed, ostream& err) {
+    changed->clear();
+    int64_t firstChange = 0;
+    while (!sStopRequested) {
+        // Block until the first change, then until a quiet period.
+        int timeout = -1;
+        if (!changed->empty()) {
+            timeout = min((int64_t)kQuietMs, firstChange + kMaxDelayMs - nowMs());
+            if (timeout <= 0) {
+                break;
+            }
+        }
+        struct pollfd pfd;
+        pfd.fd = mFd;
+        pfd.events = POLLIN;
+        int ready = ::poll(&pfd, 1, timeout);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            err << "ERROR: failed to wait for changes: " << strerror(errno) << endl;
+            return false;
+        } else if (ready == 0) {
+            break;
+        }
+
+        char buffer[64 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+        ssize_t size;
+        while ((size = ::read(mFd, buffer, sizeof(buffer))) > 0) {
+            for (char* p = buffer; p < buffer + size; ) {
+                const struct inotify_event* event = (const struct inotify_event*)p;
+                p += sizeof(struct inotify_event) + event->len;
+
+                if (event->mask & IN_Q_OVERFLOW) {
+                    // Events were lost, so treat everything as changed.
+                    for (size_t i = 0; i < mRoots.size(); i++) {
+                        addTree(mRoots[i], changed);
+                    }
+                    continue;
+                } else if (event->mask & IN_IGNORED) {
+                    mDirs.erase(event->wd);
+                    continue;
+                }
+                map<int, string>::const_iterator dir = mDirs.find(event->wd);
+                if (dir == mDirs.end() || event->len == 0) {
+                    continue;
+                }
+                string path = joinPath(dir->second, event->name);
+                if (event->mask & IN_ISDIR) {
+                    if (event->mask & (IN_CREATE|IN_MOVED_TO)) {
+                        addTree(path, changed);
+                    }
+                } else if ((event->mask & (IN_CLOSE_WRITE|IN_MOVED_TO))
+                           && path.size() >= mSuffix.size()
+                           && path.compare(path.size() - mSuffix.size(),
+                                           mSuffix.size(), mSuffix) == 0) {
+                    changed->push_back(path);
+                }
+            }
+        }
+        if (size < 0 && errno != EAGAIN && errno != EINTR) {
+            err << "ERROR: failed to read changes: " << strerror(errno) << endl;
+            return false;
+        }
+        if (firstChange == 0 && !changed->empty()) {
+            firstChange = nowMs();
+        }
+    }
+    if (sStopRequested) {
+        return false;
+    }
+    sort(changed->begin(), changed->end());
+    changed->erase(unique(changed->begin(), changed->end()), changed->end());
+    return true;
+}
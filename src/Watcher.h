@@ -0,0 +1,52 @@
+#ifndef __WATCHER_H__
+#define __WATCHER_H__
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Watches directory trees with inotify for files being saved, so that
+// they can be re-split as soon as they change.
+//
+// Editors may save a file in several steps, and several files at once,
+// so changes are collected until the watched directories have been quiet
+// for a few milliseconds, then reported together.
+//
+class Watcher {
+public:
+    // Watch for changes to files ending in suffix.
+    explicit Watcher(const string& suffix);
+    ~Watcher();
+
+    // Watch dirname and every directory below it.
+    // Returns false, after reporting to err, on failure.
+    bool add(const string& dirname, ostream& err);
+
+    // Block until files have been written or moved into place, setting
+    // changed to their paths, sorted.  Directories created since are
+    // watched, and any files already in them reported as changed.
+    // Returns false on SIGINT/SIGTERM, or after reporting a failure to err.
+    bool wait(vector<string>* changed, ostream& err);
+
+    // Returns true if SIGINT/SIGTERM has asked for watching to stop.
+    bool stopped() const;
+
+private:
+    const string mSuffix;
+    int mFd;                    // the inotify instance.
+    map<int, string> mDirs;     // watch descriptor to directory path.
+    vector<string> mRoots;      // the directories passed to add().
+
+    // Watch dirname and the directories below it, appending any files
+    // found to files.  Returns false if any of them can't be watched.
+    bool addTree(const string& dirname, vector<string>* files);
+
+    // Non-copyable.
+    Watcher(const Watcher&);
+    Watcher& operator=(const Watcher&);
+};
+
+#endif //__WATCHER_H__
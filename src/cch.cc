@@ -0,0 +1,16 @@
+#include "cch.h"
+#include "Splitter.h"
+
+cch::Result cch::split(const StringView& input,
+                       const Options& options,
+                       Output& output) {
+    Result result;
+    string h, cc;
+    result.ok = Splitter::split(options.filename, input, options.emitLineNumbers,
+                                options.includeBanner ? Splitter::banner() : "",
+                                &h, &cc, NULL, &result.error);
+    if (result.ok) {
+        output.write(h, cc);
+    }
+    return result;
+}
@@ -0,0 +1,60 @@
+#ifndef __CCH_H__
+#define __CCH_H__
+
+#include <string>
+#include "StringView.h"
+
+// libcch: splits the contents of a .cch file into its .h and .cc outputs
+// in-process, as cch itself would, without touching the filesystem.
+//
+// split() keeps no state between calls, so any number of threads may
+// split at once.  A malformed input is reported in the Result rather
+// than ending the process.
+//
+namespace cch {
+
+    struct Options {
+        // The name of the .cch file, which the .cc's '#include' of the
+        // header and the #line directives are derived from.
+        std::string filename;
+        bool emitLineNumbers;
+        bool includeBanner;
+
+        explicit Options(const std::string& _filename)
+            : filename(_filename), emitLineNumbers(true), includeBanner(true) {}
+    };
+
+    // Receives the outputs of a successful split.
+    class Output {
+    public:
+        virtual ~Output() {}
+
+        virtual void write(const std::string& h, const std::string& cc) = 0;
+    };
+
+    // An Output that keeps the outputs in memory.
+    class StringOutput : public Output {
+    public:
+        std::string h;
+        std::string cc;
+
+        void write(const std::string& _h, const std::string& _cc) {
+            h = _h;
+            cc = _cc;
+        }
+    };
+
+    struct Result {
+        bool ok;
+        std::string error;   // why the input couldn't be split, if not ok.
+
+        Result() : ok(true) {}
+    };
+
+    // Split input, writing its outputs to output if it is well formed.
+    Result split(const StringView& input,
+                 const Options& options,
+                 Output& output);
+}
+
+#endif //__CCH_H__
@@ -0,0 +1,83 @@
+// cch-client: a thin stand-in for cch that forwards its command line to
+// a resident 'cch --serve' process, avoiding the cost of starting cch for
+// every file.  Takes exactly the same arguments as cch.
+//
+// If no server is listening, falls back to exec'ing the cch binary
+// installed alongside this client, so build rules work either way.
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>     // for PATH_MAX
+#include <stdio.h>
+#include <stdlib.h>     // for getenv()
+#include <string.h>
+#include <unistd.h>
+#include "Protocol.h"
+
+static int fallback(char** argv) {
+    string client = argv[0];
+    size_t slash = client.rfind('/');
+    string cch = (slash == string::npos)
+        ? "cch"
+        : client.substr(0, slash + 1) + "cch";
+    argv[0] = &cch[0];
+    if (slash == string::npos) {
+        ::execvp(cch.c_str(), argv);
+    } else {
+        ::execv(cch.c_str(), argv);
+    }
+    fprintf(stderr, "ERROR: no cch server and failed to run %s: %s\n",
+            cch.c_str(), strerror(errno));
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    int fd = Protocol::connectTo(Protocol::defaultSocketPath());
+    if (fd < 0) {
+        return fallback(argv);
+    }
+
+    char cwd[PATH_MAX];
+    if (::getcwd(cwd, sizeof(cwd)) == NULL) {
+        fprintf(stderr, "ERROR: failed to get working directory: %s\n",
+                strerror(errno));
+        return 1;
+    }
+    vector<string> request;
+    request.push_back(cwd);
+    for (int i = 1; i < argc; i++) {
+        request.push_back(argv[i]);
+    }
+
+    vector<string> env;
+    for (size_t i = 0; i < Protocol::kEnvironmentSize; i++) {
+        const char* value = ::getenv(Protocol::kEnvironment[i]);
+        if (value != NULL) {
+            env.push_back(string(Protocol::kEnvironment[i]) + "=" + value);
+        }
+    }
+    // A jobserver pipe passed as descriptors only exists in this process,
+    // so hand the server its own copies.
+    vector<int> fds;
+    int readFd, writeFd;
+    if (Protocol::jobServerFds(::getenv("MAKEFLAGS"), &readFd, &writeFd)
+        && ::fcntl(readFd, F_GETFD) != -1 && ::fcntl(writeFd, F_GETFD) != -1) {
+        fds.push_back(readFd);
+        fds.push_back(writeFd);
+    }
+
+    string out, err;
+    int32_t status;
+    if (!Protocol::sendStrings(fd, request)
+        || !Protocol::sendStrings(fd, env)
+        || !Protocol::sendFds(fd, fds)
+        || !Protocol::recvString(fd, &out)
+        || !Protocol::recvString(fd, &err)
+        || !Protocol::recvInt(fd, &status)) {
+        fprintf(stderr, "ERROR: lost connection to cch server\n");
+        return 1;
+    }
+    ::close(fd);
+    fwrite(out.data(), 1, out.size(), stdout);
+    fwrite(err.data(), 1, err.size(), stderr);
+    return status;
+}
@@ -0,0 +1,315 @@
+#!/bin/bash
+# Runs the reference CCH files through CCH's batch modes (multiple inputs,
+# directories, response files and parallel jobs) and checks the outputs
+# are identical to splitting each file on its own.
+#
+# Returns the number of failure cases (0 on success).
+
+. $(dirname $0)/common.sh
+
+# Set up temporary directory and a hook to remove it on exit.
+tmp=$(mktemp -d 2>/dev/null || mktemp -d -t cch)
+trap 'rm -rf "$tmp"' EXIT
+
+CCH="build/cch --noBanner"
+failure_count=0
+
+# Establish the reference outputs one file per invocation.
+mkdir -p "$tmp/reference"
+for test_case in test/cases/*.cch; do
+    try $CCH --input "$test_case" --output "$tmp/reference/%f" || exit 1
+done
+
+# check <name> <cch args...> runs CCH with the given input arguments,
+# writing to a fresh directory, and compares against the reference.
+check() {
+    local name=$1
+    shift
+    rm -rf "$tmp/out" && mkdir -p "$tmp/out"
+    try $CCH "$@" --output "$tmp/out/%f" && \
+        try diff -r "$tmp/reference" "$tmp/out"
+    if [ $? -eq 0 ]; then
+        printf "[${GREEN}OK${DEFAULT}]     "
+    else
+        ((failure_count++))
+        printf "[${RED}FAILED${DEFAULT}] "
+    fi
+    echo "$name"
+}
+
+ls test/cases/*.cch > "$tmp/inputs.rsp"
+repeated_inputs=$(for f in test/cases/*.cch; do echo "--input $f"; done)
+
+echo "Running batch mode test cases"
+check "repeated inputs" $repeated_inputs
+check "directory input" --input test/cases
+check "response file" --input "@$tmp/inputs.rsp"
+check "parallel jobs" -j 4 --input test/cases
+check "unbatched file I/O" --noIoUring --input test/cases
+
+# A directory symlink cycle must not be walked.
+mkdir -p "$tmp/cycle" && cp test/cases/enum.cch "$tmp/cycle/" && ln -s .. "$tmp/cycle/up"
+rm -rf "$tmp/out" && mkdir -p "$tmp/out"
+if try timeout 10 $CCH --input "$tmp/cycle" --output "$tmp/out/%f" \
+        && [ "$(ls "$tmp/out")" = "$(printf 'enum.cch.cc\nenum.cch.h')" ] \
+        && try cmp "$tmp/reference/enum.cch.h" "$tmp/out/enum.cch.h"; then
+    printf "[${GREEN}OK${DEFAULT}]     "
+else
+    ((failure_count++))
+    printf "[${RED}FAILED${DEFAULT}] "
+fi
+echo "directory symlink cycle"
+
+# Inputs large enough to be mapped must split as they do when read.
+mkdir -p "$tmp/large"
+for i in $(seq 64); do cat test/cases/*.cch; done > "$tmp/large/large.cch"
+for args in "" "--noIoUring"; do
+    try $CCH $args --noMmap --input "$tmp/large/large.cch" --output "$tmp/large/read%f" && \
+        try $CCH $args --input "$tmp/large/large.cch" --output "$tmp/large/mapped%f" && \
+        try cmp "$tmp/large/readlarge.cch.h" "$tmp/large/mappedlarge.cch.h" && \
+        try cmp "$tmp/large/readlarge.cch.cc" "$tmp/large/mappedlarge.cch.cc"
+    if [ $? -eq 0 ]; then
+        printf "[${GREEN}OK${DEFAULT}]     "
+    else
+        ((failure_count++))
+        printf "[${RED}FAILED${DEFAULT}] "
+    fi
+    echo "mapped input ${args:-(io_uring)}"
+done
+
+# Inputs split a chunk at a time, from files or stdin, must split as they
+# do whole, leaving identical outputs untouched.
+check "streamed inputs" --stream --input test/cases
+ls -i "$tmp/out" > "$tmp/inodes"
+try $CCH --stream --input test/cases --output "$tmp/out/%f"
+ls -i "$tmp/out" > "$tmp/inodes.restreamed"
+# Several chunks' worth, to be split in pieces.
+for i in 1 2 3 4; do cat "$tmp/large/large.cch"; done > "$tmp/large/huge.cch"
+try $CCH --input "$tmp/large/huge.cch" --output "$tmp/large/whole%f" && \
+    try $CCH --stream --input "$tmp/large/huge.cch" --output "$tmp/large/streamed%f" && \
+    try $CCH --stream --input - --stdinName "$tmp/large/huge.cch" --hFd 3 --ccFd 4 \
+        < "$tmp/large/huge.cch" 3> "$tmp/large/fd.h" 4> "$tmp/large/fd.cc" && \
+    try cmp "$tmp/large/wholehuge.cch.h" "$tmp/large/streamedhuge.cch.h" && \
+    try cmp "$tmp/large/wholehuge.cch.cc" "$tmp/large/streamedhuge.cch.cc" && \
+    try cmp "$tmp/large/wholehuge.cch.h" "$tmp/large/fd.h" && \
+    try cmp "$tmp/large/wholehuge.cch.cc" "$tmp/large/fd.cc" && \
+    try diff "$tmp/inodes" "$tmp/inodes.restreamed"
+if [ $? -eq 0 ]; then
+    printf "[${GREEN}OK${DEFAULT}]     "
+else
+    ((failure_count++))
+    printf "[${RED}FAILED${DEFAULT}] "
+fi
+echo "streamed large input"
+
+# Outputs served from the cache must match freshly split ones.
+check "cache populate" --input test/cases --cacheDir "$tmp/cache"
+check "cache hit" --input test/cases --cacheDir "$tmp/cache"
+check "cache hardlink" --input test/cases --cacheDir "$tmp/cache" --cacheHardlink
+check "compressed cache populate" --input test/cases --cacheDir "$tmp/zcache" --cacheCompress
+check "compressed cache hit" --input test/cases --cacheDir "$tmp/zcache"
+cases=$(ls test/cases/*.cch | wc -l)
+if grep -qx "hits $((2 * cases))" "$tmp/cache/stats" \
+        && grep -qx "misses $cases" "$tmp/cache/stats"; then
+    printf "[${GREEN}OK${DEFAULT}]     "
+else
+    ((failure_count++))
+    printf "[${RED}FAILED${DEFAULT}] "
+fi
+echo "cache stats"
+
+# Hardlinked outputs share their entry's inode, so neither a no-op rerun
+# nor a cache hit elsewhere may touch them, or make would rebuild their
+# dependents every time.
+rm -rf "$tmp/linked" "$tmp/elsewhere" && mkdir -p "$tmp/linked" "$tmp/elsewhere"
+try $CCH --input test/cases --cacheDir "$tmp/cache" --cacheHardlink --output "$tmp/linked/%f"
+touch "$tmp/before-rerun"
+sleep 0.1
+try $CCH --input test/cases --cacheDir "$tmp/cache" --cacheHardlink --output "$tmp/linked/%f"
+try $CCH --input test/cases --cacheDir "$tmp/cache" --output "$tmp/elsewhere/%f"
+if [ -z "$(find "$tmp/linked" -newer "$tmp/before-rerun")" ] \
+        && try diff -r "$tmp/reference" "$tmp/linked"; then
+    printf "[${GREEN}OK${DEFAULT}]     "
+else
+    ((failure_count++))
+    printf "[${RED}FAILED${DEFAULT}] "
+fi
+echo "hardlinked outputs left untouched"
+
+# Outputs identical to what exists are left untouched, unless overwriting,
+# and rewritten ones replaced by a rename, never written through in place.
+check "populate outputs" --input test/cases
+ls -i "$tmp/out" > "$tmp/inodes"
+echo "// edited" >> "$tmp/out/enum.cch.h"
+try $CCH --input test/cases --output "$tmp/out/%f"
+ls -i "$tmp/out" > "$tmp/inodes.resplit"
+try $CCH --overwrite --input test/cases --output "$tmp/out/%f"
+ls -i "$tmp/out" > "$tmp/inodes.overwritten"
+if [ "$(diff "$tmp/inodes" "$tmp/inodes.resplit" | grep -c '^>')" -eq 1 ] \
+        && grep -q " enum.cch.h$" <(diff "$tmp/inodes" "$tmp/inodes.resplit") \
+        && ! grep -qx "$(grep " enum.cch.cc$" "$tmp/inodes")" "$tmp/inodes.overwritten" \
+        && [ -z "$(ls "$tmp/out" | grep '\.tmp\.')" ] \
+        && try diff -r "$tmp/reference" "$tmp/out"; then
+    printf "[${GREEN}OK${DEFAULT}]     "
+else
+    ((failure_count++))
+    printf "[${RED}FAILED${DEFAULT}] "
+fi
+echo "unchanged outputs left untouched"
+
+# Inputs recorded in the journal are skipped until they or their outputs change.
+check "journal populate" --input test/cases --journal "$tmp/journal"
+skipped=$($CCH --input test/cases --journal "$tmp/journal" --output "$tmp/out/%f" | \
+              grep -c "split to")
+echo "// edited" >> "$tmp/out/enum.cch.h"
+resplit=$($CCH --input test/cases --journal "$tmp/journal" --output "$tmp/out/%f" | \
+              grep "split to" | cut -d' ' -f2)
+if [ "$skipped" -eq 0 ] && [ "$resplit" == "test/cases/enum.cch" ] \
+        && try diff -r "$tmp/reference" "$tmp/out"; then
+    printf "[${GREEN}OK${DEFAULT}]     "
+else
+    ((failure_count++))
+    printf "[${RED}FAILED${DEFAULT}] "
+fi
+echo "journal skips up to date inputs"
+
+# Requests forwarded by cch-client to a resident server.
+export CCH_SOCKET="$tmp/cch.sock"
+build/cch --serve 2>/dev/null &
+server=$!
+for i in 1 2 3 4 5 6 7 8 9 10; do
+    [ -S "$CCH_SOCKET" ] && break
+    sleep 0.1
+done
+CCH="build/cch-client --noBanner" check "served requests" --input test/cases
+
+# A stalled connection must not hold up other requests, which run in the
+# client's environment.  The copied client has no cch to fall back to.
+mkdir -p "$tmp/bin" && cp build/cch-client "$tmp/bin/"
+perl -MIO::Socket::UNIX -e 'IO::Socket::UNIX->new(Peer => $ARGV[0]) or die; sleep 30' \
+    "$CCH_SOCKET" &
+staller=$!
+sleep 0.1
+rm -rf "$tmp/out" "$tmp/served-cache" && mkdir -p "$tmp/out"
+if CCH_CACHE_DIR="$tmp/served-cache" try timeout 10 "$tmp/bin/cch-client" --noBanner \
+        --input test/cases --output "$tmp/out/%f" \
+        && try diff -r "$tmp/reference" "$tmp/out" \
+        && [ -n "$(ls -A "$tmp/served-cache" 2>/dev/null)" ]; then
+    printf "[${GREEN}OK${DEFAULT}]     "
+else
+    ((failure_count++))
+    printf "[${RED}FAILED${DEFAULT}] "
+fi
+echo "concurrent served requests"
+kill $staller
+wait $staller 2>/dev/null
+kill $server
+wait $server 2>/dev/null
+unset CCH_SOCKET
+
+# A watched input is re-split when saved, rewriting only changed outputs.
+rm -rf "$tmp/out" "$tmp/watched" && mkdir -p "$tmp/out" && cp -r test/cases "$tmp/watched"
+$CCH --watch "$tmp/watched" --output "$tmp/out/%f" >/dev/null 2>"$tmp/watch.log" &
+watcher=$!
+for i in $(seq 50); do
+    grep -q "watching for changes" "$tmp/watch.log" && break
+    sleep 0.1
+done
+touch "$tmp/before-edit"
+sleep 0.1
+echo "// edited" >> "$tmp/watched/enum.cch"
+for i in $(seq 50); do
+    grep -q "// edited" "$tmp/out/enum.cch.h" && break
+    sleep 0.1
+done
+kill -INT $watcher
+wait $watcher
+rc=$?
+rm -rf "$tmp/expected" && mkdir -p "$tmp/expected"
+try $CCH --input "$tmp/watched" --output "$tmp/expected/%f"
+if [ $rc -eq 0 ] && try diff -r "$tmp/expected" "$tmp/out" \
+        && [ ! "$tmp/out/enum.cch.cc" -nt "$tmp/before-edit" ]; then
+    printf "[${GREEN}OK${DEFAULT}]     "
+else
+    ((failure_count++))
+    printf "[${RED}FAILED${DEFAULT}] "
+fi
+echo "watched inputs re-split on save"
+
+# An input compiled with --exec builds without writing any outputs, and
+# its diagnostics point at the .cch.
+rm -rf "$tmp/exec" && mkdir -p "$tmp/exec"
+echo "#define ANSWER 42" > "$tmp/exec/answer.h"
+cat > "$tmp/exec/prog.cch" <<'EOF'
+#include "answer.h"
+
+class Answer {
+public:
+    int get() const {
+        return ANSWER;
+    }
+};
+
+int main() {
+    return Answer().get() == 42 ? 0 : 1;
+}
+EOF
+try $CCH --exec -- ${CXX:-g++} -o "$tmp/prog" "$tmp/exec/prog.cch" && "$tmp/prog"
+rc=$?
+sed "s/ANSWER;/MISSING;/" "$tmp/exec/prog.cch" > "$tmp/exec/broken.cch"
+$CCH --exec --input "$tmp/exec/broken.cch" -- ${CXX:-g++} -c -o "$tmp/broken.o" \
+    2>"$tmp/exec.log"
+broken_rc=$?
+if [ $rc -eq 0 ] && [ $broken_rc -ne 0 ] && grep -q "broken.cch:6" "$tmp/exec.log" \
+        && [ $(ls "$tmp/exec" | wc -l) -eq 3 ] && [ ! -e "$tmp/broken.o" ]; then
+    printf "[${GREEN}OK${DEFAULT}]     "
+else
+    ((failure_count++))
+    printf "[${RED}FAILED${DEFAULT}] "
+fi
+echo "compile with --exec"
+
+# Outputs streamed to stdout are framed by a 'cch <h|cc> <size> <path>'
+# line, and must match the files a normal run writes.
+rm -rf "$tmp/out" && mkdir -p "$tmp/out"
+$CCH --stdout --input test/cases --output "$tmp/reference/%f" > "$tmp/framed"
+rc=$?
+while read -r tag kind size path; do
+    dd bs=1 count="$size" of="$tmp/out/${path##*/}" 2>/dev/null
+done < "$tmp/framed"
+if [ $rc -eq 0 ] && try diff -r "$tmp/reference" "$tmp/out"; then
+    printf "[${GREEN}OK${DEFAULT}]     "
+else
+    ((failure_count++))
+    printf "[${RED}FAILED${DEFAULT}] "
+fi
+echo "framed outputs on stdout"
+
+# An input read from stdin splits as the file it's named as.
+$CCH --input - --stdinName test/cases/enum.cch --hFd 3 --ccFd 4 \
+    < test/cases/enum.cch 3>"$tmp/stdin.h" 4>"$tmp/stdin.cc"
+rc=$?
+if [ $rc -eq 0 ] && try cmp "$tmp/reference/enum.cch.h" "$tmp/stdin.h" \
+        && try cmp "$tmp/reference/enum.cch.cc" "$tmp/stdin.cc"; then
+    printf "[${GREEN}OK${DEFAULT}]     "
+else
+    ((failure_count++))
+    printf "[${RED}FAILED${DEFAULT}] "
+fi
+echo "stdin input to descriptor outputs"
+
+# A missing input must fail the run without stopping the other inputs.
+rm -rf "$tmp/out" && mkdir -p "$tmp/out"
+$CCH --input test/cases --input "$tmp/missing.cch" --output "$tmp/out/%f" >/dev/null 2>&1
+rc=$?
+if [ $rc -ne 0 ] && try diff -r "$tmp/reference" "$tmp/out"; then
+    printf "[${GREEN}OK${DEFAULT}]     "
+else
+    ((failure_count++))
+    printf "[${RED}FAILED${DEFAULT}] "
+fi
+echo "missing input"
+
+[ $failure_count -eq 0 ] || echo "${RED}ERROR:   $failure_count failures${DEFAULT}"
+
+exit $failure_count
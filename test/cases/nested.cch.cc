@@ -0,0 +1,23 @@
+#include "nested.cch.h"
+
+    outer::inner::Widget::Widget() : mSize(0) {}
+            bool outer::inner::Widget::Part::Id::operator<(const Id& other) const {
+                return value < other.value;
+            }
+            /* static */ int outer::inner::Widget::Part::Id::next() {
+                return sCounter++;
+            }
+            /* static */ int outer::inner::Widget::Part::Id::sCounter;
+
+        Id outer::inner::Widget::Part::id() const { return mId; }
+
+    size_t outer::inner::Widget::size() const {
+        return mSize;
+    }
+
+    /* static */ const int outer::inner::Widget::kLimit = 16;
+    /* static */ std::string outer::inner::Widget::sName; // namespace inner
+
+int outer::topLevel(int x) {
+    return x * 2;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+
+namespace outer {
+namespace inner { // Nested namespaces, each a scope of its own.
+
+class Widget {
+public:
+    Widget();
+
+    // A class nested in a class.
+    class Part {
+    public:
+        struct Id {
+            int value;
+            bool operator<(const Id& other) const;
+            static int next();
+            static int sCounter;
+        };
+
+        Id id() const;
+
+    private:
+        Id mId;
+    };
+
+    enum class Kind { Small, Large };
+
+    size_t size() const;
+
+    static const int kLimit;
+    static std::string sName;
+
+private:
+    size_t mSize;
+};
+
+template <typename T>
+class Holder {
+    class Slot {
+        T value;
+    public:
+        T get() { return value; }
+    };
+};
+
+} // namespace inner
+
+int topLevel(int x);
+
+} // namespace outer
+
@@ -72,3 +72,9 @@
     double OverrideCity::operator "" _foo(const char* str) {
         return some_conversion_of_str_to_double(str);
     }
+
+// Identifiers that merely start with 'operator'.
+int operatorCount = 0;
+int operator_index(int operators) {
+    return operators + operatorCount;
+}
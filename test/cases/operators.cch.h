@@ -73,3 +73,7 @@ public:
     double operator "" _foo(const char* str);
 };
 
+// Identifiers that merely start with 'operator'.
+int operatorCount;
+int operator_index(int operators);
+
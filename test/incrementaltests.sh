@@ -0,0 +1,86 @@
+#!/bin/bash
+# Edits each reference CCH file a line at a time, re-splitting the edited
+# file incrementally from the outputs and map of the original, and checks
+# the results are identical to splitting the edited file in full.
+#
+# Returns the number of failure cases (0 on success).
+
+. $(dirname $0)/common.sh
+
+# Set up temporary directory and a hook to remove it on exit.
+tmp=$(mktemp -d 2>/dev/null || mktemp -d -t cch)
+trap 'rm -rf "$tmp"' EXIT
+
+# Some edits leave a file that fails to split, which may abort.
+ulimit -c 0
+
+CCH="build/cch --incremental"
+failure_count=0
+incremental_count=0
+edit_count=0
+
+# edit <line> <file> prints file with an edit made at line, the kind
+# of edit varying with the line number.
+edit() {
+    case $(($1 % 4)) in
+        0) sed "$1d" "$2" ;;
+        1) sed "$1i int incremental_$1;" "$2" ;;
+        2) sed "$1p" "$2" ;;
+        3) sed "$1s|\$| // edited|" "$2" ;;
+    esac
+}
+
+# split splits $tmp/input.cch to $tmp/out, printing the exit status.
+split() {
+    $CCH --debug --input "$tmp/input.cch" --output "$tmp/out/%f" >/dev/null 2>>"$tmp/log"
+    echo $?
+}
+
+echo "Running incremental re-split test cases"
+for test_case in test/cases/*.cch; do
+    lines=$(wc -l < "$test_case")
+    failed=0
+    for ((line = 1; line <= lines; line++)); do
+        # Split the original, then re-split it edited.
+        rm -rf "$tmp/out" "$tmp/incremental" && mkdir -p "$tmp/out"
+        cp "$test_case" "$tmp/input.cch"
+        split >/dev/null
+        edit $line "$test_case" > "$tmp/input.cch"
+        : > "$tmp/log"
+        incremental_rc=$(split)
+        grep -q "re-split incrementally" "$tmp/log" && ((incremental_count++))
+        ((edit_count++))
+
+        # Split the edited file in full to the same place, as the
+        # outputs and map depend on where they are written.
+        mv "$tmp/out" "$tmp/incremental" && mkdir -p "$tmp/out"
+        full_rc=$(split)
+        if [ "$incremental_rc" != "$full_rc" ]; then
+            echo "line $line: exit status $incremental_rc, expected $full_rc"
+            failed=1
+        elif [ "$full_rc" == 0 ] && ! try diff -r "$tmp/out" "$tmp/incremental"; then
+            echo "line $line: outputs differ"
+            failed=1
+        fi
+    done
+    if [ $failed -eq 0 ]; then
+        printf "[${GREEN}OK${DEFAULT}]     "
+    else
+        ((failure_count++))
+        printf "[${RED}FAILED${DEFAULT}] "
+    fi
+    echo "$test_case"
+done
+
+# Most edits should be re-split incrementally rather than in full.
+if [ $((2 * incremental_count)) -ge $edit_count ]; then
+    printf "[${GREEN}OK${DEFAULT}]     "
+else
+    ((failure_count++))
+    printf "[${RED}FAILED${DEFAULT}] "
+fi
+echo "$incremental_count of $edit_count edits re-split incrementally"
+
+[ $failure_count -eq 0 ] || echo "${RED}ERROR:   $failure_count failures${DEFAULT}"
+
+exit $failure_count
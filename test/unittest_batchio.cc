@@ -0,0 +1,139 @@
+#include <iostream>
+#include <assert.h>
+#include <sstream>
+#include <stdlib.h> // for mkdtemp(), system()
+#include <sys/stat.h>
+#include <unistd.h>
+#include "BatchIO.h"
+#include "MappedFile.h"
+#include "Util.h"
+
+// Write and read back a batch of files through io, including more files
+// than fit in a single submission, an empty file and files that can't be
+// written or read.
+static void testReadWrite(BatchIO* io, const string& dir) {
+    vector<string> contents;
+    for (int i = 0; i < 300; i++) {
+        stringstream content;
+        for (int j = 0; j < i * 37; j++) {
+            content << j << (j % 16 == 0 ? '\n' : ' ');
+        }
+        contents.push_back(content.str());
+    }
+    vector<BatchIO::Request> writes;
+    for (size_t i = 0; i < contents.size(); i++) {
+        stringstream filename;
+        filename << dir << "/" << i;
+        writes.push_back(BatchIO::Request(filename.str(), &contents[i]));
+    }
+    string unwritable = "x";
+    writes.push_back(BatchIO::Request(dir + "/missing/file", &unwritable));
+    io->write(&writes);
+    for (size_t i = 0; i < contents.size(); i++) {
+        assert(writes[i].ok);
+        string written;
+        assert(Util::readFromFile(writes[i].filename, &written));
+        assert(written == contents[i]);
+    }
+    assert(!writes.back().ok);
+    // Each file was written to a temporary file renamed into place.
+    vector<string> files;
+    assert(Util::listFiles(dir, "", &files));
+    assert(files.size() == contents.size());
+
+    vector<string> read(contents.size() + 2, "stale");
+    vector<BatchIO::Request> reads;
+    for (size_t i = 0; i < contents.size(); i++) {
+        reads.push_back(BatchIO::Request(writes[i].filename, &read[i]));
+    }
+    reads.push_back(BatchIO::Request(dir + "/missing/file", &read[contents.size()]));
+    reads.push_back(BatchIO::Request(dir, &read[contents.size() + 1]));
+    io->read(&reads);
+    for (size_t i = 0; i < contents.size(); i++) {
+        assert(reads[i].ok);
+        assert(read[i] == contents[i]);
+    }
+    assert(!reads[contents.size()].ok);
+    assert(!reads[contents.size() + 1].ok);
+}
+
+// Writing a file with other hardlinks must leave the other links untouched.
+static void testHardlinks(BatchIO* io, const string& dir) {
+    string original = "original", replacement = "replacement";
+    vector<BatchIO::Request> writes;
+    writes.push_back(BatchIO::Request(dir + "/linked", &original));
+    io->write(&writes);
+    assert(writes[0].ok);
+    assert(::link((dir + "/linked").c_str(), (dir + "/link").c_str()) == 0);
+
+    writes[0].contents = &replacement;
+    io->write(&writes);
+    assert(writes[0].ok);
+    string contents;
+    assert(Util::readFromFile(dir + "/linked", &contents) && contents == replacement);
+    assert(Util::readFromFile(dir + "/link", &contents) && contents == original);
+
+    // The same file may be written more than once in a batch.
+    writes.push_back(BatchIO::Request(dir + "/linked", &replacement));
+    io->write(&writes);
+    assert(writes[0].ok && writes[1].ok);
+    assert(Util::readFromFile(dir + "/linked", &contents) && contents == replacement);
+}
+
+// Rewriting a file must keep its mode.
+static void testMode(BatchIO* io, const string& dir) {
+    string original = "original", replacement = "replacement";
+    vector<BatchIO::Request> writes;
+    writes.push_back(BatchIO::Request(dir + "/readonly", &original));
+    writes.push_back(BatchIO::Request(dir + "/executable", &original));
+    io->write(&writes);
+    assert(::chmod((dir + "/readonly").c_str(), 0444) == 0);
+    assert(::chmod((dir + "/executable").c_str(), 0755) == 0);
+
+    writes[0].contents = writes[1].contents = &replacement;
+    io->write(&writes);
+    assert(writes[0].ok && writes[1].ok);
+    struct stat st;
+    assert(::stat((dir + "/readonly").c_str(), &st) == 0 && (st.st_mode & 07777) == 0444);
+    assert(::stat((dir + "/executable").c_str(), &st) == 0 && (st.st_mode & 07777) == 0755);
+    string contents;
+    assert(Util::readFromFile(dir + "/readonly", &contents) && contents == replacement);
+}
+
+// Large inputs read into a MappedFile are mapped, small ones read.
+static void testMapped(BatchIO* io, const string& dir) {
+    string small = "int x;\n", large(MappedFile::kMapThreshold + 1, 'x');
+    vector<BatchIO::Request> writes;
+    writes.push_back(BatchIO::Request(dir + "/small", &small));
+    writes.push_back(BatchIO::Request(dir + "/large", &large));
+    io->write(&writes);
+
+    MappedFile files[3];
+    vector<BatchIO::Request> reads;
+    reads.push_back(BatchIO::Request(dir + "/small", &files[0]));
+    reads.push_back(BatchIO::Request(dir + "/large", &files[1]));
+    reads.push_back(BatchIO::Request(dir + "/missing", &files[2]));
+    io->read(&reads);
+    assert(reads[0].ok && !files[0].mapped() && files[0].contents() == small);
+    assert(reads[1].ok && files[1].mapped() && files[1].contents() == large);
+    assert(!reads[2].ok);
+}
+
+int main(int argc, char** argv) {
+
+    for (int useRing = 0; useRing < 2; useRing++) {
+        char dir[] = "/tmp/cchtestXXXXXX";
+        assert(mkdtemp(dir) != NULL);
+        BatchIO io(useRing);
+        if (!useRing) {
+            assert(!io.usingRing());
+        }
+        testReadWrite(&io, dir);
+        testHardlinks(&io, dir);
+        testMode(&io, dir);
+        testMapped(&io, dir);
+        assert(system((string("rm -rf ") + dir).c_str()) == 0);
+    }
+
+    return 0;
+}
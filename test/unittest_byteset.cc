@@ -0,0 +1,144 @@
+#include <iostream>
+#include <assert.h>
+#include <stdlib.h>
+#include "ByteSet.h"
+#include "Splitter.h"
+#include "Util.h"
+
+// The sets of bytes the tokenizer's capture states search for.
+static const char* kSets[] = {
+    "*", "\n", "\"\\", "'\\", "'\"/{}", "'\"/()", "'\"/[]", "'\"/<>"
+};
+static const size_t kNumSets = sizeof(kSets) / sizeof(kSets[0]);
+
+static const ByteSet::Kernel kKernels[] = { ByteSet::SCALAR, ByteSet::SSE2, ByteSet::AVX2 };
+
+// Find from every position of input with every supported kernel,
+// checking each against a byte at a time search.
+static void checkFinds(const ByteSet& set, const string& input) {
+    for (size_t from = 0; from <= input.size(); from++) {
+        size_t expected = from;
+        for (; expected < input.size() && !set.contains(input[expected]); expected++);
+        for (size_t k = 0; k < 3; k++) {
+            if (ByteSet::supported(kKernels[k])) {
+                assert(set.find(input.data(), input.size(), from, kKernels[k]) == expected);
+            }
+        }
+    }
+}
+
+// Count from the given position of input with every supported kernel,
+// checking each against a byte at a time count.
+static void checkCount(const ByteSet& set, const string& input, size_t from) {
+    size_t expected = 0;
+    for (size_t i = from; i < input.size(); i++) {
+        expected += set.contains(input[i]) ? 1 : 0;
+    }
+    for (size_t k = 0; k < 3; k++) {
+        if (ByteSet::supported(kKernels[k])) {
+            assert(set.count(input.data(), input.size(), from, kKernels[k]) == expected);
+        }
+    }
+}
+
+// Mutate input as the tokenizer is least likely to expect: cut it
+// short, splice another input into it, or insert an unbalanced token.
+static string mutate(const string& input, const string& other) {
+    static const char* kInserts[] = {
+        "{", "}", "(", ")", "<", ">", "[", "]", "\"", "'", "\\", "/*", "*/", "//", "\n", "#",
+        "class X {", "namespace {", "operator", "\"\\\""
+    };
+    size_t at = input.empty() ? 0 : rand() % (input.size() + 1);
+    switch (rand() % 3) {
+    case 0:
+        return input.substr(0, at);
+    case 1:
+        return input.substr(0, at) + other.substr(other.empty() ? 0 : rand() % other.size());
+    default:
+        return input.substr(0, at) + kInserts[rand() % (sizeof(kInserts) / sizeof(kInserts[0]))]
+            + input.substr(at);
+    }
+}
+
+int main(int argc, char** argv) {
+
+    {   // Every kernel finds the first byte in the set, and counts
+        // them, whatever the alignment, and none past the end.
+        srand(1);
+        for (size_t s = 0; s < kNumSets; s++) {
+            ByteSet set(kSets[s]);
+            for (size_t size = 0; size <= 100; size++) {
+                string input;
+                for (size_t i = 0; i < size; i++) {
+                    // Mostly misses, with bytes either side of those in
+                    // the set, and bytes over 127.
+                    input += (rand() % 8 == 0) ? kSets[s][rand() % strlen(kSets[s])]
+                        : (char)(kSets[s][0] + (rand() % 3) - 1 + (rand() % 2) * 128);
+                }
+                checkFinds(set, input);
+                for (size_t from = 0; from <= size; from++) {
+                    checkCount(set, input, from);
+                }
+                // A hit just past the end isn't found.
+                string padded = input + kSets[s][0];
+                for (size_t k = 0; k < 3; k++) {
+                    if (ByteSet::supported(kKernels[k])) {
+                        assert(set.find(padded.data(), size, 0, kKernels[k]) <= size);
+                        assert(set.count(padded.data(), size, 0, kKernels[k])
+                               == set.count(input.data(), size, 0, kKernels[k]));
+                    }
+                }
+            }
+        }
+    }
+
+    {   // Counts of more hits than a byte can hold, as in a long run of
+        // blank lines.
+        ByteSet set("\n");
+        string input(100000, '\n');
+        input[12345] = ' ';
+        for (size_t from = 0; from < 40; from++) {
+            checkCount(set, input, from);
+        }
+    }
+
+    vector<string> inputs;
+    {   // Every kernel agrees on the test cases, from every position.
+        vector<string> filenames;
+        assert(Util::listFiles("test/cases", ".cch", &filenames) && !filenames.empty());
+        for (size_t i = 0; i < filenames.size(); i++) {
+            string input;
+            assert(Util::readFromFile(filenames[i], &input));
+            inputs.push_back(input);
+            for (size_t s = 0; s < kNumSets; s++) {
+                checkFinds(ByteSet(kSets[s]), input);
+                checkCount(ByteSet(kSets[s]), input, 0);
+            }
+        }
+    }
+
+    {   // Splits are the same with every kernel, of the test cases and
+        // of malformed mutations of them.
+        srand(2);
+        size_t numCases = inputs.size();
+        for (size_t i = 0; i < 1000; i++) {
+            inputs.push_back(mutate(inputs[rand() % numCases], inputs[rand() % numCases]));
+        }
+        ByteSet::Kernel fastest = ByteSet::kernel();
+        for (size_t i = 0; i < inputs.size(); i++) {
+            string h, cc, error;
+            ByteSet::useKernel(ByteSet::SCALAR);
+            bool ok = Splitter::split("a.cch", inputs[i], true, "", &h, &cc, NULL, &error);
+            assert(ok || i >= numCases);
+            for (size_t k = 1; k < 3; k++) {
+                if (ByteSet::supported(kKernels[k])) {
+                    ByteSet::useKernel(kKernels[k]);
+                    string kh, kcc, kerror;
+                    assert(Splitter::split("a.cch", inputs[i], true, "", &kh, &kcc, NULL, &kerror) == ok);
+                    assert(kh == h && kcc == cc && kerror == error);
+                }
+            }
+        }
+        ByteSet::useKernel(fastest);
+    }
+}
@@ -0,0 +1,123 @@
+#include <iostream>
+#include <assert.h>
+#include <fcntl.h>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h> // for mkdtemp()
+#include <sys/stat.h> // for mkfifo()
+#include <unistd.h>
+#include "JobServer.h"
+
+// Counts the peak number of jobs running at once.
+class ConcurrencyRunner : public ThreadPool::Runner {
+    Mutex mMutex;
+    int mRunning;
+public:
+    int peak;
+    int completed;
+
+    ConcurrencyRunner() : mRunning(0), peak(0), completed(0) {}
+
+    void runJob(size_t) {
+        {
+            MutexLock lock(mMutex);
+            mRunning++;
+            peak = max(peak, mRunning);
+        }
+        usleep(1000);
+        MutexLock lock(mMutex);
+        mRunning--;
+        completed++;
+    }
+};
+
+static string makeflags(int readFd, int writeFd) {
+    stringstream flags;
+    flags << "-j3 --jobserver-auth=" << readFd << "," << writeFd;
+    return flags.str();
+}
+
+static void* cancelSoon(void* arg) {
+    usleep(10000);
+    static_cast<JobServer*>(arg)->cancel();
+    return NULL;
+}
+
+int main(int argc, char** argv) {
+    stringstream err;
+
+    {   // No jobserver advertised.
+        assert(JobServer::fromMakeflags(NULL, err) == NULL);
+        assert(JobServer::fromMakeflags("-j4 -k", err) == NULL);
+    }
+
+    {   // A jobserver that's advertised but closed grants no slots.
+        JobServer* jobServer = JobServer::fromMakeflags("--jobserver-auth=97,98", err);
+        assert(jobServer != NULL);
+        assert(!jobServer->usable());
+        assert(!jobServer->acquire());
+        assert(!err.str().empty());
+        delete jobServer;
+    }
+
+    {   // Pipe form: tokens are taken, returned, and cancel() wakes waiters.
+        int fds[2];
+        assert(pipe(fds) == 0);
+        assert(write(fds[1], "ab", 2) == 2);
+        JobServer* jobServer = JobServer::fromMakeflags(makeflags(fds[0], fds[1]).c_str(), err);
+        assert(jobServer != NULL && jobServer->usable());
+        assert(jobServer->acquire());
+        assert(jobServer->acquire());
+
+        pthread_t thread;
+        assert(pthread_create(&thread, NULL, cancelSoon, jobServer) == 0);
+        assert(!jobServer->acquire());  // blocks until cancelled.
+        pthread_join(thread, NULL);
+
+        jobServer->release();
+        jobServer->release();
+        delete jobServer;
+        char tokens[3];
+        fcntl(fds[0], F_SETFL, O_NONBLOCK);
+        assert(read(fds[0], tokens, 3) == 2);
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    {   // The pool never runs more jobs than the implicit slot plus tokens.
+        int fds[2];
+        assert(pipe(fds) == 0);
+        assert(write(fds[1], "+", 1) == 1);
+        JobServer* jobServer = JobServer::fromMakeflags(makeflags(fds[0], fds[1]).c_str(), err);
+        vector<size_t> jobs;
+        for (size_t i = 0; i < 50; i++) {
+            jobs.push_back(i);
+        }
+        ConcurrencyRunner runner;
+        ThreadPool(8, jobServer).run(jobs, &runner);
+        assert(runner.completed == 50);
+        assert(runner.peak <= 2);
+        delete jobServer;
+        char token;
+        assert(read(fds[0], &token, 1) == 1 && token == '+');
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    {   // Named pipe form.
+        char scratch[] = "/tmp/cch_unittest_XXXXXX";
+        string fifo = string(::mkdtemp(scratch)) + "/fifo";
+        assert(mkfifo(fifo.c_str(), 0600) == 0);
+        // Hold the fifo open so it stays readable between clients.
+        int holder = open(fifo.c_str(), O_RDWR);
+        assert(write(holder, "x", 1) == 1);
+        JobServer* jobServer = JobServer::fromMakeflags(("--jobserver-auth=fifo:" + fifo).c_str(), err);
+        assert(jobServer != NULL && jobServer->usable());
+        assert(jobServer->acquire());
+        jobServer->release();
+        delete jobServer;
+        close(holder);
+        unlink(fifo.c_str());
+        rmdir(scratch);
+    }
+}
@@ -0,0 +1,108 @@
+#include <iostream>
+#include <assert.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <vector>
+#include "cch.h"
+#include "Util.h"
+
+static const char* kInputs[] = {
+    "test/cases/allinone.cch",
+    "test/cases/enum.cch",
+    "test/cases/namespace.cch",
+    "test/cases/template.cch",
+};
+static const size_t kNumInputs = sizeof(kInputs) / sizeof(kInputs[0]);
+static const int kThreads = 8;
+static const int kRounds = 20;
+
+struct Expected {
+    string cch;
+    string h;
+    string cc;
+};
+
+// Splits every input repeatedly, checking each split matches a serial one.
+static void* splitRepeatedly(void* arg) {
+    const vector<Expected>& expected = *static_cast<vector<Expected>*>(arg);
+    for (int round = 0; round < kRounds; round++) {
+        for (size_t i = 0; i < expected.size(); i++) {
+            cch::StringOutput output;
+            cch::Result result = cch::split(expected[i].cch, cch::Options(kInputs[i]), output);
+            if (!result.ok || output.h != expected[i].h || output.cc != expected[i].cc) {
+                return arg;
+            }
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char** argv) {
+
+    {
+        cch::Options options("dir/simple.cch");
+        options.includeBanner = false;
+        cch::StringOutput output;
+        cch::Result result = cch::split("int f() {\n    return 1;\n}\n", options, output);
+        assert(result.ok);
+        assert(result.error.empty());
+        assert(output.h == "#pragma once\n\n\n#line 1 \"dir/simple.cch\"\nint f();\n"
+               "#line 3 \"dir/simple.cch\"\n\n\n");
+        assert(output.cc == "#include \"simple.cch.h\"\n\n#line 1 \"dir/simple.cch\"\n"
+               "int f() {\n    return 1;\n}\n#line 3 \"dir/simple.cch\"\n\n");
+
+        options.emitLineNumbers = false;
+        result = cch::split("int f() {\n    return 1;\n}\n", options, output);
+        assert(result.ok);
+        assert(output.h == "#pragma once\n\nint f();\n\n");
+    }
+
+    {   // Malformed inputs are reported without touching the output.
+        cch::StringOutput output;
+        output.h = output.cc = "untouched";
+        cch::Result result = cch::split("int f() {\n    return 1;\n", cch::Options("a.cch"), output);
+        assert(!result.ok);
+        assert(result.error == "a.cch, line 1: unclosed capture");
+        assert(output.h == "untouched" && output.cc == "untouched");
+
+        result = cch::split("int x\n", cch::Options("b.cch"), output);
+        assert(!result.ok);
+        assert(result.error.find("b.cch, line 1: unconsumed tokens") == 0);
+
+        result = cch::split("class A {\n    void f() const throw() {}\n", cch::Options("c.cch"), output);
+        assert(!result.ok);
+        assert(result.error.find("c.cch, line 1: ") == 0);
+    }
+
+    if (sizeof(size_t) > 4) {   // Inputs past 4GiB are refused, not truncated.
+        size_t size = (size_t)0xffffffffu + 1;
+        void* huge = ::mmap(NULL, size, PROT_READ, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+        assert(huge != MAP_FAILED);
+        cch::StringOutput output;
+        cch::Result result = cch::split(StringView((const char*)huge, size),
+                                        cch::Options("huge.cch"), output);
+        assert(!result.ok);
+        assert(result.error == "huge.cch, input too large to split (over 4GiB)");
+        ::munmap(huge, size);
+    }
+
+    {   // Concurrent splits match serial ones.
+        vector<Expected> expected(kNumInputs);
+        for (size_t i = 0; i < kNumInputs; i++) {
+            assert(Util::readFromFile(kInputs[i], &expected[i].cch));
+            cch::StringOutput output;
+            assert(cch::split(expected[i].cch, cch::Options(kInputs[i]), output).ok);
+            expected[i].h = output.h;
+            expected[i].cc = output.cc;
+        }
+        pthread_t threads[kThreads];
+        for (int i = 0; i < kThreads; i++) {
+            assert(pthread_create(&threads[i], NULL, splitRepeatedly, &expected) == 0);
+        }
+        for (int i = 0; i < kThreads; i++) {
+            void* failed;
+            assert(pthread_join(threads[i], &failed) == 0);
+            assert(failed == NULL);
+        }
+    }
+}
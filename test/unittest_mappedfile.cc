@@ -0,0 +1,62 @@
+#include <iostream>
+#include <assert.h>
+#include <sstream>
+#include <stdlib.h> // for mkdtemp(), system()
+#include <unistd.h>
+#include "MappedFile.h"
+#include "Util.h"
+
+int main(int argc, char** argv) {
+    char dir[] = "/tmp/cchtestXXXXXX";
+    assert(mkdtemp(dir) != NULL);
+    const string base = dir;
+
+    {   // Empty and small files are read, large ones mapped.
+        string small = "int f() {\n    return 1;\n}\n";
+        string large;
+        while (large.size() < MappedFile::kMapThreshold) {
+            large += small;
+        }
+        assert(Util::writeFileAtomically(base + "/empty", ""));
+        assert(Util::writeFileAtomically(base + "/small", small));
+        assert(Util::writeFileAtomically(base + "/large", large));
+
+        MappedFile file;
+        assert(file.open(base + "/empty"));
+        assert(!file.mapped() && file.contents().size() == 0);
+        assert(file.open(base + "/small"));
+        assert(!file.mapped() && file.contents() == small);
+        assert(file.open(base + "/large"));
+        assert(file.mapped() && file.contents() == large);
+
+        // Reopening releases the mapping.
+        assert(file.open(base + "/small"));
+        assert(!file.mapped() && file.contents() == small);
+        file.release();
+        assert(file.contents().size() == 0);
+    }
+
+    {   // Special files are read to the end rather than mapped by size.
+        int fds[2];
+        assert(::pipe(fds) == 0);
+        assert(Util::writeToDescriptor(fds[1], "piped"));
+        ::close(fds[1]);
+        stringstream path;
+        path << "/dev/fd/" << fds[0];
+        MappedFile file;
+        assert(file.open(path.str()));
+        assert(!file.mapped() && file.contents() == "piped");
+        ::close(fds[0]);
+        assert(file.open("/dev/null"));
+        assert(!file.mapped() && file.contents().size() == 0);
+    }
+
+    {   // Missing files and directories fail to open.
+        MappedFile file;
+        assert(!file.open(base + "/missing"));
+        assert(!file.open(base));
+    }
+
+    assert(system(("rm -rf " + base).c_str()) == 0);
+    return 0;
+}
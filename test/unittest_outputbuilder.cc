@@ -0,0 +1,47 @@
+#include <iostream>
+#include <assert.h>
+#include "OutputBuilder.h"
+
+int main(int argc, char** argv) {
+
+    {   // Referenced slices are copied once, on the way out.
+        const string input = "int f() {\n    return 1;\n}\n";
+        StringView view(input);
+        OutputBuilder output;
+        output << view.slice(0, 4) << view.slice(4, 7) << ";" << view.slice(7, input.size());
+        assert(output.size() == input.size() + 1);
+        assert(output.copied() == 0);
+        string out = "banner\n";
+        output.appendTo(&out);
+        assert(out == "banner\nint f();" + input.substr(7));
+        assert(output.copied() == output.size());
+    }
+
+    {   // Generated text is copied in, and numbers written in decimal.
+        OutputBuilder output;
+        string scope = "A::B::";
+        output << "\n#line " << (size_t)0 << " " << (size_t)1234567890 << "\n";
+        output << scope;
+        scope = "overwritten";
+        output << (size_t)42;
+        assert(output.copied() == 1 + 10 + 6 + 2);
+        string out;
+        output.appendTo(&out);
+        assert(out == "\n#line 0 1234567890\nA::B::42");
+    }
+
+    {   // Any range of the output can be taken, across fragments.
+        const string input = "abcdef";
+        OutputBuilder output;
+        output << StringView(input).slice(0, 3) << string("123") << StringView(input).slice(3, 6);
+        for (size_t start = 0; start <= output.size(); start++) {
+            for (size_t end = start; end <= output.size(); end++) {
+                string out = "x";
+                output.appendTo(&out, start, end);
+                assert(out == "x" + string("abc123def").substr(start, end - start));
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include <iostream>
+#include <assert.h>
+#include <stdio.h>
+#include "Splitter.h"
+#include "Util.h"
+
+// Assert that splitting input in pieces of pieceSize on numThreads
+// threads, if it's done at all, matches splitting it whole.  Returns
+// true if it was split in pieces.
+static bool matchesSplit(const string& filename, const string& input,
+                         size_t numThreads, size_t pieceSize) {
+    string h, cc, error;
+    bool ok = Splitter::split(filename, input, true, "// banner\n", &h, &cc, NULL, &error);
+    string parallelH, parallelCc;
+    if (!Splitter::splitParallel(filename, input, true, "// banner\n",
+                                 numThreads, pieceSize, &parallelH, &parallelCc)) {
+        return false;
+    }
+    if (!ok || parallelH != h || parallelCc != cc) {
+        cerr << filename << " split differently in pieces of " << pieceSize
+             << " on " << numThreads << " threads" << endl;
+        assert(false);
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+
+    vector<string> inputs;
+    assert(Util::listFiles("test/cases", ".cch", &inputs) && !inputs.empty());
+    vector<string> contents(inputs.size());
+    for (size_t i = 0; i < inputs.size(); i++) {
+        assert(Util::readFromFile(inputs[i], &contents[i]));
+    }
+
+    {   // Each test case splits the same in pieces as whole.
+        size_t pieceSizes[] = { 1, 16, 256 };
+        size_t threads[] = { 1, 2, 4 };
+        for (size_t i = 0; i < inputs.size(); i++) {
+            for (size_t p = 0; p < 3; p++) {
+                for (size_t t = 0; t < 3; t++) {
+                    matchesSplit(inputs[i], contents[i], threads[t], pieceSizes[p]);
+                }
+            }
+        }
+    }
+
+    {   // So do the test cases run together, with some cut off partway
+        // through, where the cuts guessed at may not hold.
+        string all;
+        for (size_t i = 0; i < inputs.size(); i++) {
+            all += contents[i];
+            matchesSplit("all.cch", all, 4, 64);
+            matchesSplit("all.cch", all.substr(0, all.size() / 2), 4, 64);
+            matchesSplit("all.cch", all.substr(0, all.size() - contents[i].size() / 3), 4, 64);
+        }
+    }
+
+    {   // Declarations in namespaces are cut between, keeping their
+        // line numbers, and the namespaces open at each cut.
+        string input = "#include <string>\n";
+        for (int i = 0; i < 200; i++) {
+            char decl[256];
+            input.append(decl, snprintf(decl, sizeof(decl),
+                                        "namespace a%d { namespace b {\n"
+                                        "// Returns %d.\nint f%d() {\n    return %d;\n}\n"
+                                        "class C%d {\n    int g() { return 0; }\n};\n"
+                                        "static const int kX%d = %d;\n"
+                                        "} }\n",
+                                        i / 10, i, i, i, i, i, i));
+        }
+        assert(matchesSplit("ns.cch", input, 4, 64));
+        assert(matchesSplit("ns.cch", input, 2, 1024));
+    }
+
+    {   // Malformed inputs are left to a serial split to report.
+        string input;
+        for (int i = 0; i < 100; i++) {
+            input += "int f() {\n    return 1;\n}\n";
+        }
+        string h, cc;
+        assert(Splitter::splitParallel("a.cch", input, true, "", 4, 64, &h, &cc));
+        assert(!Splitter::splitParallel("b.cch", input + "int x\n", true, "", 4, 64, &h, &cc));
+        assert(!Splitter::splitParallel("c.cch", input + "int g() {\n", true, "", 4, 64, &h, &cc));
+        assert(!Splitter::splitParallel("d.cch", input.substr(0, input.size() - 5), true, "", 4, 64, &h, &cc));
+    }
+}
@@ -0,0 +1,142 @@
+#include <iostream>
+#include <assert.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "Splitter.h"
+#include "Util.h"
+
+// Keeps the outputs, or only their size if discarding them.
+class StringSink : public Splitter::Sink {
+public:
+    string h;
+    string cc;
+    size_t size;
+    size_t writes;
+    bool discard;
+    bool fail;
+
+    StringSink() : size(0), writes(0), discard(false), fail(false) {}
+
+    bool write(const string& _h, const string& _cc) {
+        if (!discard) {
+            h += _h;
+            cc += _cc;
+        }
+        size += _h.size() + _cc.size();
+        writes++;
+        return !fail;
+    }
+};
+
+// Stream input into sink, feeding it step bytes at a time.
+static bool stream(const string& filename, const string& input,
+                   size_t chunkSize, size_t step,
+                   StringSink* sink, string* error) {
+    Splitter::Stream stream(filename, true, "// banner\n", sink, chunkSize);
+    for (size_t i = 0; i < input.size(); i += step) {
+        if (!stream.feed(input.data() + i, min(step, input.size() - i))) {
+            *error = stream.error();
+            return false;
+        }
+    }
+    bool ok = stream.finish();
+    *error = stream.error();
+    return ok;
+}
+
+// Stream a generated input of the given size with a 64K chunk, and
+// return the peak RSS of doing so in KB.
+static long streamedPeakKb(size_t inputSize) {
+    pid_t pid = ::fork();
+    if (pid == 0) {
+        StringSink sink;
+        sink.discard = true;
+        Splitter::Stream stream("gen.cch", true, "", &sink, 64 * 1024);
+        string chunk;
+        size_t fed = 0;
+        for (int i = 0; fed < inputSize; i++) {
+            char line[128];
+            chunk.append(line, snprintf(line, sizeof(line),
+                                        "// Function %d.\nint f%d(int x) {\n    return x + %d;\n}\n",
+                                        i, i, i));
+            if (chunk.size() >= 4096) {
+                if (!stream.feed(chunk.data(), chunk.size())) {
+                    _exit(1);
+                }
+                fed += chunk.size();
+                chunk.clear();
+            }
+        }
+        _exit(stream.finish() && sink.size > inputSize ? 0 : 1);
+    }
+    int status;
+    struct rusage usage;
+    assert(pid > 0 && ::wait4(pid, &status, 0, &usage) == pid);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+int main(int argc, char** argv) {
+
+    {   // Streamed splits match whole ones, however the input is cut up.
+        vector<string> inputs;
+        assert(Util::listFiles("test/cases", ".cch", &inputs) && !inputs.empty());
+        for (size_t i = 0; i < inputs.size(); i++) {
+            string input, h, cc, error;
+            assert(Util::readFromFile(inputs[i], &input));
+            assert(Splitter::split(inputs[i], input, true, "// banner\n", &h, &cc, NULL, &error));
+            size_t chunkSizes[] = { 1, 7, 64, 1024 };
+            size_t steps[] = { 1, 3, 1000 };
+            for (size_t c = 0; c < 4; c++) {
+                for (size_t s = 0; s < 3; s++) {
+                    StringSink sink;
+                    assert(stream(inputs[i], input, chunkSizes[c], steps[s], &sink, &error));
+                    assert(sink.h == h);
+                    assert(sink.cc == cc);
+                }
+            }
+        }
+    }
+
+    {   // Outputs are written a declaration at a time, and all at once
+        // if the input fits in a chunk.
+        string input = "int f() {\n    return 1;\n}\nint g() {\n    return 2;\n}\n";
+        StringSink sink;
+        string error;
+        assert(stream("a.cch", input, 1, 1, &sink, &error));
+        assert(sink.writes == 2);
+        StringSink whole;
+        assert(stream("a.cch", input, input.size() + 1, input.size(), &whole, &error));
+        assert(whole.writes == 1);
+        assert(whole.h == sink.h && whole.cc == sink.cc);
+    }
+
+    {   // Malformed inputs and sink failures are reported.
+        StringSink sink;
+        string error;
+        assert(!stream("a.cch", "int f() {\n    return 1;\n", 4, 4, &sink, &error));
+        assert(error == "a.cch, line 1: unclosed capture");
+        assert(!stream("b.cch", "int f() {}\nint x\n", 4, 4, &sink, &error));
+        assert(error.find("b.cch, line 2: unconsumed tokens") == 0);
+        assert(!stream("c.cch", "void f() const throw() {}\nint g() {}\n", 4, 4, &sink, &error));
+        assert(error.find("c.cch, line 1: ") == 0);
+        sink.fail = true;
+        assert(!stream("d.cch", "int f() {}\n", 4, 4, &sink, &error));
+        assert(error == "failed to write output");
+    }
+
+    {   // Memory stays flat as the input grows.
+        long smallKb = streamedPeakKb(1024 * 1024);
+        long largeKb = streamedPeakKb(8 * 1024 * 1024);
+        if (largeKb - smallKb >= 1024) {
+            cerr << "Peak RSS grew from " << smallKb << "KB to " << largeKb << "KB" << endl;
+            assert(false);
+        }
+    }
+}
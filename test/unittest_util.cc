@@ -1,7 +1,15 @@
 #include <iostream>
 #include <assert.h>
+#include <fstream>
+#include <stdlib.h> // for mkdtemp(), system()
+#include <unistd.h> // for pipe(), close(), symlink()
 #include "Util.h"
 
+static void writeFile(const string& filename, const string& contents) {
+    ofstream file(filename.c_str(), ios::binary);
+    file << contents;
+}
+
 
 int main(int argc, char** argv) {
 
@@ -12,6 +20,37 @@ int main(int argc, char** argv) {
                           "abcde\n#lin\nxyzw"));
         assert(!Util::diff("abcde\n#line foo\nxyz",
                            "abcde\n#line bar\nxyz"));
+        // #line directives may change length.
+        assert(!Util::diff("#line 9 \"a.cch\"\nint x;\n#line 10 \"a.cch\"",
+                           "#line 10 \"a.cch\"\nint x;\n#line 9 \"a.cch\""));
+        assert(Util::diff("#line 9\nint x;\n", "#line 10\nint y;\n"));
+        assert(Util::diff("#line 9\n", "#line 9\nint x;\n"));
+        assert(Util::diff("abc", "ab"));
+        assert(!Util::diff("", ""));
+
+        // Differences beyond the first block, and in the last word.
+        string a(5000, 'x');
+        a[2500] = '\n';
+        string b = a;
+        assert(!Util::diff(a, b));
+        b[4999] = 'y';
+        assert(Util::diff(a, b));
+        b = a;
+        b[3000] = 'y';
+        assert(Util::diff(a, b));
+        b = a;
+        a.replace(2501, 6, "#line 1");
+        b.replace(2501, 6, "#line 2");
+        assert(!Util::diff(a, b));
+    }
+
+    {
+        assert(Util::hash("") == Util::hash(""));
+        assert(Util::hash("abcdefghij") == Util::hash(string("abcdefghij")));
+        assert(Util::hash("abcdefghij") != Util::hash("abcdefghik"));
+        assert(Util::hash("abcdefgh") != Util::hash("abcdefgh", 1));
+        // Trailing zero bytes must still change the hash.
+        assert(Util::hash(string("ab", 2)) != Util::hash(string("ab\0", 3)));
     }
 
     {
@@ -43,4 +82,64 @@ int main(int argc, char** argv) {
         expanded = Util::expandOutputPath("%d%X", "filename", &output);
         assert(!expanded);
     }
+
+    {
+        char scratch[] = "/tmp/cch_unittest_XXXXXX";
+        string dir = ::mkdtemp(scratch);
+        assert(Util::isDirectory(dir));
+        assert(!Util::isDirectory(dir + "/missing"));
+
+        string nested = dir + "/b";
+        assert(system(("mkdir -p " + nested + "/c").c_str()) == 0);
+        writeFile(dir + "/z.cch", "");
+        writeFile(dir + "/a.cc", "");
+        writeFile(nested + "/c/x.cch", "");
+        writeFile(dir + "/list", "  first.cch \n\n# comment\n\tsecond dir/\n");
+
+        vector<string> files;
+        assert(Util::listFiles(dir, ".cch", &files));
+        assert(files.size() == 2);
+        assert(files[0] == nested + "/c/x.cch");
+        assert(files[1] == dir + "/z.cch");
+        assert(!Util::listFiles(dir + "/missing", ".cch", &files));
+
+        vector<string> entries;
+        assert(Util::readResponseFile(dir + "/list", &entries));
+        assert(entries.size() == 2);
+        assert(entries[0] == "first.cch");
+        assert(entries[1] == "second dir/");
+        assert(!Util::readResponseFile(dir + "/missing", &entries));
+
+        // Regular files are replaced; a symlink is written through.
+        assert(Util::writeFileAtomically(dir + "/target", "old"));
+        assert(::symlink("target", (dir + "/link").c_str()) == 0);
+        assert(Util::writeFileAtomically(dir + "/link", "new"));
+        string contents;
+        assert(Util::readFromFile(dir + "/target", &contents) && contents == "new");
+        assert(Util::writeFileAtomically("/dev/null", "discarded"));
+
+        assert(system(("rm -rf " + dir).c_str()) == 0);
+    }
+
+    {
+        int fds[2];
+        assert(::pipe(fds) == 0);
+        assert(Util::writeToDescriptor(fds[1], "piped\ncontents"));
+        ::close(fds[1]);
+        string contents = "stale";
+        assert(Util::readFromDescriptor(fds[0], &contents));
+        assert(contents == "piped\ncontents");
+        ::close(fds[0]);
+        assert(!Util::readFromDescriptor(fds[0], &contents));
+
+        // A bounded read stops at size bytes, or at end of file.
+        assert(::pipe(fds) == 0);
+        assert(Util::writeToDescriptor(fds[1], "abcdef"));
+        ::close(fds[1]);
+        assert(Util::readFromDescriptor(fds[0], 4, &contents) && contents == "abcd");
+        assert(Util::readFromDescriptor(fds[0], 4, &contents) && contents == "ef");
+        assert(Util::readFromDescriptor(fds[0], 4, &contents) && contents.empty());
+        ::close(fds[0]);
+        assert(!Util::writeToDescriptor(fds[1], "closed"));
+    }
 }